@@ -0,0 +1,191 @@
+/* 
+ * File:   AnnotationPacer.cpp
+ * Author: Jan Dufek
+ */
+
+#include <iostream>
+#include <chrono>
+#include "AnnotationPacer.hpp"
+
+// Width of the frames the scene motion is measured on
+static const int THUMBNAIL_WIDTH = 64;
+
+/**
+ * Creates a pacer adapting the time for annotation of each frame. The time
+ * shortens gradually while the cursor rests and the scene is static and grows
+ * quickly when the annotator moves the cursor fast or the scene changes.
+ * 
+ * @param initial_interval time for annotation of the first frame in ms
+ * @param minimum shortest time for annotation in ms
+ * @param maximum longest time for annotation in ms
+ * @param motion_limit scene motion in gray levels considered static
+ * @param cursor_limit cursor speed in display pixels per second considered resting
+ * @param speedup_factor interval factor when speeding up, below 1
+ * @param slowdown_factor interval factor when slowing down, above 1
+ */
+AnnotationPacer::AnnotationPacer(int initial_interval, int minimum, int maximum, double motion_limit, double cursor_limit, double speedup_factor, double slowdown_factor) {
+
+    minimum_interval = minimum;
+    maximum_interval = maximum > minimum ? maximum : minimum;
+
+    interval = min(max((double) initial_interval, (double) minimum_interval), (double) maximum_interval);
+
+    motion_threshold = motion_limit;
+    cursor_threshold = cursor_limit;
+
+    speedup = speedup_factor;
+    slowdown = slowdown_factor;
+
+    motion = 0;
+
+    log_file = NULL;
+
+    last_label_time = 0;
+
+    labeled_frames = 0;
+    labeling_time = 0;
+    speedups = 0;
+    slowdowns = 0;
+}
+
+AnnotationPacer::AnnotationPacer(const AnnotationPacer& orig) {
+}
+
+AnnotationPacer::~AnnotationPacer() {
+    if (log_file != NULL) {
+        fclose(log_file);
+    }
+}
+
+/**
+ * Get the time for annotation of the next frame.
+ * 
+ * @return milliseconds
+ */
+int AnnotationPacer::get_interval() {
+    return (int) (interval + 0.5);
+}
+
+/**
+ * Measure the scene motion between the previous and the new frame as mean
+ * absolute difference of their downscaled grayscale versions. Frames without
+ * a signature, e.g., revisited frames taken from the cache, are skipped.
+ * 
+ * @param frame whole new frame, preferably its downscaled grayscale signature
+ */
+void AnnotationPacer::observe_frame(const Mat& frame) {
+
+    if (frame.empty()) {
+        return;
+    }
+
+    int height = max(1, frame.rows * THUMBNAIL_WIDTH / frame.cols);
+
+    Mat small;
+    resize(frame, small, Size(THUMBNAIL_WIDTH, height), 0, 0, INTER_AREA);
+
+    if (small.channels() == 3) {
+        cvtColor(small, thumbnail, COLOR_BGR2GRAY);
+    } else {
+        thumbnail = small;
+    }
+
+    if (previous_thumbnail.size() == thumbnail.size()) {
+        motion = norm(thumbnail, previous_thumbnail, NORM_L1) / thumbnail.total();
+    } else {
+        motion = 0;
+    }
+
+    swap(thumbnail, previous_thumbnail);
+}
+
+/**
+ * Adapt the time for annotation after a frame was labeled.
+ * 
+ * @param frame_number labeled frame
+ * @param cursor_path distance the cursor traveled while the frame was shown
+ * in display pixels
+ */
+void AnnotationPacer::update(long frame_number, double cursor_path) {
+
+    double cursor_speed = cursor_path * 1000.0 / interval;
+
+    count_label();
+
+    char decision;
+
+    if (motion > motion_threshold || cursor_speed > cursor_threshold) {
+
+        // Give the annotator time to catch up
+        interval = min(interval * slowdown, (double) maximum_interval);
+        decision = '+';
+        slowdowns++;
+
+    } else {
+
+        interval = max(interval * speedup, (double) minimum_interval);
+        decision = '-';
+        speedups++;
+    }
+
+    if (log_file != NULL) {
+        fprintf(log_file, "%ld %.1f %.0f %c %d\n", frame_number, motion, cursor_speed, decision, get_interval());
+    }
+}
+
+/**
+ * Count a label logged while recording, also one the pacing did not decide
+ * on. The time since the previous label is added to the labeling time, so
+ * the throughput includes loading and showing the frames.
+ * 
+ */
+void AnnotationPacer::count_label() {
+
+    int64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+
+    if (last_label_time > 0) {
+        labeling_time += (now - last_label_time) / 1000000.0;
+    }
+
+    last_label_time = now;
+    labeled_frames++;
+}
+
+/**
+ * Stop measuring the labeling time until the next label, the time while
+ * paused does not count.
+ * 
+ */
+void AnnotationPacer::pause() {
+    last_label_time = 0;
+}
+
+/**
+ * Log each pacing decision into a text file. Each line holds the frame
+ * number, the scene motion, the cursor speed, the decision (+ slower, -
+ * faster) and the time for annotation of the next frame.
+ * 
+ * @param file_name log file
+ * @return true if the file was opened
+ */
+bool AnnotationPacer::open_log(string file_name) {
+
+    log_file = fopen(file_name.c_str(), "w");
+
+    return log_file != NULL;
+}
+
+/**
+ * Print the labeling throughput.
+ * 
+ */
+void AnnotationPacer::print_statistics() {
+
+    cout << "Pacing: " << labeled_frames << " frames labeled";
+
+    if (labeling_time > 0) {
+        cout << ", " << labeled_frames * 60000.0 / labeling_time << " frames per minute";
+    }
+
+    cout << " (" << speedups << " faster, " << slowdowns << " slower, last interval " << get_interval() << " ms)" << endl;
+}
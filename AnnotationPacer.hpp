@@ -0,0 +1,76 @@
+/* 
+ * File:   AnnotationPacer.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef ANNOTATIONPACER_HPP
+#define ANNOTATIONPACER_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+using namespace std;
+using namespace cv;
+
+class AnnotationPacer {
+public:
+    AnnotationPacer(int, int, int, double, double, double, double);
+    AnnotationPacer(const AnnotationPacer& orig);
+    virtual ~AnnotationPacer();
+
+    int get_interval();
+
+    void observe_frame(const Mat&);
+
+    void update(long, double);
+
+    void count_label();
+
+    void pause();
+
+    bool open_log(string);
+
+    void print_statistics();
+
+private:
+
+    // Time for annotation of the next frame in milliseconds and its bounds
+    double interval;
+    int minimum_interval;
+    int maximum_interval;
+
+    // Scene motion in gray levels and cursor speed in display pixels per second
+    // above which the annotation slows down
+    double motion_threshold;
+    double cursor_threshold;
+
+    // Interval factors applied when the annotation speeds up or slows down
+    double speedup;
+    double slowdown;
+
+    // Downscaled grayscale frames used to measure the scene motion
+    Mat thumbnail;
+    Mat previous_thumbnail;
+
+    // Mean absolute difference of the last two frames
+    double motion;
+
+    // Pacing decisions, NULL if not logged
+    FILE * log_file;
+
+    // Monotonic time of the last label in nanoseconds, 0 after a pause
+    int64_t last_label_time;
+
+    // Statistics, the labeling time is the wall-clock time between labels
+    // while recording in milliseconds
+    long labeled_frames;
+    double labeling_time;
+    long speedups;
+    long slowdowns;
+
+};
+
+#endif /* ANNOTATIONPACER_HPP */
@@ -0,0 +1,384 @@
+/* 
+ * File:   BatchProcessor.cpp
+ * Author: Jan Dufek
+ */
+
+#include <sys/stat.h>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include "BatchProcessor.hpp"
+#include "FramePrefetcher.hpp"
+#include "LabelReader.hpp"
+#include "LabelWriter.hpp"
+#include "LabelInterpolator.hpp"
+#include "DecoderSelector.hpp"
+#include "Undistorter.hpp"
+
+/**
+ * Creates a batch job processing an existing label file without the GUI.
+ * 
+ * @param s program settings
+ * @param video video the labels belong to
+ * @param label_file labels in the text or binary format
+ * @param output output directory
+ */
+BatchProcessor::BatchProcessor(Settings& s, string video, string label_file, string output) :
+render_queue(s.BATCH_QUEUE_DEPTH), free_frames(s.BATCH_QUEUE_DEPTH * 4) {
+
+    settings = &s;
+
+    video_file_name = video;
+    label_file_name = label_file;
+    output_directory = output;
+
+    next_written_frame = 0;
+    rendering_finished = false;
+
+    rendered_frame_count = 0;
+    patch_count = 0;
+}
+
+BatchProcessor::BatchProcessor(const BatchProcessor& orig) :
+render_queue(1), free_frames(1) {
+}
+
+BatchProcessor::~BatchProcessor() {
+}
+
+/**
+ * Read and resample the labels to every frame.
+ * 
+ * @return false if the labels cannot be read
+ */
+bool BatchProcessor::load_labels() {
+
+    vector<LabelRecord> recorded_labels;
+
+    if (!LabelReader::read_all(label_file_name, recorded_labels)) {
+        cout << "Cannot read labels " << label_file_name << endl;
+        return false;
+    }
+
+    vector<LabelRecord> resampled_labels;
+
+    LabelInterpolator label_interpolator(settings->MAXIMUM_INTERPOLATION_GAP, settings->INTERPOLATION_METHOD);
+    label_interpolator.resample(recorded_labels, resampled_labels);
+
+    // Save the resampled labels
+    LabelWriter label_writer(output_directory + "/labels.txt", LABEL_FORMAT_TEXT, settings->LABEL_BUFFER_RECORDS, settings->LABEL_SYNC_INTERVAL);
+
+    labels.reserve(resampled_labels.size());
+
+    for (size_t i = 0; i < resampled_labels.size(); i++) {
+        label_writer.write(resampled_labels[i]);
+        labels.put(resampled_labels[i]);
+    }
+
+    cout << "Resampled " << recorded_labels.size() << " labels to " << labels.size() << " frame labels" << endl;
+
+    return true;
+}
+
+/**
+ * Run the batch job. Decoding, rendering and writing run as a pipeline on
+ * separate threads, rendering and patch cropping on several threads.
+ * 
+ * @return false if the job failed
+ */
+bool BatchProcessor::run() {
+
+    int64 start_ticks = getTickCount();
+
+    mkdir(output_directory.c_str(), 0755);
+
+    if (settings->BATCH_CROP_PATCHES) {
+        mkdir((output_directory + "/patches").c_str(), 0755);
+    }
+
+    if (!load_labels()) {
+        return false;
+    }
+
+    // Frames are decoded in the resolution the labels were recorded in
+    DecoderSelector decoder_selector(video_file_name, settings->DECODER_PROBE_FRAMES, 0);
+
+    decoder_selector.select(settings->DECODER_BACKEND);
+
+    VideoCapture video_capture;
+
+    if (!decoder_selector.open(video_capture)) {
+        cout << "Cannot open video " << video_file_name << endl;
+        return false;
+    }
+
+    Size frame_size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+    if (settings->BATCH_RENDER_OVERLAY) {
+
+        double fps = video_capture.get(CV_CAP_PROP_FPS);
+
+        overlay_writer.open(output_directory + "/overlay.avi", VideoWriter::fourcc('M', 'J', 'P', 'G'), fps > 0 ? fps : 30, frame_size);
+
+        if (!overlay_writer.isOpened()) {
+            cout << "Cannot write overlay video" << endl;
+            return false;
+        }
+    }
+
+    // Decoding stage
+    FramePrefetcher frame_prefetcher(video_capture, settings->PREFETCH_QUEUE_DEPTH, frame_size, NULL, NULL);
+
+    // Labels are recorded undistorted in both undistortion modes, so they are
+    // rendered over undistorted frames
+    Undistorter undistorter(settings->camera_intrinsic_matrix, settings->camera_distortion_vector, settings->CAMERA_CALIBRATION_SIZE, settings->UNDISTORTION_CACHE_DIRECTORY);
+
+    if (settings->UNDISTORTION != UNDISTORTION_NONE && undistorter.prepare(frame_size, true)) {
+        frame_prefetcher.set_undistorter(&undistorter);
+    }
+
+    frame_prefetcher.start();
+
+    // Rendering stage
+    int thread_count = settings->BATCH_THREADS > 0 ? settings->BATCH_THREADS : thread::hardware_concurrency();
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    vector<thread> render_workers;
+
+    for (int i = 0; i < thread_count; i++) {
+        render_workers.push_back(thread(&BatchProcessor::render_worker, this));
+    }
+
+    // Writing stage
+    thread overlay_video_writer;
+
+    if (settings->BATCH_RENDER_OVERLAY) {
+        overlay_video_writer = thread(&BatchProcessor::write_overlay_video, this);
+    }
+
+    // Feed the decoded frames to the render workers. Buffers returned by the
+    // last stage are exchanged with the decoder so the frames are not
+    // reallocated.
+    long frame_count = 0;
+
+    while (true) {
+
+        Job job;
+
+        free_frames.try_pop(job.frame);
+
+        if (!frame_prefetcher.next_frame(job.frame, job.frame_number)) {
+            break;
+        }
+
+        render_queue.push(job);
+
+        frame_count++;
+    }
+
+    render_queue.close();
+
+    for (size_t i = 0; i < render_workers.size(); i++) {
+        render_workers[i].join();
+    }
+
+    {
+        lock_guard<mutex> lock(rendered_mutex);
+        rendering_finished = true;
+    }
+
+    rendered_changed.notify_all();
+
+    if (overlay_video_writer.joinable()) {
+        overlay_video_writer.join();
+    }
+
+    overlay_writer.release();
+
+    double elapsed_time = (getTickCount() - start_ticks) / getTickFrequency();
+
+    cout << "Processed " << frame_count << " frames in " << elapsed_time << " s (" << frame_count / elapsed_time << " fps)" << endl;
+    cout << "Cropped " << patch_count << " patches" << endl;
+
+    frame_prefetcher.print_statistics();
+
+    return true;
+}
+
+/**
+ * Render worker. Draws the labels into the frames and crops the patches around
+ * the labeled positions.
+ * 
+ */
+void BatchProcessor::render_worker() {
+
+    Job job;
+
+    while (render_queue.pop(job)) {
+
+        // Labels of all objects in the frame. The table is not changed while
+        // rendering.
+        vector<LabelRecord> frame_labels;
+
+        for (int row = labels.first_in_frame(job.frame_number); row >= 0; row = labels.next_in_frame(row)) {
+            frame_labels.push_back(labels.get(row));
+        }
+
+        if (settings->BATCH_CROP_PATCHES) {
+            for (size_t i = 0; i < frame_labels.size(); i++) {
+                write_patch(job.frame, frame_labels[i]);
+            }
+        }
+
+        if (!settings->BATCH_RENDER_OVERLAY) {
+            recycle(job.frame);
+            continue;
+        }
+
+        for (size_t i = 0; i < frame_labels.size(); i++) {
+            draw_label(job.frame, frame_labels[i]);
+        }
+
+        // Do not run too far ahead of the writer. The frame the writer waits
+        // for never waits here, frames are numbered without gaps.
+        unique_lock<mutex> lock(rendered_mutex);
+
+        while (job.frame_number - next_written_frame >= settings->BATCH_QUEUE_DEPTH) {
+            rendered_changed.wait(lock);
+        }
+
+        rendered_frames[job.frame_number] = job.frame;
+        job.frame = Mat();
+
+        rendered_frame_count++;
+
+        lock.unlock();
+        rendered_changed.notify_all();
+    }
+}
+
+/**
+ * Overlay video writer. Writes the rendered frames in frame order.
+ * 
+ */
+void BatchProcessor::write_overlay_video() {
+
+    while (true) {
+
+        Mat frame;
+
+        {
+            unique_lock<mutex> lock(rendered_mutex);
+
+            while (rendered_frames.count(next_written_frame) == 0 && !(rendering_finished && rendered_frames.empty())) {
+                rendered_changed.wait(lock);
+            }
+
+            if (rendered_frames.empty()) {
+                return;
+            }
+
+            // The prefetcher numbers the frames consecutively from the first
+            // decoded frame, so the next frame is always rendered eventually
+            map<long, Mat>::iterator next = rendered_frames.find(next_written_frame);
+
+            frame = next->second;
+            next_written_frame++;
+            rendered_frames.erase(next);
+        }
+
+        rendered_changed.notify_all();
+
+        overlay_writer.write(frame);
+
+        recycle(frame);
+    }
+}
+
+/**
+ * Draw the label as crosshairs with its coordinates and its box if it has one.
+ * 
+ * @param frame frame to draw into
+ * @param label label
+ */
+void BatchProcessor::draw_label(Mat& frame, const LabelRecord& label) {
+
+    Point position(label.x + 0.5, label.y + 0.5);
+    int radius = 10;
+
+    line(frame, Point(position.x, position.y - radius), Point(position.x, position.y + radius), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    line(frame, Point(position.x - radius, position.y), Point(position.x + radius, position.y), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+
+    // Text coordinates, interpolated labels are marked
+    stringstream text;
+    text << "[" << position.x << "," << position.y << "]";
+
+    if (label.flags & LABEL_FLAG_INTERPOLATED) {
+        text << " i";
+    }
+
+    // Other objects than the first one are marked with their key
+    if (label.object_id > 0 && label.object_id < settings->OBJECT_KEYS.size()) {
+        text << " " << settings->OBJECT_KEYS[label.object_id];
+    }
+
+    putText(frame, text.str(), Point(position.x, position.y + radius + 20), 1, 1, settings->LOCATION_COLOR, 1, 8);
+
+    if (label.width > 0 && label.height > 0) {
+        Point corner_1(label.x - label.width / 2 + 0.5, label.y - label.height / 2 + 0.5);
+        Point corner_2(label.x + label.width / 2 + 0.5, label.y + label.height / 2 + 0.5);
+
+        rectangle(frame, corner_1, corner_2, settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    }
+}
+
+/**
+ * Crop a patch centered at the labeled position and save it. Boxes are cropped
+ * as labeled, points with the patch size. Patches are clipped at the frame
+ * borders.
+ * 
+ * @param frame frame to crop from
+ * @param label label
+ */
+void BatchProcessor::write_patch(const Mat& frame, const LabelRecord& label) {
+
+    int size = settings->BATCH_PATCH_SIZE;
+
+    Rect patch(label.x + 0.5 - size / 2, label.y + 0.5 - size / 2, size, size);
+
+    if (label.width > 0 && label.height > 0) {
+        patch = Rect(label.x + 0.5 - label.width / 2, label.y + 0.5 - label.height / 2, label.width + 0.5, label.height + 0.5);
+    }
+
+    patch &= Rect(0, 0, frame.cols, frame.rows);
+
+    if (patch.area() == 0) {
+        return;
+    }
+
+    // Patches of the first object keep the frame number only
+    char file_name[40];
+
+    if (label.object_id == 0) {
+        snprintf(file_name, sizeof (file_name), "/patches/%08ld.png", (long) label.frame_number);
+    } else {
+        snprintf(file_name, sizeof (file_name), "/patches/%08ld_%u.png", (long) label.frame_number, label.object_id);
+    }
+
+    imwrite(output_directory + file_name, frame(patch));
+
+    patch_count++;
+}
+
+/**
+ * Return a frame buffer for decoding.
+ * 
+ * @param frame frame no longer used
+ */
+void BatchProcessor::recycle(Mat& frame) {
+    free_frames.try_push(frame);
+    frame = Mat();
+}
@@ -0,0 +1,97 @@
+/* 
+ * File:   BatchProcessor.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BATCHPROCESSOR_HPP
+#define BATCHPROCESSOR_HPP
+
+#include <map>
+#include <atomic>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/videoio.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "Settings.hpp"
+#include "LabelRecord.hpp"
+#include "LabelTable.hpp"
+#include "BoundedQueue.hpp"
+
+using namespace std;
+using namespace cv;
+
+class BatchProcessor {
+public:
+    BatchProcessor(Settings&, string, string, string);
+    BatchProcessor(const BatchProcessor& orig);
+    virtual ~BatchProcessor();
+
+    bool run();
+
+private:
+
+    // Decoded frame passed between the pipeline stages
+    struct Job {
+        long frame_number;
+        Mat frame;
+    };
+
+    bool load_labels();
+
+    void render_worker();
+
+    void write_overlay_video();
+
+    void draw_label(Mat&, const LabelRecord&);
+
+    void write_patch(const Mat&, const LabelRecord&);
+
+    void recycle(Mat&);
+
+    // Program settings
+    Settings * settings;
+
+    // Input video
+    string video_file_name;
+
+    // Input labels
+    string label_file_name;
+
+    // Output directory
+    string output_directory;
+
+    // Labels resampled to every frame, by frame and object
+    LabelTable labels;
+
+    // Decoded frames waiting for rendering
+    BoundedQueue<Job> render_queue;
+
+    // Frame buffers returned by the last stage for decoding
+    BoundedQueue<Mat> free_frames;
+
+    // Rendered frames waiting to be written in frame order
+    map<long, Mat> rendered_frames;
+
+    // Number of the frame the overlay video writer waits for
+    long next_written_frame;
+
+    // All frames were rendered
+    bool rendering_finished;
+
+    // Protects the rendered frames
+    mutex rendered_mutex;
+
+    // Signaled when a frame was rendered or written
+    condition_variable rendered_changed;
+
+    // Overlay video
+    VideoWriter overlay_writer;
+
+    // Statistics
+    atomic<long> rendered_frame_count;
+    atomic<long> patch_count;
+
+};
+
+#endif /* BATCHPROCESSOR_HPP */
+
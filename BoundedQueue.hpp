@@ -0,0 +1,156 @@
+/* 
+ * File:   BoundedQueue.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// Blocking queue with a maximum size connecting the stages of a pipeline
+template<typename T>
+class BoundedQueue {
+public:
+
+    BoundedQueue(size_t size) {
+        capacity = size > 0 ? size : 1;
+        closed = false;
+    }
+
+    /**
+     * Add an item, waiting while the queue is full.
+     * 
+     * @param item item to add
+     * @return false if the queue was closed
+     */
+    bool push(T item) {
+
+        unique_lock<mutex> lock(queue_mutex);
+
+        while (items.size() >= capacity && !closed) {
+            not_full.wait(lock);
+        }
+
+        if (closed) {
+            return false;
+        }
+
+        items.push_back(std::move(item));
+
+        lock.unlock();
+        not_empty.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Remove the oldest item, waiting while the queue is empty.
+     * 
+     * @param item receives the item
+     * @return false if the queue was closed and all items were taken
+     */
+    bool pop(T& item) {
+
+        unique_lock<mutex> lock(queue_mutex);
+
+        while (items.empty() && !closed) {
+            not_empty.wait(lock);
+        }
+
+        if (items.empty()) {
+            return false;
+        }
+
+        item = std::move(items.front());
+        items.pop_front();
+
+        lock.unlock();
+        not_full.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Remove the oldest item if there is any.
+     * 
+     * @param item receives the item
+     * @return false if the queue was empty
+     */
+    bool try_pop(T& item) {
+
+        unique_lock<mutex> lock(queue_mutex);
+
+        if (items.empty()) {
+            return false;
+        }
+
+        item = std::move(items.front());
+        items.pop_front();
+
+        lock.unlock();
+        not_full.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Add an item if the queue is not full.
+     * 
+     * @param item item to add
+     * @return false if the queue was full or closed
+     */
+    bool try_push(T item) {
+
+        unique_lock<mutex> lock(queue_mutex);
+
+        if (items.size() >= capacity || closed) {
+            return false;
+        }
+
+        items.push_back(std::move(item));
+
+        lock.unlock();
+        not_empty.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Close the queue. Items already in the queue can still be taken.
+     * 
+     */
+    void close() {
+
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            closed = true;
+        }
+
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+
+    // Maximum number of items
+    size_t capacity;
+
+    // No more items will be added
+    bool closed;
+
+    // Items, the oldest first
+    deque<T> items;
+
+    mutex queue_mutex;
+    condition_variable not_empty;
+    condition_variable not_full;
+
+};
+
+#endif /* BOUNDEDQUEUE_HPP */
+
@@ -0,0 +1,542 @@
+/*
+ * File:   CaptureRing.cpp
+ * Author: Jan Dufek
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <iostream>
+#include "opencv2/imgcodecs.hpp"
+#include "CaptureRing.hpp"
+#include "TimingTrace.hpp"
+
+/**
+ * Creates a ring recording the given source. The source has to be open.
+ *
+ * @param capture live source, deleted with the ring
+ * @param name name of the source. Video files are played at their frame rate
+ * to stand in for a camera.
+ * @param ring_directory directory of the segment files, created if needed
+ * @param frames frames per segment
+ * @param count number of segments
+ * @param image_format format the frames are encoded with: .jpg, or .png or
+ * .bmp to keep them lossless
+ * @param quality JPEG quality
+ * @param keep keep the segment files when done
+ */
+CaptureRing::CaptureRing(VideoCapture* capture, string name, string ring_directory, int frames, int count, string image_format, int quality, bool keep) {
+
+    source = capture;
+    source_name = name;
+    directory = ring_directory;
+    segment_frames = max(frames, 1);
+    segments = max(count, 2);
+    format = image_format;
+    keep_files = keep;
+
+    if (format == ".jpg" || format == ".jpeg") {
+        format_parameters.push_back(IMWRITE_JPEG_QUALITY);
+        format_parameters.push_back(quality);
+    } else if (format == ".png") {
+
+        // Fastest compression, the ring is rewritten continuously
+        format_parameters.push_back(IMWRITE_PNG_COMPRESSION);
+        format_parameters.push_back(1);
+    }
+
+    struct stat file_status;
+
+    pace_source = stat(source_name.c_str(), &file_status) == 0 && S_ISREG(file_status.st_mode);
+
+    source_width = 0;
+    source_height = 0;
+    source_fps = 0;
+
+    slot_frames.resize(segments, vector<RingFrame>(segment_frames));
+    slot_segments.resize(segments, -1);
+    read_files.resize(segments, -1);
+
+    data_file = -1;
+    index_file = -1;
+    data_offset = 0;
+
+    captured_frames = 0;
+    oldest_frame = 0;
+    source_finished = false;
+
+    position = 0;
+    grabbed_frame = -1;
+
+    stop_requested = false;
+
+    skipped_frames = 0;
+    total_write_time = 0;
+    maximum_write_time = 0;
+}
+
+CaptureRing::CaptureRing(const CaptureRing& orig) : VideoCapture() {
+}
+
+CaptureRing::~CaptureRing() {
+
+    stop();
+
+    for (int i = 0; i < segments; i++) {
+
+        if (read_files[i] >= 0) {
+            ::close(read_files[i]);
+        }
+
+        if (!keep_files && slot_segments[i] >= 0) {
+            remove(get_segment_file_name(i, ".frames").c_str());
+            remove(get_segment_file_name(i, ".index").c_str());
+        }
+    }
+
+    if (!keep_files) {
+        rmdir(directory.c_str());
+    }
+
+    delete source;
+}
+
+/**
+ * Get the name of a file of a slot.
+ *
+ * @param slot slot of the ring
+ * @param extension .frames for the encoded frames, .index for their index
+ * @return file name
+ */
+string CaptureRing::get_segment_file_name(int slot, const char* extension) {
+
+    char file_name[32];
+    snprintf(file_name, sizeof (file_name), "/segment_%03d%s", slot, extension);
+
+    return directory + file_name;
+}
+
+/**
+ * Starts the capture thread.
+ *
+ * @return false if the source is not open or the ring cannot be written
+ */
+bool CaptureRing::start() {
+
+    if (source == NULL || !source->isOpened()) {
+        return false;
+    }
+
+    vector<uchar> test_buffer;
+
+    if (!imencode(format, Mat(16, 16, CV_8UC3, Scalar::all(0)), test_buffer, format_parameters)) {
+        cout << "Cannot encode frames as " << format << endl;
+        return false;
+    }
+
+    mkdir(directory.c_str(), 0755);
+
+    source_width = source->get(CV_CAP_PROP_FRAME_WIDTH);
+    source_height = source->get(CV_CAP_PROP_FRAME_HEIGHT);
+    source_fps = source->get(CV_CAP_PROP_FPS);
+
+    if (!start_segment(0)) {
+        cout << "Cannot write capture ring " << directory << endl;
+        return false;
+    }
+
+    if (!capturer.joinable()) {
+        stop_requested = false;
+        capturer = thread(&CaptureRing::run, this);
+    }
+
+    return true;
+}
+
+/**
+ * Stops the capture thread and waits for it to finish.
+ */
+void CaptureRing::stop() {
+
+    {
+        lock_guard<mutex> lock(ring_mutex);
+        stop_requested = true;
+    }
+
+    frame_captured.notify_all();
+
+    if (capturer.joinable()) {
+        capturer.join();
+    }
+
+    if (data_file >= 0) {
+        ::close(data_file);
+        data_file = -1;
+    }
+
+    if (index_file >= 0) {
+        ::close(index_file);
+        index_file = -1;
+    }
+}
+
+/**
+ * Open the files of a new segment in its slot. The segment held by the slot
+ * before is dropped from the ring first, so that readers do not take its
+ * frames while they are overwritten.
+ *
+ * @param segment segment number
+ * @return false if the files cannot be created
+ */
+bool CaptureRing::start_segment(long segment) {
+
+    int slot = segment % segments;
+
+    {
+        lock_guard<mutex> lock(ring_mutex);
+
+        oldest_frame = max(oldest_frame, (segment - segments + 1) * segment_frames);
+        slot_segments[slot] = segment;
+    }
+
+    if (data_file >= 0) {
+        ::close(data_file);
+    }
+
+    if (index_file >= 0) {
+        ::close(index_file);
+    }
+
+    data_file = ::open(get_segment_file_name(slot, ".frames").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    index_file = ::open(get_segment_file_name(slot, ".index").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    data_offset = 0;
+
+    return data_file >= 0 && index_file >= 0;
+}
+
+/**
+ * Capture loop. Reads frames from the source as they arrive, encodes them into
+ * the current segment and publishes them to the reader until the source ends
+ * or the ring is stopped.
+ */
+void CaptureRing::run() {
+
+    if (TimingTrace::get_active() != NULL) {
+        TimingTrace::get_active()->name_thread("capture");
+    }
+
+    Mat frame;
+    vector<uchar> buffer;
+
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+    double frame_interval = source_fps > 0 && source_fps < 1000 ? 1.0 / source_fps : 1.0 / 30;
+
+    for (long number = 0;; number++) {
+
+        {
+            lock_guard<mutex> lock(ring_mutex);
+
+            if (stop_requested) {
+                break;
+            }
+        }
+
+        // A video file arrives at its frame rate like a camera
+        if (pace_source) {
+            this_thread::sleep_until(start_time + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(number * frame_interval)));
+        }
+
+        if (!source->read(frame) || frame.empty()) {
+            break;
+        }
+
+        int64_t arrival_time = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+        ScopedTimer write_timer("capture", number);
+        int64 start_ticks = getTickCount();
+
+        if (number > 0 && number % segment_frames == 0 && !start_segment(number / segment_frames)) {
+            cout << "Cannot write capture ring " << directory << endl;
+            break;
+        }
+
+        RingFrame ring_frame;
+        ring_frame.frame_number = number;
+        ring_frame.arrival_time = arrival_time;
+        ring_frame.offset = data_offset;
+        ring_frame.size = 0;
+
+        if (imencode(format, frame, buffer, format_parameters)) {
+            ring_frame.size = buffer.size();
+        }
+
+        if (ring_frame.size > 0 && ::write(data_file, buffer.data(), buffer.size()) != (ssize_t) buffer.size()) {
+            cout << "Cannot write capture ring " << directory << endl;
+            break;
+        }
+
+        data_offset += ring_frame.size;
+
+        if (::write(index_file, &ring_frame, sizeof (ring_frame)) != (ssize_t) sizeof (ring_frame)) {
+            cout << "Cannot write capture ring " << directory << endl;
+            break;
+        }
+
+        double write_time = (getTickCount() - start_ticks) * 1000.0 / getTickFrequency();
+
+        {
+            lock_guard<mutex> lock(ring_mutex);
+
+            slot_frames[(number / segment_frames) % segments][number % segment_frames] = ring_frame;
+            captured_frames = number + 1;
+
+            total_write_time += write_time;
+            maximum_write_time = max(maximum_write_time, write_time);
+        }
+
+        frame_captured.notify_all();
+    }
+
+    {
+        lock_guard<mutex> lock(ring_mutex);
+        source_finished = true;
+    }
+
+    frame_captured.notify_all();
+}
+
+/**
+ * Check whether the source is open.
+ *
+ * @return true if the source is open
+ */
+bool CaptureRing::isOpened() const {
+    return source != NULL && source->isOpened();
+}
+
+/**
+ * Wait until the next frame is captured and make it the frame to retrieve.
+ * Frames that were overwritten before they were read and frames that could
+ * not be encoded are skipped.
+ *
+ * @return false if the source ended
+ */
+bool CaptureRing::grab() {
+
+    unique_lock<mutex> lock(ring_mutex);
+
+    while (true) {
+
+        while (!stop_requested && !source_finished && position >= captured_frames) {
+            frame_captured.wait(lock);
+        }
+
+        if (position >= captured_frames) {
+            return false;
+        }
+
+        if (position < oldest_frame) {
+            skipped_frames += oldest_frame - position;
+            position = oldest_frame;
+        }
+
+        // Frames that could not be encoded are indexed without data
+        if (slot_frames[(position / segment_frames) % segments][position % segment_frames].size == 0) {
+            skipped_frames++;
+            position++;
+            continue;
+        }
+
+        grabbed_frame = position;
+        position++;
+
+        return true;
+    }
+}
+
+/**
+ * Decode the grabbed frame from its segment. If its segment is overwritten
+ * meanwhile, the oldest frame still in the ring is taken instead. Frames that
+ * cannot be read or decoded are skipped and the next frame is grabbed.
+ *
+ * @param image receives the frame
+ * @param flag unused
+ * @return false if no frame was grabbed or the source ended
+ */
+bool CaptureRing::retrieve(OutputArray image, int flag) {
+
+    while (true) {
+
+        RingFrame ring_frame;
+        int slot;
+        long segment;
+
+        {
+            lock_guard<mutex> lock(ring_mutex);
+
+            if (grabbed_frame < 0 || grabbed_frame >= captured_frames) {
+                return false;
+            }
+
+            if (grabbed_frame < oldest_frame) {
+                skipped_frames += oldest_frame - grabbed_frame;
+                grabbed_frame = oldest_frame;
+                position = max(position, grabbed_frame + 1);
+            }
+
+            segment = grabbed_frame / segment_frames;
+            slot = segment % segments;
+            ring_frame = slot_frames[slot][grabbed_frame % segment_frames];
+        }
+
+        if (read_files[slot] < 0) {
+            read_files[slot] = ::open(get_segment_file_name(slot, ".frames").c_str(), O_RDONLY);
+        }
+
+        read_buffer.resize(ring_frame.size);
+
+        bool complete = read_files[slot] >= 0 && ring_frame.size > 0 && pread(read_files[slot], read_buffer.data(), ring_frame.size, ring_frame.offset) == (ssize_t) ring_frame.size;
+
+        // The frame is valid if its segment was not overwritten while reading
+        {
+            lock_guard<mutex> lock(ring_mutex);
+
+            if (slot_segments[slot] != segment || grabbed_frame < oldest_frame) {
+                continue;
+            }
+        }
+
+        Mat decoded;
+
+        if (complete) {
+            decoded = imdecode(read_buffer, IMREAD_COLOR);
+        }
+
+        if (!decoded.empty()) {
+            decoded.copyTo(image);
+            return true;
+        }
+
+        // One broken frame does not end the labeling
+        {
+            lock_guard<mutex> lock(ring_mutex);
+            skipped_frames++;
+        }
+
+        if (!grab()) {
+            return false;
+        }
+    }
+}
+
+/**
+ * Grab and retrieve the next frame.
+ *
+ * @param image receives the frame
+ * @return false if the source ended
+ */
+bool CaptureRing::read(OutputArray image) {
+    return grab() && retrieve(image);
+}
+
+/**
+ * Seek within the ring. Positions before the oldest frame in the ring start at
+ * the oldest frame.
+ *
+ * @param property only CV_CAP_PROP_POS_FRAMES is supported
+ * @param value frame number
+ * @return false for other properties
+ */
+bool CaptureRing::set(int property, double value) {
+
+    if (property != CV_CAP_PROP_POS_FRAMES) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(ring_mutex);
+
+    position = max((long) value, oldest_frame);
+
+    return true;
+}
+
+/**
+ * Get a property. The position and the frame count refer to the ring, the
+ * other properties to the source.
+ *
+ * @param property capture property
+ * @return value, 0 if not available
+ */
+double CaptureRing::get(int property) const {
+
+    lock_guard<mutex> lock(ring_mutex);
+
+    switch (property) {
+        case CV_CAP_PROP_POS_FRAMES:
+            return position;
+        case CV_CAP_PROP_FRAME_COUNT:
+            return captured_frames;
+        case CV_CAP_PROP_FRAME_WIDTH:
+            return source_width;
+        case CV_CAP_PROP_FRAME_HEIGHT:
+            return source_height;
+        case CV_CAP_PROP_FPS:
+            return source_fps;
+    }
+
+    return 0;
+}
+
+/**
+ * Get the time a frame arrived from the source.
+ *
+ * @param frame_number frame
+ * @return nanoseconds since the epoch, 0 if the frame is not in the ring
+ */
+int64_t CaptureRing::get_arrival_time(long frame_number) {
+
+    lock_guard<mutex> lock(ring_mutex);
+
+    if (frame_number < oldest_frame || frame_number >= captured_frames) {
+        return 0;
+    }
+
+    return slot_frames[(frame_number / segment_frames) % segments][frame_number % segment_frames].arrival_time;
+}
+
+/**
+ * Get the number of frames captured so far.
+ *
+ * @return captured frames
+ */
+long CaptureRing::get_captured_frames() {
+    lock_guard<mutex> lock(ring_mutex);
+    return captured_frames;
+}
+
+/**
+ * Get the number of frames overwritten before they were read or skipped
+ * because they could not be encoded or decoded.
+ *
+ * @return skipped frames
+ */
+long CaptureRing::get_skipped_frames() {
+    lock_guard<mutex> lock(ring_mutex);
+    return skipped_frames;
+}
+
+/**
+ * Print capture statistics to the console.
+ */
+void CaptureRing::print_statistics() {
+
+    lock_guard<mutex> lock(ring_mutex);
+
+    cout << "Captured frames: " << captured_frames << " (ring of " << segments << " x " << segment_frames << " frames in " << directory << ")" << endl;
+    cout << "Average capture write time: " << (captured_frames > 0 ? total_write_time / captured_frames : 0) << " ms" << endl;
+    cout << "Maximum capture write time: " << maximum_write_time << " ms" << endl;
+    cout << "Frames overwritten or not stored before labeling: " << skipped_frames << endl;
+}
@@ -0,0 +1,153 @@
+/*
+ * File:   CaptureRing.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CAPTURERING_HPP
+#define CAPTURERING_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Location of a captured frame in its segment, also the record of the segment
+// index files
+struct RingFrame {
+    int64_t frame_number;
+
+    // Wall clock time the frame arrived from the source in nanoseconds since
+    // the epoch
+    int64_t arrival_time;
+
+    // Encoded frame in the segment data file
+    int64_t offset;
+    int64_t size;
+};
+
+/**
+ * Records a live source into a bounded ring of segment files on disk and plays
+ * it back as a video capture. The capture thread reads every frame as it
+ * arrives, so the source is never stalled by the labeling, and the labeling
+ * reads the recorded frames at its own pace and can seek back within the
+ * ring. When the ring is full, the oldest segment is overwritten and frames
+ * in it that were not read yet are skipped.
+ */
+class CaptureRing : public VideoCapture {
+public:
+    CaptureRing(VideoCapture*, string, string, int, int, string, int, bool);
+    CaptureRing(const CaptureRing& orig);
+    virtual ~CaptureRing();
+
+    bool start();
+
+    void stop();
+
+    virtual bool isOpened() const;
+
+    virtual bool grab();
+
+    virtual bool retrieve(OutputArray, int = 0);
+
+    virtual bool read(OutputArray);
+
+    virtual bool set(int, double);
+
+    virtual double get(int) const;
+
+    int64_t get_arrival_time(long);
+
+    long get_captured_frames();
+
+    long get_skipped_frames();
+
+    void print_statistics();
+
+private:
+
+    void run();
+
+    bool start_segment(long);
+
+    string get_segment_file_name(int, const char*);
+
+    // Live source, owned by the ring
+    VideoCapture * source;
+
+    // Name of the source, files are played at their frame rate
+    string source_name;
+    bool pace_source;
+
+    // Directory of the segment files
+    string directory;
+
+    // Frames per segment and number of segments in the ring
+    int segment_frames;
+    int segments;
+
+    // Image format the frames are encoded with, e.g., .jpg or .png
+    string format;
+    vector<int> format_parameters;
+
+    // Keep the segment files when done
+    bool keep_files;
+
+    // Properties of the source, read before capturing
+    double source_width;
+    double source_height;
+    double source_fps;
+
+    // Frames of each slot of the ring
+    vector<vector<RingFrame> > slot_frames;
+
+    // Segment held by each slot, -1 if none
+    vector<long> slot_segments;
+
+    // Descriptors of the slot data files used by the reader, -1 if not open
+    vector<int> read_files;
+
+    // Data and index file of the segment being written
+    int data_file;
+    int index_file;
+    int64_t data_offset;
+
+    // Number of frames captured, the oldest frame still in the ring and
+    // whether the source ended
+    long captured_frames;
+    long oldest_frame;
+    bool source_finished;
+
+    // Frame the next grab returns and the frame grabbed last
+    long position;
+    long grabbed_frame;
+
+    // Encoded frame read by the reader
+    vector<uchar> read_buffer;
+
+    // The capture thread should exit
+    bool stop_requested;
+
+    // Capture thread
+    thread capturer;
+
+    // Protects the ring index and the positions
+    mutable mutex ring_mutex;
+
+    // Signaled when a frame was captured or the source ended
+    condition_variable frame_captured;
+
+    // Statistics
+    long skipped_frames;
+    double total_write_time;
+    double maximum_write_time;
+
+};
+
+#endif /* CAPTURERING_HPP */
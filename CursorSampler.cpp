@@ -0,0 +1,255 @@
+/* 
+ * File:   CursorSampler.cpp
+ * Author: Jan Dufek
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include "CursorSampler.hpp"
+
+/**
+ * Creates a sampler recording every cursor move between two labels.
+ * 
+ * @param capacity number of samples the ring holds, rounded up to a power of
+ * two
+ * @param window_ms length of the summarized window before the label is taken
+ * in milliseconds
+ * @param summary CURSOR_SUMMARY_LAST, CURSOR_SUMMARY_MEDIAN or
+ * CURSOR_SUMMARY_DWELL
+ */
+CursorSampler::CursorSampler(int capacity, int window_ms, int summary) : write_index(0), read_index(0), dropped_samples(0) {
+
+    size_t size = 1;
+    while (size < (size_t) capacity) {
+        size <<= 1;
+    }
+
+    ring.resize(size);
+    mask = size - 1;
+
+    window = (int64_t) window_ms * 1000000;
+    method = summary;
+
+    trace_file = NULL;
+    samples = 0;
+    path_length = 0;
+}
+
+CursorSampler::CursorSampler(const CursorSampler& orig) {
+}
+
+CursorSampler::~CursorSampler() {
+    close_trace();
+}
+
+/**
+ * Get the time of the monotonic clock.
+ * 
+ * @return nanoseconds
+ */
+int64_t CursorSampler::monotonic_time() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Store a cursor position. Called only from the mouse handler, it does not
+ * lock nor allocate.
+ * 
+ * @param x x coordinate in original pixels
+ * @param y y coordinate in original pixels
+ * @return false if the ring was full and the sample was dropped
+ */
+bool CursorSampler::push(float x, float y) {
+
+    size_t write = write_index.load(memory_order_relaxed);
+
+    if (write - read_index.load(memory_order_acquire) == ring.size()) {
+        dropped_samples.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    CursorSample& sample = ring[write & mask];
+    sample.time = monotonic_time();
+    sample.x = x;
+    sample.y = y;
+
+    // Publish the sample
+    write_index.store(write + 1, memory_order_release);
+
+    return true;
+}
+
+/**
+ * Take the oldest sample out of the ring. Called only by the consumer.
+ * 
+ * @param sample output
+ * @return false if the ring is empty
+ */
+bool CursorSampler::pop(CursorSample& sample) {
+
+    size_t read = read_index.load(memory_order_relaxed);
+
+    if (read == write_index.load(memory_order_acquire)) {
+        return false;
+    }
+
+    sample = ring[read & mask];
+
+    read_index.store(read + 1, memory_order_release);
+
+    return true;
+}
+
+/**
+ * Move the samples from the ring to the summary window and to the trace.
+ * Samples older than the window are forgotten, except the last one of them
+ * which holds the position at the beginning of the window.
+ * 
+ * @param frame_number frame shown while the samples were recorded
+ */
+void CursorSampler::collect(long frame_number) {
+
+    CursorSample sample;
+
+    while (pop(sample)) {
+
+        history.push_back(sample);
+
+        if (samples > 0) {
+            path_length += sqrt((double) (sample.x - last_sample.x) * (sample.x - last_sample.x) + (double) (sample.y - last_sample.y) * (sample.y - last_sample.y));
+        }
+
+        last_sample = sample;
+
+        samples++;
+
+        if (trace_file != NULL) {
+            fprintf(trace_file, "%ld %lld %.2f %.2f\n", frame_number, (long long) sample.time, sample.x, sample.y);
+        }
+    }
+
+    int64_t window_start = monotonic_time() - window;
+
+    while (history.size() > 1 && history[1].time <= window_start) {
+        history.pop_front();
+    }
+}
+
+/**
+ * Summarize the cursor positions of the window ending now.
+ * 
+ * @param current current cursor position, used if no sample was recorded
+ * @return summarized position
+ */
+Point2f CursorSampler::summarize(Point2f current) {
+
+    if (history.empty() || method == CURSOR_SUMMARY_LAST) {
+        return current;
+    }
+
+    int64_t now = monotonic_time();
+    int64_t window_start = now - window;
+
+    if (method == CURSOR_SUMMARY_MEDIAN) {
+
+        vector<float> x, y;
+        x.reserve(history.size());
+        y.reserve(history.size());
+
+        for (size_t i = 0; i < history.size(); i++) {
+            x.push_back(history[i].x);
+            y.push_back(history[i].y);
+        }
+
+        size_t middle = x.size() / 2;
+        nth_element(x.begin(), x.begin() + middle, x.end());
+        nth_element(y.begin(), y.begin() + middle, y.end());
+
+        return Point2f(x[middle], y[middle]);
+    }
+
+    // Weight each position by how long the cursor rested there
+    double sum_x = 0, sum_y = 0, sum_weight = 0;
+
+    for (size_t i = 0; i < history.size(); i++) {
+
+        int64_t start = max(history[i].time, window_start);
+        int64_t end = i + 1 < history.size() ? history[i + 1].time : now;
+
+        if (end <= start) {
+            continue;
+        }
+
+        double weight = (double) (end - start);
+        sum_x += history[i].x * weight;
+        sum_y += history[i].y * weight;
+        sum_weight += weight;
+    }
+
+    if (sum_weight <= 0) {
+        return Point2f(history.back().x, history.back().y);
+    }
+
+    return Point2f(sum_x / sum_weight, sum_y / sum_weight);
+}
+
+/**
+ * Keep the raw samples in a text file. Each line holds the frame number, the
+ * monotonic time in nanoseconds and the position.
+ * 
+ * @param file_name trace file
+ * @return true if the file was opened
+ */
+bool CursorSampler::open_trace(string file_name) {
+
+    close_trace();
+
+    trace_file = fopen(file_name.c_str(), "w");
+
+    return trace_file != NULL;
+}
+
+/**
+ * Close the trace file.
+ * 
+ */
+void CursorSampler::close_trace() {
+
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
+
+/**
+ * Get the distance the cursor traveled and start measuring it again.
+ * 
+ * @return distance in original pixels
+ */
+double CursorSampler::take_path_length() {
+
+    double length = path_length;
+
+    path_length = 0;
+
+    return length;
+}
+
+/**
+ * Get the number of collected samples.
+ * 
+ * @return number of samples
+ */
+long CursorSampler::get_samples() {
+    return samples;
+}
+
+/**
+ * Get the number of samples dropped because the ring was full.
+ * 
+ * @return number of samples
+ */
+long CursorSampler::get_dropped_samples() {
+    return dropped_samples.load(memory_order_relaxed);
+}
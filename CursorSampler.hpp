@@ -0,0 +1,90 @@
+/* 
+ * File:   CursorSampler.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CURSORSAMPLER_HPP
+#define CURSORSAMPLER_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <string>
+#include "opencv2/core.hpp"
+#include "SettingTypes.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Cursor position with the monotonic time it was reached
+struct CursorSample {
+    int64_t time; // Nanoseconds of the monotonic clock
+    float x;
+    float y;
+};
+
+class CursorSampler {
+public:
+    CursorSampler(int, int, int);
+    CursorSampler(const CursorSampler& orig);
+    virtual ~CursorSampler();
+
+    bool push(float, float);
+
+    void collect(long);
+
+    Point2f summarize(Point2f);
+
+    bool open_trace(string);
+
+    void close_trace();
+
+    double take_path_length();
+
+    long get_samples();
+
+    long get_dropped_samples();
+
+    static int64_t monotonic_time();
+
+private:
+
+    bool pop(CursorSample&);
+
+    // Ring filled by the mouse handler, its size is a power of two
+    vector<CursorSample> ring;
+    size_t mask;
+
+    // Written only by the producer and the consumer respectively
+    atomic<size_t> write_index;
+    atomic<size_t> read_index;
+
+    // Samples the producer could not store because the ring was full
+    atomic<long> dropped_samples;
+
+    // Collected samples covering the summary window
+    deque<CursorSample> history;
+
+    // Length of the summarized window in nanoseconds
+    int64_t window;
+
+    // CURSOR_SUMMARY_LAST, CURSOR_SUMMARY_MEDIAN or CURSOR_SUMMARY_DWELL
+    int method;
+
+    // Distance the cursor traveled since the last call to take_path_length
+    double path_length;
+
+    // Last collected sample, valid once samples is above 0
+    CursorSample last_sample;
+
+    // Raw samples with the frame they were collected in, NULL if not kept
+    FILE * trace_file;
+
+    // Number of collected samples
+    long samples;
+
+};
+
+#endif /* CURSORSAMPLER_HPP */
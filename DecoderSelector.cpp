@@ -0,0 +1,337 @@
+/*
+ * File:   DecoderSelector.cpp
+ * Author: Jan Dufek
+ */
+
+#include <sys/stat.h>
+#include <iostream>
+#include <fstream>
+#include "DecoderSelector.hpp"
+
+static const char DECODER_CACHE_MAGIC[] = "GTLDEC02";
+
+/**
+ * Creates a selector of the capture backend for a video.
+ *
+ * @param video video file or stream
+ * @param frames number of frames decoded per configuration when probing
+ * @param height frame height requested from the source, 0 for its default.
+ * Cameras capture at the nearest supported resolution, video files ignore it.
+ */
+DecoderSelector::DecoderSelector(string video, int frames, int height) {
+
+    video_file_name = video;
+    probe_frames = frames;
+    frame_height = height;
+
+    configuration.backend = DECODER_BACKEND_ANY;
+    configuration.fps = 0;
+}
+
+DecoderSelector::DecoderSelector(const DecoderSelector& orig) {
+}
+
+DecoderSelector::~DecoderSelector() {
+}
+
+/**
+ * Get the name of a backend.
+ *
+ * @param backend DecoderBackend
+ * @return name
+ */
+string DecoderSelector::get_backend_name(int backend) {
+
+    switch (backend) {
+        case DECODER_BACKEND_AUTO:
+            return "auto";
+        case DECODER_BACKEND_ANY:
+            return "default";
+        case DECODER_BACKEND_FFMPEG:
+            return "FFmpeg";
+        case DECODER_BACKEND_GSTREAMER:
+            return "GStreamer";
+        case DECODER_BACKEND_AVFOUNDATION:
+            return "AVFoundation";
+    }
+
+    return "unknown";
+}
+
+/**
+ * Get the OpenCV capture API of a backend.
+ *
+ * @param backend DecoderBackend
+ * @return capture API
+ */
+static int get_capture_api(int backend) {
+
+    switch (backend) {
+        case DECODER_BACKEND_FFMPEG:
+            return CAP_FFMPEG;
+        case DECODER_BACKEND_GSTREAMER:
+            return CAP_GSTREAMER;
+        case DECODER_BACKEND_AVFOUNDATION:
+            return CAP_AVFOUNDATION;
+    }
+
+    return CAP_ANY;
+}
+
+/**
+ * Get the size and the modification time of the video file.
+ *
+ * @param file_name video file
+ * @param size size in bytes
+ * @param time modification time
+ * @return false if it is not a regular file, e.g., a stream
+ */
+static bool read_video_file_status(const string& file_name, int64_t& size, int64_t& time) {
+
+    struct stat file_status;
+
+    if (stat(file_name.c_str(), &file_status) != 0 || !S_ISREG(file_status.st_mode)) {
+        return false;
+    }
+
+    size = file_status.st_size;
+    time = file_status.st_mtime;
+
+    return true;
+}
+
+/**
+ * Choose the configuration the video is opened with. An explicit backend is
+ * used as it is. The automatic choice decodes the beginning of the video with
+ * every available backend and keeps the fastest one that decodes frames of the
+ * same size. The choice is cached next to the video. Streams are opened with
+ * the default backend since probing would consume them. The backends keep
+ * their own options, e.g., their decoder threads and RTSP transport.
+ *
+ * @param backend DecoderBackend
+ * @return false if no backend can decode the video
+ */
+bool DecoderSelector::select(int backend) {
+
+    configuration.backend = backend == DECODER_BACKEND_AUTO ? DECODER_BACKEND_ANY : backend;
+    configuration.fps = 0;
+
+    int64_t size;
+    int64_t time;
+
+    if (backend != DECODER_BACKEND_AUTO || !read_video_file_status(video_file_name, size, time)) {
+        return true;
+    }
+
+    if (load_cache()) {
+        cout << "Decoder: " << get_backend_name(configuration.backend) << " (" << configuration.fps << " fps when probed, cached)" << endl;
+        return true;
+    }
+
+    DecoderConfiguration candidates[] = {
+        {DECODER_BACKEND_ANY, 0},
+        {DECODER_BACKEND_FFMPEG, 0},
+        {DECODER_BACKEND_GSTREAMER, 0},
+#ifdef __APPLE__
+        {DECODER_BACKEND_AVFOUNDATION, 0},
+#endif
+    };
+
+    // Frames of other sizes would shift the labels
+    Size reference_size;
+
+    bool found = false;
+
+    for (size_t i = 0; i < sizeof (candidates) / sizeof (candidates[0]); i++) {
+
+        Size candidate_size;
+
+        candidates[i].fps = measure(candidates[i], candidate_size);
+
+        if (candidates[i].fps <= 0) {
+            continue;
+        }
+
+        if (reference_size.area() == 0) {
+            reference_size = candidate_size;
+        } else if (candidate_size != reference_size) {
+            cout << "Decoder probe: " << get_backend_name(candidates[i].backend) << " decodes " << candidate_size.width << "x" << candidate_size.height << " frames, skipped" << endl;
+            continue;
+        }
+
+        cout << "Decoder probe: " << get_backend_name(candidates[i].backend) << ": " << candidates[i].fps << " fps" << endl;
+
+        if (!found || candidates[i].fps > configuration.fps) {
+            configuration = candidates[i];
+            found = true;
+        }
+    }
+
+    if (!found) {
+        configuration.backend = DECODER_BACKEND_ANY;
+        configuration.fps = 0;
+        return false;
+    }
+
+    cout << "Decoder: " << get_backend_name(configuration.backend) << " (" << configuration.fps << " fps)" << endl;
+
+    if (!save_cache()) {
+        cout << "Cannot save decoder choice " << get_cache_file_name() << endl;
+    }
+
+    return true;
+}
+
+/**
+ * Open the video with the selected configuration.
+ *
+ * @param video_capture capture to open
+ * @return false if the video cannot be opened
+ */
+bool DecoderSelector::open(VideoCapture& video_capture) {
+    return open(video_capture, configuration);
+}
+
+/**
+ * Open the video with the given configuration.
+ *
+ * @param video_capture capture to open
+ * @param decoder configuration
+ * @return false if the video cannot be opened
+ */
+bool DecoderSelector::open(VideoCapture& video_capture, const DecoderConfiguration& decoder) {
+
+    if (!video_capture.open(video_file_name, get_capture_api(decoder.backend))) {
+        return false;
+    }
+
+    if (frame_height > 0) {
+
+        double width = video_capture.get(CV_CAP_PROP_FRAME_WIDTH);
+        double height = video_capture.get(CV_CAP_PROP_FRAME_HEIGHT);
+
+        if (height > frame_height) {
+            video_capture.set(CV_CAP_PROP_FRAME_WIDTH, (int) (width * frame_height / height + 0.5));
+            video_capture.set(CV_CAP_PROP_FRAME_HEIGHT, frame_height);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Measure the decoding speed of a configuration. The first frame is not
+ * counted since it includes the decoder setup.
+ *
+ * @param decoder configuration
+ * @param frame_size size of the decoded frames
+ * @return frames per second, 0 if the configuration cannot decode the video
+ */
+double DecoderSelector::measure(const DecoderConfiguration& decoder, Size& frame_size) {
+
+    VideoCapture video_capture;
+
+    if (!open(video_capture, decoder)) {
+        return 0;
+    }
+
+    Mat frame;
+
+    if (!video_capture.read(frame) || frame.empty()) {
+        return 0;
+    }
+
+    frame_size = frame.size();
+
+    int64 start = getTickCount();
+    int frames = 0;
+
+    while (frames < probe_frames && video_capture.read(frame)) {
+        frames++;
+    }
+
+    double seconds = (getTickCount() - start) / getTickFrequency();
+
+    return frames > 0 && seconds > 0 ? frames / seconds : 0;
+}
+
+/**
+ * Get the name of the file the choice is cached in.
+ *
+ * @return cache file name
+ */
+string DecoderSelector::get_cache_file_name() {
+    return video_file_name + ".decoder";
+}
+
+/**
+ * Load the cached choice. It is valid for the same video file and frame
+ * height.
+ *
+ * @return false if there is no valid cached choice
+ */
+bool DecoderSelector::load_cache() {
+
+    int64_t size;
+    int64_t time;
+
+    if (!read_video_file_status(video_file_name, size, time)) {
+        return false;
+    }
+
+    ifstream cache_file(get_cache_file_name().c_str());
+
+    string magic;
+    int64_t cached_size;
+    int64_t cached_time;
+    int cached_frame_height;
+    DecoderConfiguration cached;
+
+    if (!(cache_file >> magic >> cached_size >> cached_time >> cached_frame_height >> cached.backend >> cached.fps)) {
+        return false;
+    }
+
+    if (magic != DECODER_CACHE_MAGIC || cached_size != size || cached_time != time || cached_frame_height != frame_height) {
+        return false;
+    }
+
+    if (cached.backend < DECODER_BACKEND_ANY || cached.backend > DECODER_BACKEND_AVFOUNDATION) {
+        return false;
+    }
+
+    configuration = cached;
+
+    return true;
+}
+
+/**
+ * Save the choice next to the video.
+ *
+ * @return false if the cache file cannot be written
+ */
+bool DecoderSelector::save_cache() {
+
+    int64_t size;
+    int64_t time;
+
+    if (!read_video_file_status(video_file_name, size, time)) {
+        return false;
+    }
+
+    ofstream cache_file(get_cache_file_name().c_str(), ios::trunc);
+
+    cache_file << DECODER_CACHE_MAGIC << endl;
+    cache_file << size << " " << time << " " << frame_height << endl;
+    cache_file << configuration.backend << " " << configuration.fps << endl;
+
+    return cache_file.good();
+}
+
+/**
+ * Get the selected configuration.
+ *
+ * @return configuration
+ */
+DecoderConfiguration DecoderSelector::get_configuration() {
+    return configuration;
+}
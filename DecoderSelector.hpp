@@ -0,0 +1,63 @@
+/*
+ * File:   DecoderSelector.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef DECODERSELECTOR_HPP
+#define DECODERSELECTOR_HPP
+
+#include <stdint.h>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+#include "SettingTypes.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Backend a video is opened with and its decoding speed when probed
+struct DecoderConfiguration {
+    int backend;
+    double fps;
+};
+
+class DecoderSelector {
+public:
+    DecoderSelector(string, int, int);
+    DecoderSelector(const DecoderSelector& orig);
+    virtual ~DecoderSelector();
+
+    bool select(int);
+
+    bool open(VideoCapture&);
+
+    DecoderConfiguration get_configuration();
+
+    string get_cache_file_name();
+
+    static string get_backend_name(int);
+
+private:
+
+    bool open(VideoCapture&, const DecoderConfiguration&);
+
+    double measure(const DecoderConfiguration&, Size&);
+
+    bool load_cache();
+
+    bool save_cache();
+
+    // Video file or stream
+    string video_file_name;
+
+    // Number of frames decoded per probed configuration
+    int probe_frames;
+
+    // Frame height requested from the source, 0 for its default
+    int frame_height;
+
+    // Selected configuration
+    DecoderConfiguration configuration;
+
+};
+
+#endif /* DECODERSELECTOR_HPP */
@@ -0,0 +1,359 @@
+/* 
+ * File:   DisplayPipeline.cpp
+ * Author: Jan Dufek
+ */
+
+#include "DisplayPipeline.hpp"
+
+// Number of rows of the destination resized by one task
+static const int STRIPE_HEIGHT = 64;
+
+/**
+ * Warps horizontal stripes of the destination in parallel. Every stripe maps
+ * its pixel centers to the source with the same scaling and offset, so the
+ * stripes join seamlessly. Only the source pixels under the destination are
+ * read. Pixels are sampled bilinearly, which skips source pixels when
+ * shrinking by more than 2, so larger ratios go through the pyramid.
+ */
+class StripedWarp : public ParallelLoopBody {
+public:
+
+    StripedWarp(const Mat& s, Mat& d, double sx, double sy, double ox, double oy) : source(s), destination(d), scale_x(sx), scale_y(sy), offset_x(ox), offset_y(oy) {
+    }
+
+    void operator()(const Range& range) const {
+
+        for (int stripe = range.start; stripe < range.end; stripe++) {
+
+            int first_row = stripe * STRIPE_HEIGHT;
+            int last_row = min(first_row + STRIPE_HEIGHT, destination.rows);
+
+            // Destination pixel centers mapped to source pixel centers
+            Mat transformation = (Mat_<double>(2, 3) <<
+                    scale_x, 0, offset_x,
+                    0, scale_y, offset_y + first_row * scale_y);
+
+            Mat band = destination.rowRange(first_row, last_row);
+
+            warpAffine(source, band, transformation, band.size(), INTER_LINEAR | WARP_INVERSE_MAP, BORDER_REPLICATE);
+        }
+    }
+
+private:
+
+    const Mat& source;
+    Mat& destination;
+
+    // Source pixels per destination pixel
+    double scale_x;
+    double scale_y;
+
+    // Source pixel center of the first destination pixel
+    double offset_x;
+    double offset_y;
+
+};
+
+/**
+ * Creates the pipeline building the shown frames from full resolution frames.
+ * 
+ * @param source_frame_size size of the full resolution frames
+ * @param display_frame_size size of the shown frames
+ */
+DisplayPipeline::DisplayPipeline(Size source_frame_size, Size display_frame_size) {
+    source_size = source_frame_size;
+    display_size = display_frame_size;
+
+    // Halve until the whole frame is shown at most 2:1 from the last level
+    double base_scale = min((double) source_size.width / display_size.width, (double) source_size.height / display_size.height);
+
+    pyramid_levels = 0;
+
+    while ((1 << (pyramid_levels + 1)) < base_scale) {
+        pyramid_levels++;
+    }
+
+    pyramid.resize(pyramid_levels);
+
+    zoom = 1;
+    maximum_zoom = 1;
+    view_changed = false;
+}
+
+DisplayPipeline::DisplayPipeline(const DisplayPipeline& orig) {
+}
+
+DisplayPipeline::~DisplayPipeline() {
+}
+
+/**
+ * Resize the source into the destination of the requested size in parallel
+ * stripes. Meant for ratios up to 2, i.e., for building the pyramid.
+ * 
+ * @param source source image
+ * @param destination destination image, its size has to be set
+ */
+void DisplayPipeline::resize_striped(const Mat& source, Mat& destination) {
+
+    int stripes = (destination.rows + STRIPE_HEIGHT - 1) / STRIPE_HEIGHT;
+
+    double scale_x = (double) source.cols / destination.cols;
+    double scale_y = (double) source.rows / destination.rows;
+
+    // Sampled at the center of each 2x2 block when halving, so the bilinear
+    // weights average the block
+    parallel_for_(Range(0, stripes), StripedWarp(source, destination, scale_x, scale_y, 0.5 * scale_x - 0.5, 0.5 * scale_y - 0.5));
+}
+
+/**
+ * Build the pyramid levels and the shown frame from a new full resolution
+ * frame. Buffers are reused between frames.
+ * 
+ * @param frame full resolution frame
+ */
+void DisplayPipeline::build(const Mat& frame) {
+
+    source = frame;
+
+    // Each level halves the previous one
+    for (int i = 0; i < pyramid_levels; i++) {
+
+        const Mat& previous = i == 0 ? frame : pyramid[i - 1];
+
+        pyramid[i].create(Size((previous.cols + 1) / 2, (previous.rows + 1) / 2), frame.type());
+        resize_striped(previous, pyramid[i]);
+    }
+
+    render();
+}
+
+/**
+ * Render the shown region of the current frame into the shown frame. The
+ * region is sampled from the smallest pyramid level that still has at least
+ * the shown resolution, at most 2:1, so the cost depends on the display size
+ * only, not on the zoom nor on the source size.
+ */
+void DisplayPipeline::render() {
+
+    view_changed = false;
+
+    if (source.empty()) {
+        return;
+    }
+
+    // No copy if the whole frame is shown in full resolution
+    if (zoom == 1 && source.size() == display_size) {
+        display = source;
+        return;
+    }
+
+    // Do not write into a buffer shared with the source
+    if (display.data == source.data) {
+        display.release();
+    }
+
+    display.create(display_size, source.type());
+
+    // Original pixels per shown pixel
+    double scale_x = source_size.width / (display_size.width * zoom);
+    double scale_y = source_size.height / (display_size.height * zoom);
+
+    // Cached frames may be smaller than the original frames, so the levels
+    // are chosen by their actual size
+    int level = 0;
+
+    while (level < pyramid_levels) {
+
+        const Mat& next = get_level(level + 1);
+
+        if (min(next.cols * scale_x / source_size.width, next.rows * scale_y / source_size.height) < 1) {
+            break;
+        }
+
+        level++;
+    }
+
+    const Mat& image = get_level(level);
+
+    double level_x = (double) image.cols / source_size.width;
+    double level_y = (double) image.rows / source_size.height;
+
+    int stripes = (display.rows + STRIPE_HEIGHT - 1) / STRIPE_HEIGHT;
+
+    parallel_for_(Range(0, stripes), StripedWarp(image, display, level_x * scale_x, level_y * scale_y, level_x * (view_origin.x + 0.5 * scale_x) - 0.5, level_y * (view_origin.y + 0.5 * scale_y) - 0.5));
+}
+
+/**
+ * Zoom keeping the original pixel under the given display point in place.
+ * 
+ * @param point display coordinates, e.g., of the cursor
+ * @param factor zoom factor, larger than 1 to zoom in
+ */
+void DisplayPipeline::zoom_at(Point2f point, double factor) {
+
+    Point2f anchor = to_source(point);
+
+    zoom = min(max(zoom * factor, 1.0), maximum_zoom);
+
+    double scale_x = source_size.width / (display_size.width * zoom);
+    double scale_y = source_size.height / (display_size.height * zoom);
+
+    view_origin = Point2f(anchor.x + 0.5 - (point.x + 0.5) * scale_x, anchor.y + 0.5 - (point.y + 0.5) * scale_y);
+
+    clamp_view();
+}
+
+/**
+ * Move the shown region with the image.
+ * 
+ * @param offset movement of the image in display pixels
+ */
+void DisplayPipeline::pan(Point2f offset) {
+
+    view_origin.x -= offset.x * source_size.width / (display_size.width * zoom);
+    view_origin.y -= offset.y * source_size.height / (display_size.height * zoom);
+
+    clamp_view();
+}
+
+/**
+ * Show the whole frame again.
+ */
+void DisplayPipeline::reset_view() {
+
+    zoom = 1;
+    view_origin = Point2f(0, 0);
+
+    view_changed = true;
+}
+
+/**
+ * Keep the shown region within the frame.
+ */
+void DisplayPipeline::clamp_view() {
+
+    float maximum_x = source_size.width - source_size.width / zoom;
+    float maximum_y = source_size.height - source_size.height / zoom;
+
+    view_origin.x = min(max(view_origin.x, 0.0f), maximum_x);
+    view_origin.y = min(max(view_origin.y, 0.0f), maximum_y);
+
+    view_changed = true;
+}
+
+/**
+ * Set the largest zoom.
+ * 
+ * @param maximum shown pixels per original pixel at the largest zoom, relative
+ * to the whole frame
+ */
+void DisplayPipeline::set_maximum_zoom(double maximum) {
+    maximum_zoom = max(maximum, 1.0);
+}
+
+/**
+ * Get the zoom.
+ * 
+ * @return magnification, 1 if the whole frame is shown
+ */
+double DisplayPipeline::get_zoom() {
+    return zoom;
+}
+
+/**
+ * Get the size of one original pixel on the screen, including the zoom.
+ * 
+ * @return display pixels per original pixel
+ */
+double DisplayPipeline::get_scale() {
+    return display_size.width * zoom / source_size.width;
+}
+
+/**
+ * Check whether the view changed since the shown frame was rendered.
+ * 
+ * @return true if the shown frame has to be rendered again
+ */
+bool DisplayPipeline::is_view_changed() {
+    return view_changed;
+}
+
+/**
+ * Get the shown frame.
+ * 
+ * @return frame in display resolution
+ */
+const Mat& DisplayPipeline::get_display() {
+    return display;
+}
+
+/**
+ * Get a pyramid level.
+ * 
+ * @param level 0 for the full resolution frame, each level halves it
+ * @return frame of the level
+ */
+const Mat& DisplayPipeline::get_level(int level) {
+
+    if (level <= 0 || pyramid_levels == 0) {
+        return source;
+    }
+
+    return pyramid[min(level, pyramid_levels) - 1];
+}
+
+/**
+ * Get the number of halved pyramid levels.
+ * 
+ * @return number of levels
+ */
+int DisplayPipeline::get_pyramid_levels() {
+    return pyramid_levels;
+}
+
+/**
+ * Get the size of the full resolution frames.
+ * 
+ * @return source size
+ */
+Size DisplayPipeline::get_source_size() {
+    return source_size;
+}
+
+/**
+ * Get the size of the shown frames.
+ * 
+ * @return display size
+ */
+Size DisplayPipeline::get_display_size() {
+    return display_size;
+}
+
+/**
+ * Map display coordinates to original pixel coordinates within the shown
+ * region. Pixel centers map to pixel centers, exactly inverting the rendering.
+ * 
+ * @param point display coordinates
+ * @return original pixel coordinates
+ */
+Point2f DisplayPipeline::to_source(Point2f point) {
+
+    double scale_x = source_size.width / (display_size.width * zoom);
+    double scale_y = source_size.height / (display_size.height * zoom);
+
+    return Point2f(view_origin.x + (point.x + 0.5) * scale_x - 0.5, view_origin.y + (point.y + 0.5) * scale_y - 0.5);
+}
+
+/**
+ * Map original pixel coordinates to display coordinates.
+ * 
+ * @param point original pixel coordinates
+ * @return display coordinates
+ */
+Point2f DisplayPipeline::to_display(Point2f point) {
+
+    double scale_x = display_size.width * zoom / source_size.width;
+    double scale_y = display_size.height * zoom / source_size.height;
+
+    return Point2f((point.x + 0.5 - view_origin.x) * scale_x - 0.5, (point.y + 0.5 - view_origin.y) * scale_y - 0.5);
+}
@@ -0,0 +1,91 @@
+/* 
+ * File:   DisplayPipeline.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef DISPLAYPIPELINE_HPP
+#define DISPLAYPIPELINE_HPP
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+using namespace std;
+using namespace cv;
+
+class DisplayPipeline {
+public:
+    DisplayPipeline(Size, Size);
+    DisplayPipeline(const DisplayPipeline& orig);
+    virtual ~DisplayPipeline();
+
+    void build(const Mat&);
+
+    const Mat& get_display();
+
+    const Mat& get_level(int);
+
+    int get_pyramid_levels();
+
+    Size get_source_size();
+
+    Size get_display_size();
+
+    Point2f to_source(Point2f);
+
+    Point2f to_display(Point2f);
+
+    void render();
+
+    void zoom_at(Point2f, double);
+
+    void pan(Point2f);
+
+    void reset_view();
+
+    void set_maximum_zoom(double);
+
+    double get_zoom();
+
+    double get_scale();
+
+    bool is_view_changed();
+
+    static void resize_striped(const Mat&, Mat&);
+
+private:
+
+    // Size of the full resolution frames
+    Size source_size;
+
+    // Size of the shown frames
+    Size display_size;
+
+    // Number of halved pyramid levels, enough to show the whole frame
+    int pyramid_levels;
+
+    // Shown frame, shares the data with the source if no resizing is needed
+    Mat display;
+
+    // Full resolution frame
+    Mat source;
+
+    // Pyramid levels halving the resolution, the first is half of the source
+    vector<Mat> pyramid;
+
+    void clamp_view();
+
+    // Magnification of the shown region, 1 shows the whole frame
+    double zoom;
+    double maximum_zoom;
+
+    // Top left corner of the shown region in original pixel coordinates,
+    // measured from the edge of the frame
+    Point2f view_origin;
+
+    // The view changed since the shown frame was rendered
+    bool view_changed;
+
+};
+
+#endif /* DISPLAYPIPELINE_HPP */
+
@@ -0,0 +1,275 @@
+/* 
+ * File:   FrameCache.cpp
+ * Author: Jan Dufek
+ */
+
+#include <iostream>
+#include "FrameCache.hpp"
+
+/**
+ * Creates a least recently used cache of decoded frames.
+ * 
+ * @param budget_bytes maximum memory used by the cached frames
+ * @param height height of the downscaled copies kept instead of the full
+ * resolution frames, 0 to keep the full resolution frames
+ */
+FrameCache::FrameCache(size_t budget_bytes, int height) {
+    budget = budget_bytes;
+    display_height = height;
+    used_bytes = 0;
+    hits = 0;
+    misses = 0;
+}
+
+FrameCache::FrameCache(const FrameCache& orig) {
+}
+
+FrameCache::~FrameCache() {
+}
+
+/**
+ * Get a cached frame in its original resolution. Full resolution frames share
+ * the data with the cache and must not be modified. Downscaled copies are
+ * scaled back up into a new frame so that the labeling coordinates stay in
+ * the original resolution.
+ * 
+ * @param frame_number number of the frame
+ * @param frame receives the frame
+ * @return true if the frame was cached
+ */
+bool FrameCache::get(long frame_number, Mat& frame) {
+
+    Mat cached_frame;
+    Size original_size;
+
+    {
+        lock_guard<mutex> lock(cache_mutex);
+
+        map<long, list<Entry>::iterator>::iterator found = lookup.find(frame_number);
+
+        if (found == lookup.end()) {
+            misses++;
+            return false;
+        }
+
+        hits++;
+
+        // Mark as the most recently used
+        entries.splice(entries.begin(), entries, found->second);
+
+        cached_frame = found->second->frame;
+        original_size = found->second->original_size;
+    }
+
+    if (cached_frame.size() != original_size) {
+        Mat upscaled_frame;
+        resize(cached_frame, upscaled_frame, original_size, 0, 0, INTER_LINEAR);
+        frame = upscaled_frame;
+    } else {
+        frame = cached_frame;
+    }
+
+    return true;
+}
+
+/**
+ * Check whether frames of the given size are kept as downscaled copies.
+ * 
+ * @param size size of the frame
+ * @return true if the frames are downscaled
+ */
+bool FrameCache::is_downscaled(Size size) {
+    return display_height > 0 && size.height > display_height;
+}
+
+/**
+ * Get the memory the cached frame would use, without copying it.
+ * 
+ * @param frame frame to cache
+ * @return bytes
+ */
+size_t FrameCache::get_entry_bytes(const Mat& frame) {
+
+    if (is_downscaled(frame.size())) {
+        return (size_t) (frame.cols * display_height / frame.rows) * display_height * frame.elemSize();
+    }
+
+    return frame.total() * frame.elemSize();
+}
+
+/**
+ * Evict the least recently used frames until the given memory fits into the
+ * budget. Called with the lock held.
+ * 
+ * @param bytes memory needed
+ * @param size size of the frame to be cached
+ * @param type type of the frame to be cached
+ * @param recycled receives the buffer of an evicted frame of the same size
+ * and type if it is empty and nobody else holds the buffer
+ */
+void FrameCache::evict(size_t bytes, Size size, int type, Mat& recycled) {
+
+    while (!entries.empty() && used_bytes + bytes > budget) {
+
+        Entry& entry = entries.back();
+
+        used_bytes -= entry.bytes;
+
+        // Frames handed out by get may still be shown
+        if (recycled.empty() && entry.frame.size() == size && entry.frame.type() == type && entry.frame.u != NULL && entry.frame.u->refcount == 1) {
+            swap(recycled, entry.frame);
+        }
+
+        lookup.erase(entry.frame_number);
+        entries.pop_back();
+    }
+}
+
+/**
+ * Store a copy of the frame, downscaled if configured, and evict the least
+ * recently used frames until the cache fits into its memory budget. The copy
+ * is made into the buffer of an evicted frame. Frames that do not fit or are
+ * cached already are not copied at all.
+ * 
+ * @param frame_number number of the frame
+ * @param frame frame to cache
+ */
+void FrameCache::put(long frame_number, const Mat& frame) {
+
+    Entry entry;
+    entry.frame_number = frame_number;
+    entry.original_size = frame.size();
+    entry.bytes = get_entry_bytes(frame);
+
+    {
+        lock_guard<mutex> lock(cache_mutex);
+
+        // Also frames decoded again after a seek are not copied again
+        if (entry.bytes == 0 || entry.bytes > budget || lookup.count(frame_number) > 0) {
+            return;
+        }
+
+        swap(entry.frame, spare_frame);
+    }
+
+    // Copy or downscale outside of the lock
+    if (is_downscaled(frame.size())) {
+        Size display_size(frame.cols * display_height / frame.rows, display_height);
+        resize(frame, entry.frame, display_size, 0, 0, INTER_AREA);
+    } else {
+        frame.copyTo(entry.frame);
+    }
+
+    lock_guard<mutex> lock(cache_mutex);
+
+    if (lookup.count(frame_number) > 0) {
+        return;
+    }
+
+    evict(entry.bytes, entry.frame.size(), entry.frame.type(), spare_frame);
+
+    entries.push_front(entry);
+    lookup[frame_number] = entries.begin();
+    used_bytes += entry.bytes;
+}
+
+/**
+ * Store the frame without copying it, the cache takes over its buffer. The
+ * frame receives the buffer of an evicted frame of the same size to decode
+ * into, or an empty matrix. Frames that are kept downscaled, do not fit or
+ * are cached already are left as they are.
+ * 
+ * @param frame_number number of the frame
+ * @param frame frame to cache, receives a free buffer
+ */
+void FrameCache::take(long frame_number, Mat& frame) {
+
+    if (frame.empty() || is_downscaled(frame.size())) {
+        return;
+    }
+
+    size_t bytes = get_entry_bytes(frame);
+
+    lock_guard<mutex> lock(cache_mutex);
+
+    if (bytes > budget || lookup.count(frame_number) > 0) {
+        return;
+    }
+
+    Mat recycled;
+    evict(bytes, frame.size(), frame.type(), recycled);
+
+    Entry entry;
+    entry.frame_number = frame_number;
+    entry.frame = frame;
+    entry.original_size = frame.size();
+    entry.bytes = bytes;
+
+    entries.push_front(entry);
+    lookup[frame_number] = entries.begin();
+    used_bytes += entry.bytes;
+
+    frame = recycled;
+}
+
+/**
+ * Remove all cached frames.
+ * 
+ */
+void FrameCache::clear() {
+    lock_guard<mutex> lock(cache_mutex);
+    entries.clear();
+    lookup.clear();
+    spare_frame.release();
+    used_bytes = 0;
+}
+
+/**
+ * Get the number of cached frames.
+ * 
+ * @return number of frames
+ */
+int FrameCache::get_size() {
+    lock_guard<mutex> lock(cache_mutex);
+    return entries.size();
+}
+
+/**
+ * Get the memory used by the cached frames.
+ * 
+ * @return bytes
+ */
+size_t FrameCache::get_used_bytes() {
+    lock_guard<mutex> lock(cache_mutex);
+    return used_bytes;
+}
+
+/**
+ * Get the number of lookups that found the frame.
+ * 
+ * @return number of hits
+ */
+long FrameCache::get_hits() {
+    lock_guard<mutex> lock(cache_mutex);
+    return hits;
+}
+
+/**
+ * Get the number of lookups that did not find the frame.
+ * 
+ * @return number of misses
+ */
+long FrameCache::get_misses() {
+    lock_guard<mutex> lock(cache_mutex);
+    return misses;
+}
+
+/**
+ * Print cache statistics to the console.
+ * 
+ */
+void FrameCache::print_statistics() {
+    cout << "Frame cache: " << get_size() << " frames, " << get_used_bytes() / (1024 * 1024) << " MB" << endl;
+    cout << "Frame cache hits: " << get_hits() << endl;
+    cout << "Frame cache misses: " << get_misses() << endl;
+}
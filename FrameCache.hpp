@@ -0,0 +1,92 @@
+/* 
+ * File:   FrameCache.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMECACHE_HPP
+#define FRAMECACHE_HPP
+
+#include <list>
+#include <map>
+#include <mutex>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+using namespace std;
+using namespace cv;
+
+class FrameCache {
+public:
+    FrameCache(size_t, int);
+    FrameCache(const FrameCache& orig);
+    virtual ~FrameCache();
+
+    bool get(long, Mat&);
+
+    void put(long, const Mat&);
+
+    void take(long, Mat&);
+
+    bool is_downscaled(Size);
+
+    void clear();
+
+    int get_size();
+
+    size_t get_used_bytes();
+
+    long get_hits();
+
+    long get_misses();
+
+    void print_statistics();
+
+private:
+
+    size_t get_entry_bytes(const Mat&);
+
+    void evict(size_t, Size, int, Mat&);
+
+    // Cached frame
+    struct Entry {
+        long frame_number;
+
+        // Full resolution frame or its downscaled copy
+        Mat frame;
+
+        // Size of the original frame
+        Size original_size;
+
+        // Memory used by the frame
+        size_t bytes;
+    };
+
+    // Maximum memory used by the cached frames
+    size_t budget;
+
+    // Height of the downscaled copies, 0 to cache full resolution frames
+    int display_height;
+
+    // Memory used by the cached frames
+    size_t used_bytes;
+
+    // Cached frames, the most recently used first
+    list<Entry> entries;
+
+    // Position of each cached frame in the list
+    map<long, list<Entry>::iterator> lookup;
+
+    // Buffer of an evicted frame the next copy is made into
+    Mat spare_frame;
+
+    // Statistics
+    long hits;
+    long misses;
+
+    // Frames are put by the decoder thread and taken by the labeling loop
+    mutex cache_mutex;
+
+};
+
+#endif /* FRAMECACHE_HPP */
+
@@ -0,0 +1,471 @@
+/* 
+ * File:   FramePrefetcher.cpp
+ * Author: Jan Dufek
+ */
+
+#include <iostream>
+#include <algorithm>
+#include "FramePrefetcher.hpp"
+#include "TimingTrace.hpp"
+
+/**
+ * Creates a prefetcher decoding ahead from the given video capture.
+ * 
+ * @param capture video capture to decode from
+ * @param depth number of frames decoded ahead
+ * @param frame_size size of the frames used to pre-allocate the buffers
+ * @param index seek points of the video, may be NULL
+ * @param cache cache receiving the frames, may be NULL
+ */
+FramePrefetcher::FramePrefetcher(VideoCapture& capture, int depth, Size frame_size, VideoIndex* index, FrameCache* cache) {
+
+    video_capture = &capture;
+    video_index = index;
+    frame_cache = cache;
+    handed_frame_number = -1;
+    undistorter = NULL;
+
+    // At least one frame has to fit into the ring
+    if (depth < 1) {
+        depth = 1;
+    }
+
+    // Pre-allocate the buffers so that decoding does not allocate per frame
+    buffers.resize(depth);
+    for (int i = 0; i < depth; i++) {
+        buffers[i].create(frame_size, CV_8UC3);
+    }
+
+    frame_numbers.resize(depth, -1);
+    signatures.resize(depth);
+    signature_width = 0;
+
+    head = 0;
+    count = 0;
+    end_of_stream = false;
+    stop_requested = false;
+
+    seek_requested = false;
+    seek_target = 0;
+    seek_generation = 0;
+    expected_frame_number = 0;
+    position = 0;
+    frame_step = 1;
+    live_source = false;
+
+    decoded_frames = 0;
+    underruns = 0;
+    total_decode_time = 0;
+    maximum_decode_time = 0;
+}
+
+FramePrefetcher::FramePrefetcher(const FramePrefetcher& orig) {
+}
+
+FramePrefetcher::~FramePrefetcher() {
+    stop();
+}
+
+/**
+ * Starts the producer thread.
+ * 
+ */
+void FramePrefetcher::start() {
+    if (!producer.joinable()) {
+        stop_requested = false;
+        producer = thread(&FramePrefetcher::run, this);
+    }
+}
+
+/**
+ * Stops the producer thread and waits for it to finish.
+ * 
+ */
+void FramePrefetcher::stop() {
+
+    {
+        lock_guard<mutex> lock(ring_mutex);
+        stop_requested = true;
+    }
+
+    buffer_available.notify_all();
+
+    if (producer.joinable()) {
+        producer.join();
+    }
+}
+
+/**
+ * Producer loop. Decodes frames into free buffers of the ring until the
+ * prefetcher is stopped. At the end of the stream it waits for a seek.
+ * 
+ */
+void FramePrefetcher::run() {
+
+    if (TimingTrace::get_active() != NULL) {
+        TimingTrace::get_active()->name_thread("decoder");
+    }
+
+    while (true) {
+
+        int slot;
+        int step;
+        long generation;
+        long target = -1;
+
+        // Wait for a free buffer or a seek
+        {
+            unique_lock<mutex> lock(ring_mutex);
+
+            while (!stop_requested && !seek_requested && (count == (int) buffers.size() || end_of_stream)) {
+                buffer_available.wait(lock);
+            }
+
+            if (stop_requested) {
+                return;
+            }
+
+            if (seek_requested) {
+                target = seek_target;
+                seek_requested = false;
+            }
+
+            slot = (head + count) % buffers.size();
+            step = frame_step;
+            generation = seek_generation;
+        }
+
+        // Reposition the decoder outside of the lock
+        if (target >= 0) {
+            position_decoder(target);
+        }
+
+        // Decode outside of the lock. The slot is not visible to the consumer
+        // until the count is increased.
+        ScopedTimer decode_timer("decode", position);
+        int64 start_ticks = getTickCount();
+        bool decoded;
+
+        if (undistorter != NULL) {
+
+            // Remap from the scratch buffer into the ring
+            decoded = video_capture->read(distorted_frame) && !distorted_frame.empty();
+
+            if (decoded) {
+                undistorter->undistort_frame(distorted_frame, buffers[slot]);
+            }
+
+        } else {
+            decoded = video_capture->read(buffers[slot]) && !buffers[slot].empty();
+        }
+
+        double decode_time = (getTickCount() - start_ticks) * 1000.0 / getTickFrequency();
+
+        long number = position;
+
+        if (decoded) {
+
+            // Frames a live source did not keep are skipped
+            if (live_source) {
+                number = max(number, (long) video_capture->get(CV_CAP_PROP_POS_FRAMES) - 1);
+            }
+
+            position = number + 1;
+
+            // Signature for comparing frames without touching the full frame
+            if (signature_width > 0) {
+
+                int height = max(1, buffers[slot].rows * signature_width / buffers[slot].cols);
+
+                resize(buffers[slot], signature_scratch, Size(signature_width, height), 0, 0, INTER_AREA);
+                cvtColor(signature_scratch, signatures[slot], COLOR_BGR2GRAY);
+            }
+
+            // Downscaled copies are made here, full resolution frames are
+            // cached without a copy when the consumer returns their buffer
+            if (frame_cache != NULL && frame_cache->is_downscaled(buffers[slot].size())) {
+                frame_cache->put(number, buffers[slot]);
+            }
+
+            // Skip the frames in between without color conversion
+            for (int i = 1; i < step && video_capture->grab(); i++) {
+                position++;
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(ring_mutex);
+
+            // Discard frames decoded before a seek
+            if (generation != seek_generation) {
+                continue;
+            }
+
+            if (!decoded) {
+                end_of_stream = true;
+            } else {
+                frame_numbers[slot] = number;
+                count++;
+                expected_frame_number = position;
+                decoded_frames++;
+                total_decode_time += decode_time;
+                if (decode_time > maximum_decode_time) {
+                    maximum_decode_time = decode_time;
+                }
+            }
+        }
+
+        frame_available.notify_one();
+    }
+}
+
+/**
+ * Position the decoder so that the next read returns the target frame. Jumps
+ * within the current group of pictures are decoded through, otherwise the
+ * decoder seeks to the last key frame at or before the target, where the
+ * backend seek lands exactly, and decodes forward from there.
+ * 
+ * @param target frame number
+ */
+void FramePrefetcher::position_decoder(long target) {
+
+    if (video_index != NULL && video_index->is_valid()) {
+
+        SeekPoint seek_point = video_index->get_seek_point(target);
+
+        if (target < position || seek_point.frame_number > position) {
+            video_capture->set(CV_CAP_PROP_POS_FRAMES, seek_point.frame_number);
+            position = seek_point.frame_number;
+        }
+
+    } else if (target != position) {
+
+        // Until the index is read rely on the backend seeking
+        video_capture->set(CV_CAP_PROP_POS_FRAMES, target);
+        position = target;
+
+    }
+
+    // Skip to the target without color conversion
+    while (position < target && video_capture->grab()) {
+        position++;
+    }
+}
+
+/**
+ * Hands off the next decoded frame. The frame is swapped with the buffer of
+ * the given matrix so no pixel data is copied and the previous buffer is
+ * reused for decoding. With a cache, the previous frame is moved into the
+ * cache and the buffer of an evicted frame is reused instead.
+ * 
+ * @param frame the frame returned by the previous call, receives the next
+ * frame, unchanged at the end of the stream
+ * @param frame_number receives the number of the frame
+ * @param signature receives the signature of the frame if not NULL, swapped
+ * like the frame
+ * @return false if there are no more frames
+ */
+bool FramePrefetcher::next_frame(Mat& frame, long& frame_number, Mat* signature) {
+
+    {
+        unique_lock<mutex> lock(ring_mutex);
+
+        if (count == 0 && !end_of_stream) {
+            underruns++;
+        }
+
+        while (count == 0 && !end_of_stream) {
+            frame_available.wait(lock);
+        }
+
+        if (count == 0) {
+            return false;
+        }
+
+        // Cache the frame the consumer is done with by taking over its buffer
+        if (frame_cache != NULL && handed_frame_number >= 0) {
+            frame_cache->take(handed_frame_number, frame);
+        }
+
+        swap(frame, buffers[head]);
+        frame_number = frame_numbers[head];
+        handed_frame_number = frame_number;
+
+        if (signature != NULL) {
+            swap(* signature, signatures[head]);
+        }
+
+        head = (head + 1) % buffers.size();
+        count--;
+    }
+
+    buffer_available.notify_one();
+
+    return true;
+}
+
+/**
+ * Hands the frame returned by the last call to next_frame to the cache before
+ * the consumer looks up other frames, so that it can be revisited.
+ * 
+ * @param frame the frame returned by the previous call to next_frame,
+ * receives a free buffer or an empty matrix
+ */
+void FramePrefetcher::return_frame(Mat& frame) {
+
+    if (frame_cache != NULL && handed_frame_number >= 0) {
+        frame_cache->take(handed_frame_number, frame);
+    }
+
+    handed_frame_number = -1;
+}
+
+/**
+ * Drops the decoded frames and restarts decoding at the given frame.
+ * 
+ * @param frame_number frame the next call to next_frame returns
+ */
+void FramePrefetcher::seek(long frame_number) {
+
+    {
+        lock_guard<mutex> lock(ring_mutex);
+
+        head = 0;
+        count = 0;
+        end_of_stream = false;
+
+        seek_requested = true;
+        seek_target = frame_number;
+        seek_generation++;
+
+        expected_frame_number = frame_number;
+    }
+
+    buffer_available.notify_one();
+}
+
+/**
+ * Decode only every step-th frame from the current position on.
+ * 
+ * @param step number of frames between two decoded frames
+ */
+void FramePrefetcher::set_frame_step(int step) {
+    lock_guard<mutex> lock(ring_mutex);
+    frame_step = step > 0 ? step : 1;
+}
+
+/**
+ * Undistort the decoded frames before they are cached and handed to the
+ * consumer. Has to be set before the prefetcher is started.
+ * 
+ * @param frame_undistorter prepared undistorter, NULL to disable
+ */
+void FramePrefetcher::set_undistorter(Undistorter* frame_undistorter) {
+    undistorter = frame_undistorter;
+}
+
+/**
+ * Number the frames by the position of the video capture instead of counting
+ * them, for captures that skip frames they did not keep. Has to be set before
+ * the prefetcher is started.
+ * 
+ * @param live the video capture may skip frames
+ */
+void FramePrefetcher::set_live_source(bool live) {
+    live_source = live;
+}
+
+/**
+ * Compute a downscaled grayscale signature of each decoded frame on the
+ * decoding thread. Has to be set before the prefetcher is started.
+ * 
+ * @param width width of the signatures, 0 to not compute them
+ */
+void FramePrefetcher::set_signature_width(int width) {
+    signature_width = max(width, 0);
+}
+
+/**
+ * Get the number of the frame the next call to next_frame returns.
+ * 
+ * @return frame number
+ */
+long FramePrefetcher::get_next_frame_number() {
+    lock_guard<mutex> lock(ring_mutex);
+    return count > 0 ? frame_numbers[head] : expected_frame_number;
+}
+
+/**
+ * Get the maximum number of frames decoded ahead.
+ * 
+ * @return queue depth
+ */
+int FramePrefetcher::get_queue_depth() {
+    return buffers.size();
+}
+
+/**
+ * Get the number of frames currently decoded ahead.
+ * 
+ * @return queue size
+ */
+int FramePrefetcher::get_queue_size() {
+    lock_guard<mutex> lock(ring_mutex);
+    return count;
+}
+
+/**
+ * Get the number of frames decoded so far.
+ * 
+ * @return number of decoded frames
+ */
+long FramePrefetcher::get_decoded_frames() {
+    lock_guard<mutex> lock(ring_mutex);
+    return decoded_frames;
+}
+
+/**
+ * Get how many times the consumer had to wait for the decoder.
+ * 
+ * @return number of underruns
+ */
+long FramePrefetcher::get_underruns() {
+    lock_guard<mutex> lock(ring_mutex);
+    return underruns;
+}
+
+/**
+ * Get average decode time of one frame.
+ * 
+ * @return decode time in milliseconds
+ */
+double FramePrefetcher::get_average_decode_time() {
+    lock_guard<mutex> lock(ring_mutex);
+    return decoded_frames > 0 ? total_decode_time / decoded_frames : 0;
+}
+
+/**
+ * Get the longest decode time of one frame.
+ * 
+ * @return decode time in milliseconds
+ */
+double FramePrefetcher::get_maximum_decode_time() {
+    lock_guard<mutex> lock(ring_mutex);
+    return maximum_decode_time;
+}
+
+/**
+ * Print prefetch statistics to the console.
+ * 
+ */
+void FramePrefetcher::print_statistics() {
+    cout << "Prefetch queue depth: " << get_queue_depth() << endl;
+    cout << "Decoded frames: " << get_decoded_frames() << endl;
+    cout << "Average decode time: " << get_average_decode_time() << " ms";
+    if (get_average_decode_time() > 0) {
+        cout << " (" << 1000 / get_average_decode_time() << " fps)";
+    }
+    cout << endl;
+    cout << "Maximum decode time: " << get_maximum_decode_time() << " ms" << endl;
+    cout << "Prefetch underruns: " << get_underruns() << endl;
+}
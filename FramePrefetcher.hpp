@@ -0,0 +1,154 @@
+/* 
+ * File:   FramePrefetcher.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMEPREFETCHER_HPP
+#define FRAMEPREFETCHER_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+#include "opencv2/imgproc.hpp"
+#include "VideoIndex.hpp"
+#include "FrameCache.hpp"
+#include "Undistorter.hpp"
+
+using namespace std;
+using namespace cv;
+
+class FramePrefetcher {
+public:
+    FramePrefetcher(VideoCapture&, int, Size, VideoIndex*, FrameCache*);
+    FramePrefetcher(const FramePrefetcher& orig);
+    virtual ~FramePrefetcher();
+
+    void start();
+
+    void stop();
+
+    bool next_frame(Mat&, long&, Mat* = NULL);
+
+    void return_frame(Mat&);
+
+    void seek(long);
+
+    void set_frame_step(int);
+
+    void set_undistorter(Undistorter*);
+
+    void set_live_source(bool);
+
+    void set_signature_width(int);
+
+    long get_next_frame_number();
+
+    int get_queue_depth();
+
+    int get_queue_size();
+
+    long get_decoded_frames();
+
+    long get_underruns();
+
+    double get_average_decode_time();
+
+    double get_maximum_decode_time();
+
+    void print_statistics();
+
+private:
+
+    void run();
+
+    void position_decoder(long);
+
+    // Video capture the frames are decoded from
+    VideoCapture * video_capture;
+
+    // Seek points of the video, NULL if not available
+    VideoIndex * video_index;
+
+    // Cache of recently decoded frames, NULL if not used
+    FrameCache * frame_cache;
+
+    // Number of the frame the consumer holds, -1 if none. Only used by the
+    // consumer.
+    long handed_frame_number;
+
+    // Removes the lens distortion from decoded frames, NULL if not used
+    Undistorter * undistorter;
+
+    // Decoded frame before undistortion. Only used by the producer.
+    Mat distorted_frame;
+
+    // Ring of pre-allocated frame buffers
+    vector<Mat> buffers;
+
+    // Frame number of each buffer in the ring
+    vector<long> frame_numbers;
+
+    // Downscaled grayscale signature of each buffer, empty if not computed
+    vector<Mat> signatures;
+
+    // Width of the signatures, 0 to not compute them
+    int signature_width;
+
+    // Downscaled color frame. Only used by the producer.
+    Mat signature_scratch;
+
+    // Index of the oldest decoded frame in the ring
+    int head;
+
+    // Number of decoded frames waiting in the ring
+    int count;
+
+    // The video capture did not return any more frames
+    bool end_of_stream;
+
+    // The producer thread should exit
+    bool stop_requested;
+
+    // The decoder should be positioned to the seek target
+    bool seek_requested;
+    long seek_target;
+
+    // Increased on each seek so that frames decoded before it are discarded
+    long seek_generation;
+
+    // Number of the frame the next call to next_frame returns
+    long expected_frame_number;
+
+    // Number of the frame the decoder reads next. Only used by the producer.
+    long position;
+
+    // Only every frame_step-th frame is decoded, the others are skipped
+    int frame_step;
+
+    // The video capture may skip frames, its position is read after each frame
+    bool live_source;
+
+    // Producer thread
+    thread producer;
+
+    // Protects the ring and the statistics
+    mutex ring_mutex;
+
+    // Signaled when a decoded frame is available
+    condition_variable frame_available;
+
+    // Signaled when a buffer is returned to the ring
+    condition_variable buffer_available;
+
+    // Statistics
+    long decoded_frames;
+    long underruns;
+    double total_decode_time;
+    double maximum_decode_time;
+
+};
+
+#endif /* FRAMEPREFETCHER_HPP */
+
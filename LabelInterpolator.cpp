@@ -0,0 +1,196 @@
+/* 
+ * File:   LabelInterpolator.cpp
+ * Author: Jan Dufek
+ */
+
+#include <algorithm>
+#include "LabelInterpolator.hpp"
+
+/**
+ * Creates an interpolator filling the frames between labeled frames.
+ * 
+ * @param gap gaps between labeled frames longer than this number of frames
+ * are not filled, e.g., when the recording was stopped
+ * @param interpolation_method INTERPOLATION_LINEAR or INTERPOLATION_SPLINE
+ */
+LabelInterpolator::LabelInterpolator(long gap, int interpolation_method) {
+    maximum_gap = gap;
+    method = interpolation_method;
+}
+
+LabelInterpolator::LabelInterpolator(const LabelInterpolator& orig) {
+}
+
+LabelInterpolator::~LabelInterpolator() {
+}
+
+/**
+ * Order labels by object and frame number. If an object was labeled more than
+ * once in a frame (e.g., after stepping back to fix a label), the last label
+ * is kept.
+ * 
+ * @param labels labels in the order they were written
+ * @param sorted receives one label per object and frame ordered by object and
+ * frame number
+ */
+void LabelInterpolator::sort_labels(const vector<LabelRecord>& labels, vector<LabelRecord>& sorted) {
+
+    sorted = labels;
+
+    stable_sort(sorted.begin(), sorted.end(), [](const LabelRecord& a, const LabelRecord & b) {
+        return a.object_id < b.object_id || (a.object_id == b.object_id && a.frame_number < b.frame_number);
+    });
+
+    // Keep the last label of each object in each frame
+    size_t count = 0;
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (count > 0 && sorted[count - 1].frame_number == sorted[i].frame_number && sorted[count - 1].object_id == sorted[i].object_id) {
+            sorted[count - 1] = sorted[i];
+        } else {
+            sorted[count++] = sorted[i];
+        }
+    }
+
+    sorted.resize(count);
+}
+
+/**
+ * Resample labels of each object to every frame. Frames between two labeled
+ * frames are interpolated and marked with LABEL_FLAG_INTERPOLATED.
+ * 
+ * @param labels labels in any order
+ * @param resampled receives one label per object and frame ordered by object
+ * and frame number
+ */
+void LabelInterpolator::resample(const vector<LabelRecord>& labels, vector<LabelRecord>& resampled) {
+
+    vector<LabelRecord> keys;
+    sort_labels(labels, keys);
+
+    interpolate(keys, resampled, true);
+}
+
+/**
+ * Interpolate the frames between labeled frames in one pass over the labels.
+ * 
+ * @param keys labeled frames, one per object and frame ordered by object and
+ * frame number
+ * @param output receives the labels ordered by object and frame number
+ * @param include_keys also output the labeled frames, otherwise only the
+ * interpolated frames are output
+ */
+void LabelInterpolator::interpolate(const vector<LabelRecord>& keys, vector<LabelRecord>& output, bool include_keys) {
+
+    output.clear();
+
+    if (keys.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < keys.size(); i++) {
+
+        if (include_keys) {
+            output.push_back(keys[i]);
+        }
+
+        // Segments do not cross objects
+        if (i + 1 < keys.size() && keys[i + 1].object_id == keys[i].object_id) {
+            interpolate_segment(keys, i, output);
+        }
+    }
+}
+
+/**
+ * Interpolate the frames between the labeled frames i and i + 1. The segment
+ * is evaluated as a cubic polynomial over the whole range at once, the linear
+ * interpolation is its special case, so the inner loop has no branches and
+ * can be vectorized.
+ * 
+ * @param keys labeled frames ordered by frame number
+ * @param i index of the first labeled frame of the segment
+ * @param output receives the interpolated labels
+ */
+void LabelInterpolator::interpolate_segment(const vector<LabelRecord>& keys, size_t i, vector<LabelRecord>& output) {
+
+    const LabelRecord& a = keys[i];
+    const LabelRecord& b = keys[i + 1];
+
+    long gap = b.frame_number - a.frame_number;
+
+    if (gap <= 1 || gap > maximum_gap) {
+        return;
+    }
+
+    // Coefficients of x(u) = ((ax * u + bx) * u + cx) * u + dx for u from 0 to 1
+    float ax = 0, bx = 0, cx = b.x - a.x, dx = a.x;
+    float ay = 0, by = 0, cy = b.y - a.y, dy = a.y;
+
+    if (method == INTERPOLATION_SPLINE) {
+
+        // Tangents scaled to the segment length. Without a neighbor within
+        // the maximum gap, the tangent points to the other end of the segment.
+        float mx1 = b.x - a.x, my1 = b.y - a.y;
+        float mx2 = mx1, my2 = my1;
+
+        if (i > 0 && keys[i - 1].object_id == a.object_id && a.frame_number - keys[i - 1].frame_number <= maximum_gap) {
+            const LabelRecord& previous = keys[i - 1];
+            float scale = (float) gap / (b.frame_number - previous.frame_number);
+            mx1 = (b.x - previous.x) * scale;
+            my1 = (b.y - previous.y) * scale;
+        }
+
+        if (i + 2 < keys.size() && keys[i + 2].object_id == b.object_id && keys[i + 2].frame_number - b.frame_number <= maximum_gap) {
+            const LabelRecord& next = keys[i + 2];
+            float scale = (float) gap / (next.frame_number - a.frame_number);
+            mx2 = (next.x - a.x) * scale;
+            my2 = (next.y - a.y) * scale;
+        }
+
+        // Hermite basis
+        ax = 2 * a.x - 2 * b.x + mx1 + mx2;
+        bx = -3 * a.x + 3 * b.x - 2 * mx1 - mx2;
+        cx = mx1;
+
+        ay = 2 * a.y - 2 * b.y + my1 + my2;
+        by = -3 * a.y + 3 * b.y - 2 * my1 - my2;
+        cy = my1;
+    }
+
+    int count = gap - 1;
+
+    segment_x.resize(count);
+    segment_y.resize(count);
+
+    float * xs = &segment_x[0];
+    float * ys = &segment_y[0];
+
+    float step = 1.0f / gap;
+
+    for (int j = 0; j < count; j++) {
+        float u = (j + 1) * step;
+        xs[j] = ((ax * u + bx) * u + cx) * u + dx;
+        ys[j] = ((ay * u + by) * u + cy) * u + dy;
+    }
+
+    // Time and box size are always linear
+    int64_t time_step = (b.time - a.time) / gap;
+    float width_step = (b.width - a.width) * step;
+    float height_step = (b.height - a.height) * step;
+
+    LabelRecord record;
+    record.flags = LABEL_FLAG_INTERPOLATED;
+    record.confidence = 0;
+    record.object_id = a.object_id;
+    record.reserved = 0;
+
+    for (int j = 0; j < count; j++) {
+        record.frame_number = a.frame_number + j + 1;
+        record.time = a.time + time_step * (j + 1);
+        record.x = xs[j];
+        record.y = ys[j];
+        record.width = a.width + width_step * (j + 1);
+        record.height = a.height + height_step * (j + 1);
+        output.push_back(record);
+    }
+}
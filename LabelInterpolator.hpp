@@ -0,0 +1,44 @@
+/* 
+ * File:   LabelInterpolator.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELINTERPOLATOR_HPP
+#define LABELINTERPOLATOR_HPP
+
+#include <vector>
+#include "LabelRecord.hpp"
+#include "SettingTypes.hpp"
+
+using namespace std;
+
+class LabelInterpolator {
+public:
+    LabelInterpolator(long, int);
+    LabelInterpolator(const LabelInterpolator& orig);
+    virtual ~LabelInterpolator();
+
+    void resample(const vector<LabelRecord>&, vector<LabelRecord>&);
+
+    void interpolate(const vector<LabelRecord>&, vector<LabelRecord>&, bool);
+
+    static void sort_labels(const vector<LabelRecord>&, vector<LabelRecord>&);
+
+private:
+
+    void interpolate_segment(const vector<LabelRecord>&, size_t, vector<LabelRecord>&);
+
+    // Gaps between labeled frames longer than this are not filled
+    long maximum_gap;
+
+    // Interpolation method
+    int method;
+
+    // Interpolated coordinates of one segment
+    vector<float> segment_x;
+    vector<float> segment_y;
+
+};
+
+#endif /* LABELINTERPOLATOR_HPP */
+
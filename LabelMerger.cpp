@@ -0,0 +1,508 @@
+/*
+ * File:   LabelMerger.cpp
+ * Author: Jan Dufek
+ */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include "LabelMerger.hpp"
+#include "LabelWriter.hpp"
+#include "Settings.hpp"
+
+/**
+ * Opens the label file of an annotator.
+ *
+ * @param file label file in the text or binary format
+ * @param window number of labels read ahead to sort labels placed out of order
+ * @param dwell maximum dwell in nanoseconds
+ */
+AnnotatorStream::AnnotatorStream(string file, int window, int64_t dwell) : file_name(file), reader(file) {
+    reorder_window = max(window, 1);
+    maximum_dwell = dwell;
+    has_previous = false;
+    previous_dwell = 0;
+    taken_frame = -1;
+    labels = 0;
+    late_labels = 0;
+}
+
+AnnotatorStream::AnnotatorStream(const AnnotatorStream& orig) : reader(orig.file_name) {
+}
+
+AnnotatorStream::~AnnotatorStream() {
+}
+
+/**
+ * Check whether the label file was opened.
+ *
+ * @return true if the file is open
+ */
+bool AnnotatorStream::is_open() {
+    return reader.is_open();
+}
+
+/**
+ * Read ahead until the reorder window is full or the file ends. A label is
+ * queued once the next one is read, since its dwell is the time between them.
+ */
+void AnnotatorStream::fill() {
+
+    LabelRecord record;
+
+    while (pending.size() < reorder_window && reader.next(record)) {
+
+        AnnotatorLabel label;
+        label.record = record;
+        label.dwell = 0;
+        label.sequence = labels++;
+
+        if (has_previous) {
+            previous.dwell = min(max(record.time - previous.record.time, (int64_t) 0), maximum_dwell);
+            previous_dwell = previous.dwell;
+            pending.push(previous);
+        }
+
+        previous = label;
+        has_previous = true;
+    }
+
+    // The last label stays as long as the one before it
+    if (has_previous && pending.size() < reorder_window) {
+        previous.dwell = previous_dwell;
+        pending.push(previous);
+        has_previous = false;
+    }
+}
+
+/**
+ * Get the next frame of the annotator.
+ *
+ * @return frame number, -1 at the end of the file
+ */
+long AnnotatorStream::peek_frame() {
+
+    fill();
+
+    // Labels of frames that were already merged
+    while (!pending.empty() && pending.top().record.frame_number <= taken_frame) {
+        pending.pop();
+        late_labels++;
+        fill();
+    }
+
+    return pending.empty() ? -1 : pending.top().record.frame_number;
+}
+
+/**
+ * Take the labels of the next frame, one per object. If an object was labeled
+ * more than once, the last label is taken.
+ *
+ * @param frame_labels receives the labels ordered by object
+ */
+void AnnotatorStream::take_frame(vector<AnnotatorLabel>& frame_labels) {
+
+    long frame = peek_frame();
+
+    if (frame < 0) {
+        return;
+    }
+
+    while (!pending.empty() && pending.top().record.frame_number == frame) {
+
+        const AnnotatorLabel& label = pending.top();
+
+        if (!frame_labels.empty() && frame_labels.back().record.object_id == label.record.object_id) {
+            frame_labels.back() = label;
+        } else {
+            frame_labels.push_back(label);
+        }
+
+        pending.pop();
+
+        fill();
+    }
+
+    taken_frame = frame;
+}
+
+string AnnotatorStream::get_file_name() {
+    return file_name;
+}
+
+long AnnotatorStream::get_labels() {
+    return labels;
+}
+
+long AnnotatorStream::get_late_labels() {
+    return late_labels;
+}
+
+/**
+ * Get the median of a few values. The median of an even number of values is
+ * the mean of the middle two.
+ *
+ * @param values values, reordered
+ * @return median
+ */
+static float median(vector<float>& values) {
+
+    sort(values.begin(), values.end());
+
+    size_t middle = values.size() / 2;
+
+    return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+/**
+ * Check whether the times of the labels placed in a label file have a
+ * fraction of a second. Older text label files store whole seconds only.
+ * Interpolated labels are not checked, their times are computed.
+ *
+ * @param file_name label file
+ * @return true if any placed label has a fraction of a second
+ */
+static bool has_subsecond_times(string file_name) {
+
+    LabelReader reader(file_name);
+
+    LabelRecord record;
+
+    while (reader.next(record)) {
+        if (!(record.flags & LABEL_FLAG_INTERPOLATED) && record.time % 1000000000 != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Creates a merger of the labels of several annotators.
+ *
+ * @param s program settings
+ */
+LabelMerger::LabelMerger(Settings& s) {
+    settings = &s;
+    dwell_consensus = settings->MERGE_CONSENSUS == MERGE_CONSENSUS_DWELL;
+    merged_labels = 0;
+    disputed_labels = 0;
+}
+
+LabelMerger::LabelMerger(const LabelMerger& orig) {
+}
+
+LabelMerger::~LabelMerger() {
+    for (size_t i = 0; i < annotators.size(); i++) {
+        delete annotators[i];
+    }
+}
+
+/**
+ * Add the label file of an annotator.
+ *
+ * @param file_name label file in the text or binary format
+ * @return false if the file cannot be read
+ */
+bool LabelMerger::add_annotator(string file_name) {
+
+    AnnotatorStream * annotator = new AnnotatorStream(file_name, settings->MERGE_REORDER_WINDOW, (int64_t) settings->MERGE_MAXIMUM_DWELL * 1000000);
+
+    if (!annotator->is_open()) {
+        delete annotator;
+        return false;
+    }
+
+    // Dwell of whole second times is zero for most labels
+    if (dwell_consensus && !has_subsecond_times(file_name)) {
+        cout << "Warning: " << file_name << " has whole second label times, merging with the median instead of MERGE_CONSENSUS_DWELL" << endl;
+        dwell_consensus = false;
+    }
+
+    annotators.push_back(annotator);
+    outliers.push_back(0);
+    distances.push_back(0);
+    compared_labels.push_back(0);
+
+    return true;
+}
+
+/**
+ * Get the name of the disagreement report of merged labels.
+ *
+ * @param output_file_name merged label file
+ * @return report file name
+ */
+string LabelMerger::get_report_file_name(string output_file_name) {
+    return output_file_name.substr(0, output_file_name.rfind('.')) + "_disagreement.txt";
+}
+
+/**
+ * Merge the annotator files frame by frame. The files are streamed, only the
+ * labels in the reorder windows are kept in memory. Each label of a frame and
+ * object is the consensus of the annotators that labeled it. Labels whose
+ * annotators disagree are flagged as disputed and listed in the report.
+ *
+ * @param output_file_name merged label file, binary if it ends with .bin
+ * @return false if the output cannot be written
+ */
+bool LabelMerger::merge(string output_file_name) {
+
+    size_t extension = output_file_name.rfind('.');
+
+    int format = extension != string::npos && output_file_name.substr(extension) == ".bin" ? LABEL_FORMAT_BINARY : LABEL_FORMAT_TEXT;
+
+    LabelWriter label_writer(output_file_name, format, settings->LABEL_BUFFER_RECORDS, settings->LABEL_SYNC_INTERVAL);
+
+    if (!label_writer.is_open()) {
+        cout << "Cannot write " << output_file_name << endl;
+        return false;
+    }
+
+    string report_file_name = get_report_file_name(output_file_name);
+
+    FILE * report_file = fopen(report_file_name.c_str(), "w");
+
+    if (report_file == NULL) {
+        cout << "Cannot write " << report_file_name << endl;
+        return false;
+    }
+
+    fprintf(report_file, "# frame object annotators inliers spread x y [annotator x y]...\n");
+
+    int64 start_ticks = getTickCount();
+
+    // Labels of the current frame per annotator, ordered by object
+    vector<vector<AnnotatorLabel> > frame_labels(annotators.size());
+    vector<size_t> cursors(annotators.size());
+
+    // Labels of the current object and their annotators
+    vector<AnnotatorLabel*> object_labels;
+    vector<int> object_annotators;
+
+    while (true) {
+
+        long frame = -1;
+
+        for (size_t i = 0; i < annotators.size(); i++) {
+
+            long annotator_frame = annotators[i]->peek_frame();
+
+            if (annotator_frame >= 0 && (frame < 0 || annotator_frame < frame)) {
+                frame = annotator_frame;
+            }
+        }
+
+        if (frame < 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < annotators.size(); i++) {
+
+            frame_labels[i].clear();
+            cursors[i] = 0;
+
+            if (annotators[i]->peek_frame() == frame) {
+                annotators[i]->take_frame(frame_labels[i]);
+            }
+        }
+
+        // Merge the objects of the frame in order
+        while (true) {
+
+            bool found = false;
+            uint32_t object_id = 0;
+
+            for (size_t i = 0; i < annotators.size(); i++) {
+                if (cursors[i] < frame_labels[i].size() && (!found || frame_labels[i][cursors[i]].record.object_id < object_id)) {
+                    object_id = frame_labels[i][cursors[i]].record.object_id;
+                    found = true;
+                }
+            }
+
+            if (!found) {
+                break;
+            }
+
+            object_labels.clear();
+            object_annotators.clear();
+
+            for (size_t i = 0; i < annotators.size(); i++) {
+                if (cursors[i] < frame_labels[i].size() && frame_labels[i][cursors[i]].record.object_id == object_id) {
+                    object_labels.push_back(&frame_labels[i][cursors[i]]);
+                    object_annotators.push_back(i);
+                    cursors[i]++;
+                }
+            }
+
+            LabelRecord merged;
+
+            merge_object(object_labels, object_annotators, merged, report_file);
+
+            label_writer.write(merged);
+
+            merged_labels++;
+        }
+    }
+
+    label_writer.close();
+
+    bool success = fclose(report_file) == 0;
+
+    cout << "Merged " << merged_labels << " labels of " << annotators.size() << " annotators in " << (getTickCount() - start_ticks) / getTickFrequency() << " s, " << disputed_labels << " disputed" << endl;
+
+    for (size_t i = 0; i < annotators.size(); i++) {
+
+        cout << annotators[i]->get_file_name() << ": " << annotators[i]->get_labels() << " labels";
+
+        if (compared_labels[i] > 0) {
+            cout << ", mean distance to consensus " << distances[i] / compared_labels[i] << " px";
+        }
+
+        cout << ", " << outliers[i] << " outliers";
+
+        if (annotators[i]->get_late_labels() > 0) {
+            cout << ", " << annotators[i]->get_late_labels() << " labels out of order skipped (increase MERGE_REORDER_WINDOW)";
+        }
+
+        cout << endl;
+    }
+
+    return success;
+}
+
+/**
+ * Merge the labels of one frame and object. With three or more annotators,
+ * labels farther than MERGE_OUTLIER_DISTANCE from the median are rejected
+ * first. The consensus of the remaining labels is their median or their mean
+ * weighted by dwell. The label is disputed if any annotator is farther than
+ * MERGE_DISAGREEMENT_THRESHOLD from the consensus.
+ *
+ * @param labels labels of the object, one per annotator
+ * @param indices annotators of the labels
+ * @param merged receives the merged label
+ * @param report_file disputed labels are written to it
+ */
+void LabelMerger::merge_object(vector<AnnotatorLabel*>& labels, vector<int>& indices, LabelRecord& merged, FILE * report_file) {
+
+    size_t count = labels.size();
+
+    vector<float> x(count);
+    vector<float> y(count);
+
+    for (size_t i = 0; i < count; i++) {
+        x[i] = labels[i]->record.x;
+        y[i] = labels[i]->record.y;
+    }
+
+    float median_x = median(x);
+    float median_y = median(y);
+
+    // Reject outliers, unless there is no majority to judge them by
+    vector<bool> inliers(count, true);
+    size_t inlier_count = count;
+
+    if (count >= 3) {
+
+        inlier_count = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            inliers[i] = hypot(labels[i]->record.x - median_x, labels[i]->record.y - median_y) <= settings->MERGE_OUTLIER_DISTANCE;
+            inlier_count += inliers[i];
+        }
+
+        if (inlier_count == 0) {
+            inliers.assign(count, true);
+            inlier_count = count;
+        }
+    }
+
+    x.clear();
+    y.clear();
+
+    vector<float> widths;
+    vector<float> heights;
+
+    double weighted_x = 0;
+    double weighted_y = 0;
+    double weights = 0;
+
+    memset(&merged, 0, sizeof (merged));
+
+    merged.frame_number = labels[0]->record.frame_number;
+    merged.object_id = labels[0]->record.object_id;
+
+    for (size_t i = 0; i < count; i++) {
+
+        if (!inliers[i]) {
+            continue;
+        }
+
+        const LabelRecord& record = labels[i]->record;
+
+        x.push_back(record.x);
+        y.push_back(record.y);
+
+        if (record.width > 0 && record.height > 0) {
+            widths.push_back(record.width);
+            heights.push_back(record.height);
+        }
+
+        weighted_x += record.x * (double) labels[i]->dwell;
+        weighted_y += record.y * (double) labels[i]->dwell;
+        weights += labels[i]->dwell;
+
+        // The label is complete when the last annotator placed it
+        merged.time = max(merged.time, record.time);
+        merged.flags |= record.flags & (LABEL_FLAG_INTERPOLATED | LABEL_FLAG_TRACKED);
+    }
+
+    if (dwell_consensus && weights > 0) {
+        merged.x = weighted_x / weights;
+        merged.y = weighted_y / weights;
+    } else {
+        merged.x = median(x);
+        merged.y = median(y);
+    }
+
+    if (!widths.empty()) {
+        merged.width = median(widths);
+        merged.height = median(heights);
+    }
+
+    // Spread of all annotators, including the rejected ones
+    float spread = 0;
+
+    for (size_t i = 0; i < count; i++) {
+
+        float distance = hypot(labels[i]->record.x - merged.x, labels[i]->record.y - merged.y);
+
+        spread = max(spread, distance);
+
+        if (count > 1) {
+            distances[indices[i]] += distance;
+            compared_labels[indices[i]]++;
+        }
+
+        if (!inliers[i]) {
+            outliers[indices[i]]++;
+        }
+    }
+
+    if (spread <= settings->MERGE_DISAGREEMENT_THRESHOLD) {
+        return;
+    }
+
+    merged.flags |= LABEL_FLAG_DISPUTED;
+
+    disputed_labels++;
+
+    fprintf(report_file, "%lld %u %d %d %.2f %.2f %.2f", (long long) merged.frame_number, merged.object_id, (int) count, (int) inlier_count, spread, merged.x, merged.y);
+
+    for (size_t i = 0; i < count; i++) {
+        fprintf(report_file, " %d %.2f %.2f", indices[i], labels[i]->record.x, labels[i]->record.y);
+    }
+
+    fprintf(report_file, "\n");
+}
@@ -0,0 +1,145 @@
+/*
+ * File:   LabelMerger.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELMERGER_HPP
+#define LABELMERGER_HPP
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <queue>
+#include "LabelRecord.hpp"
+#include "LabelReader.hpp"
+#include "SettingTypes.hpp"
+
+using namespace std;
+
+class Settings;
+
+// Label of one annotator with the time the annotator stayed on its frame
+struct AnnotatorLabel {
+    LabelRecord record;
+
+    // Nanoseconds until the next label of the same annotator
+    int64_t dwell;
+
+    // Position in the file, later labels replace earlier ones
+    long sequence;
+};
+
+// Orders the pending labels of an annotator by frame, object and position
+struct AnnotatorLabelOrder {
+
+    bool operator()(const AnnotatorLabel& a, const AnnotatorLabel& b) const {
+
+        if (a.record.frame_number != b.record.frame_number) {
+            return a.record.frame_number > b.record.frame_number;
+        }
+
+        if (a.record.object_id != b.record.object_id) {
+            return a.record.object_id > b.record.object_id;
+        }
+
+        return a.sequence > b.sequence;
+    }
+};
+
+/**
+ * Label file of one annotator read in frame order. Label files are rewritten
+ * in frame order when the application exits, files of crashed sessions and
+ * older files are in the order the labels were placed, which is the frame
+ * order unless the annotator went back. Labels up to the reorder window apart are
+ * sorted, labels of frames that were already merged are counted as late and
+ * skipped.
+ */
+class AnnotatorStream {
+public:
+    AnnotatorStream(string, int, int64_t);
+    AnnotatorStream(const AnnotatorStream& orig);
+    virtual ~AnnotatorStream();
+
+    bool is_open();
+
+    long peek_frame();
+
+    void take_frame(vector<AnnotatorLabel>&);
+
+    string get_file_name();
+
+    long get_labels();
+
+    long get_late_labels();
+
+private:
+
+    void fill();
+
+    // Label file
+    string file_name;
+    LabelReader reader;
+
+    // Labels read ahead, smallest frame first
+    priority_queue<AnnotatorLabel, vector<AnnotatorLabel>, AnnotatorLabelOrder> pending;
+
+    // Number of labels read ahead
+    size_t reorder_window;
+
+    // Dwell is limited to this, e.g., when the video was paused
+    int64_t maximum_dwell;
+
+    // Last label read, waits for the next one to know its dwell
+    AnnotatorLabel previous;
+    bool has_previous;
+
+    // Dwell of the label before it
+    int64_t previous_dwell;
+
+    // Last frame taken, -1 if none
+    long taken_frame;
+
+    long labels;
+    long late_labels;
+
+};
+
+class LabelMerger {
+public:
+    LabelMerger(Settings&);
+    LabelMerger(const LabelMerger& orig);
+    virtual ~LabelMerger();
+
+    bool add_annotator(string);
+
+    bool merge(string);
+
+    static string get_report_file_name(string);
+
+private:
+
+    void merge_object(vector<AnnotatorLabel*>&, vector<int>&, LabelRecord&, FILE*);
+
+    // Program settings
+    Settings * settings;
+
+    // Weight the labels by dwell, false if the times of an annotator are too
+    // coarse to measure it
+    bool dwell_consensus;
+
+    // Annotator label files
+    vector<AnnotatorStream*> annotators;
+
+    // Per annotator: labels rejected as outliers, summed distance to the
+    // consensus and number of labels it was measured for
+    vector<long> outliers;
+    vector<double> distances;
+    vector<long> compared_labels;
+
+    // Merged labels and labels flagged as disputed
+    long merged_labels;
+    long disputed_labels;
+
+};
+
+#endif /* LABELMERGER_HPP */
@@ -0,0 +1,200 @@
+/* 
+ * File:   LabelReader.cpp
+ * Author: Jan Dufek
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "LabelReader.hpp"
+
+/**
+ * Opens a label file. The format is detected from the file header, files
+ * without the binary header are read as text.
+ * 
+ * @param file_name label file
+ */
+LabelReader::LabelReader(string file_name) {
+
+    format = LABEL_FORMAT_TEXT;
+    record_size = sizeof (LabelRecord);
+
+    file = fopen(file_name.c_str(), "rb");
+
+    if (file == NULL) {
+        return;
+    }
+
+    LabelFileHeader header;
+
+    if (fread(&header, sizeof (header), 1, file) == 1 && memcmp(header.magic, LABEL_FILE_MAGIC, sizeof (header.magic)) == 0) {
+
+        // Records written by a different version cannot be read, records
+        // without objects are read as labels of the first object
+        if (header.record_size != sizeof (LabelRecord) && header.record_size != LABEL_RECORD_SIZE_V1) {
+            close();
+            return;
+        }
+
+        format = LABEL_FORMAT_BINARY;
+        record_size = header.record_size;
+
+    } else {
+        rewind(file);
+    }
+}
+
+LabelReader::LabelReader(const LabelReader& orig) {
+}
+
+LabelReader::~LabelReader() {
+    close();
+}
+
+/**
+ * Check whether the label file was opened.
+ * 
+ * @return true if the file is open
+ */
+bool LabelReader::is_open() {
+    return file != NULL;
+}
+
+/**
+ * Get the format of the label file.
+ * 
+ * @return LABEL_FORMAT_TEXT or LABEL_FORMAT_BINARY
+ */
+int LabelReader::get_format() {
+    return format;
+}
+
+/**
+ * Read the next label. Lines that are not labels are skipped.
+ * 
+ * @param record receives the label
+ * @return false at the end of the file
+ */
+bool LabelReader::next(LabelRecord& record) {
+
+    if (file == NULL) {
+        return false;
+    }
+
+    if (format == LABEL_FORMAT_BINARY) {
+
+        memset(&record, 0, sizeof (record));
+
+        return fread(&record, record_size, 1, file) == 1;
+    }
+
+    char line[256];
+
+    while (fgets(line, sizeof (line), file) != NULL) {
+        if (parse_text(line, record)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Close the label file.
+ * 
+ */
+void LabelReader::close() {
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+/**
+ * Read all labels of a file.
+ * 
+ * @param file_name label file
+ * @param records receives the labels
+ * @return false if the file cannot be opened
+ */
+bool LabelReader::read_all(string file_name, vector<LabelRecord>& records) {
+
+    LabelReader reader(file_name);
+
+    if (!reader.is_open()) {
+        return false;
+    }
+
+    LabelRecord record;
+
+    while (reader.next(record)) {
+        records.push_back(record);
+    }
+
+    return true;
+}
+
+/**
+ * Parse one line of the text label format "time frame x y [flags [confidence]]".
+ * 
+ * @param line text line
+ * @param record receives the label
+ * @return false if the line is not a label
+ */
+bool LabelReader::parse_text(const char* line, LabelRecord& record) {
+
+    char time_string[32];
+    long long frame_number;
+    float x, y;
+    unsigned int flags = 0;
+    float confidence = 0;
+    unsigned int object_id = 0;
+    float width = 0, height = 0;
+
+    if (sscanf(line, "%31s %lld %f %f %u %f %u %f %f", time_string, &frame_number, &x, &y, &flags, &confidence, &object_id, &width, &height) < 4 || strlen(time_string) < 14) {
+        return false;
+    }
+
+    // Local time in format yearmonthdayhourminutesecond, optionally followed
+    // by .nanoseconds
+    struct tm local_time;
+    memset(&local_time, 0, sizeof (local_time));
+
+    if (sscanf(time_string, "%4d%2d%2d%2d%2d%2d", &local_time.tm_year, &local_time.tm_mon, &local_time.tm_mday, &local_time.tm_hour, &local_time.tm_min, &local_time.tm_sec) != 6) {
+        return false;
+    }
+
+    int64_t nanoseconds = 0;
+
+    if (strlen(time_string) > 14) {
+        const char* fraction = time_string + 14;
+
+        if (*fraction != '.' || strlen(fraction) < 2 || strlen(fraction) > 10 || strspn(fraction + 1, "0123456789") != strlen(fraction) - 1) {
+            return false;
+        }
+
+        // Scale the fraction to nanoseconds whatever its number of digits
+        int digits = strlen(fraction) - 1;
+        nanoseconds = atoll(fraction + 1);
+        for (int i = digits; i < 9; i++) {
+            nanoseconds *= 10;
+        }
+    }
+
+    local_time.tm_year -= 1900;
+    local_time.tm_mon -= 1;
+    local_time.tm_isdst = -1;
+
+    record.frame_number = frame_number;
+    record.time = (int64_t) mktime(&local_time) * 1000000000 + nanoseconds;
+    record.x = x;
+    record.y = y;
+    record.flags = flags;
+    record.confidence = confidence;
+    record.object_id = object_id;
+    record.width = width;
+    record.height = height;
+    record.reserved = 0;
+
+    return true;
+}
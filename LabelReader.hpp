@@ -0,0 +1,48 @@
+/* 
+ * File:   LabelReader.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELREADER_HPP
+#define LABELREADER_HPP
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "LabelRecord.hpp"
+
+using namespace std;
+
+class LabelReader {
+public:
+    LabelReader(string);
+    LabelReader(const LabelReader& orig);
+    virtual ~LabelReader();
+
+    bool is_open();
+
+    int get_format();
+
+    bool next(LabelRecord&);
+
+    void close();
+
+    static bool read_all(string, vector<LabelRecord>&);
+
+    static bool parse_text(const char*, LabelRecord&);
+
+private:
+
+    // Input file
+    FILE * file;
+
+    // Input format detected from the file header
+    int format;
+
+    // Size of the records of binary files
+    uint32_t record_size;
+
+};
+
+#endif /* LABELREADER_HPP */
+
@@ -0,0 +1,82 @@
+/* 
+ * File:   LabelRecord.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELRECORD_HPP
+#define LABELRECORD_HPP
+
+#include <stdint.h>
+
+// Label file formats
+enum LabelFormat {
+    LABEL_FORMAT_TEXT = 0,
+    LABEL_FORMAT_BINARY = 1
+};
+
+// Label flags
+enum LabelFlags {
+
+    // Position was interpolated between manually labeled frames
+    LABEL_FLAG_INTERPOLATED = 1,
+
+    // Position was proposed by the tracker and not corrected by the annotator
+    LABEL_FLAG_TRACKED = 2,
+
+    // Annotators disagreed about the position of a merged label
+    LABEL_FLAG_DISPUTED = 4,
+
+    // Position was carried forward from the previous label over a frame that
+    // did not change
+    LABEL_FLAG_CARRIED = 8,
+
+    // Slot of a label store holds a label, never written to label files
+    LABEL_FLAG_PRESENT = 0x80000000u
+};
+
+// Identifies binary label files and their version
+static const char LABEL_FILE_MAGIC[8] = {'G', 'T', 'L', 'L', 'B', 'L', '0', '1'};
+
+// Header of binary label files
+struct LabelFileHeader {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+// Size of the records of label files written before labels had object
+// identifiers and boxes. Such records are the prefix of the current ones.
+static const uint32_t LABEL_RECORD_SIZE_V1 = 32;
+
+// One label as it is stored in binary label files. Fixed width, little endian.
+struct LabelRecord {
+
+    // Frame number
+    int64_t frame_number;
+
+    // Wall clock time in nanoseconds since the epoch
+    int64_t time;
+
+    // Labeled position in original pixel coordinates, center of boxes
+    float x;
+    float y;
+
+    // Label flags, 0 for a manual label
+    uint32_t flags;
+
+    // Confidence of tracked labels, normalized cross-correlation of the match
+    float confidence;
+
+    // Labeled object, 0 for the first one
+    uint32_t object_id;
+
+    // Box size in original pixel coordinates, 0 for point labels
+    float width;
+    float height;
+
+    // Keeps the size a multiple of 8 bytes
+    uint32_t reserved;
+};
+
+#endif /* LABELRECORD_HPP */
+
@@ -0,0 +1,439 @@
+/* 
+ * File:   LabelStore.cpp
+ * Author: Jan Dufek
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "LabelStore.hpp"
+#include "LabelReader.hpp"
+#include "LabelWriter.hpp"
+
+// Frames the store has slots for when it is created
+static const long INITIAL_FRAME_CAPACITY = 65536;
+
+/**
+ * Creates a label store kept in the given file. The store is a memory mapped
+ * file with fixed width records, one slot per object of each frame, so a
+ * label of any frame is read or overwritten in place without parsing. Frames
+ * without a label are holes of the sparse file and do not take disk space.
+ * 
+ * @param store_file_name store file
+ * @param objects number of objects per frame of a new store, existing stores
+ * keep their layout
+ */
+LabelStore::LabelStore(string store_file_name, int objects) {
+    file_name = store_file_name;
+    objects_per_frame = objects > 0 ? objects : 1;
+    file_descriptor = -1;
+    writable = false;
+    mapping = NULL;
+    mapping_size = 0;
+    frame_capacity = 0;
+}
+
+LabelStore::LabelStore(const LabelStore& orig) {
+}
+
+LabelStore::~LabelStore() {
+    close();
+}
+
+/**
+ * Check whether the file is a label store.
+ * 
+ * @param store_file_name file
+ * @return true if the file starts with the label store header
+ */
+bool LabelStore::is_store(string store_file_name) {
+
+    int descriptor = ::open(store_file_name.c_str(), O_RDONLY);
+
+    if (descriptor < 0) {
+        return false;
+    }
+
+    LabelStoreHeader header;
+    bool store = read(descriptor, &header, sizeof (header)) == (ssize_t) sizeof (header) && memcmp(header.magic, LABEL_STORE_MAGIC, sizeof (header.magic)) == 0;
+
+    ::close(descriptor);
+
+    return store;
+}
+
+/**
+ * Open the store. A missing store is created when it is opened for writing.
+ * 
+ * @param write open for writing, otherwise the store is mapped read-only
+ * @return true if the store was opened
+ */
+bool LabelStore::open(bool write) {
+
+    close();
+
+    writable = write;
+
+    file_descriptor = ::open(file_name.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+
+    if (file_descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_status;
+
+    if (fstat(file_descriptor, &file_status) != 0) {
+        close();
+        return false;
+    }
+
+    // New store
+    if (file_status.st_size == 0) {
+
+        if (!writable) {
+            close();
+            return false;
+        }
+
+        LabelStoreHeader header;
+        memset(&header, 0, sizeof (header));
+        memcpy(header.magic, LABEL_STORE_MAGIC, sizeof (header.magic));
+        header.record_size = sizeof (LabelRecord);
+        header.frame_capacity = INITIAL_FRAME_CAPACITY;
+        header.objects_per_frame = objects_per_frame;
+
+        if (pwrite(file_descriptor, &header, sizeof (header), 0) != (ssize_t) sizeof (header)) {
+            close();
+            return false;
+        }
+
+        // Sparse, the slots read as zeros until they are written
+        file_status.st_size = sizeof (LabelStoreHeader) + INITIAL_FRAME_CAPACITY * objects_per_frame * sizeof (LabelRecord);
+
+        if (ftruncate(file_descriptor, file_status.st_size) != 0) {
+            close();
+            return false;
+        }
+    }
+
+    if (file_status.st_size < (off_t) sizeof (LabelStoreHeader) || !map(file_status.st_size)) {
+        close();
+        return false;
+    }
+
+    LabelStoreHeader * header = (LabelStoreHeader *) mapping;
+
+    if (memcmp(header->magic, LABEL_STORE_MAGIC, sizeof (header->magic)) != 0 || header->record_size != sizeof (LabelRecord) || header->objects_per_frame < 1) {
+        close();
+        return false;
+    }
+
+    objects_per_frame = header->objects_per_frame;
+
+    // Trust the file size over the header if a grow was interrupted
+    frame_capacity = (file_status.st_size - sizeof (LabelStoreHeader)) / sizeof (LabelRecord) / objects_per_frame;
+
+    return true;
+}
+
+/**
+ * Map the file.
+ * 
+ * @param size file size in bytes
+ * @return true if the file was mapped
+ */
+bool LabelStore::map(int64_t size) {
+
+    if (mapping != NULL) {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+    }
+
+    void * address = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file_descriptor, 0);
+
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    mapping = (char *) address;
+    mapping_size = size;
+
+    return true;
+}
+
+/**
+ * Make room for the frame by doubling the number of slots.
+ * 
+ * @param frame_number frame that has to fit
+ * @return true if the store is large enough
+ */
+bool LabelStore::grow(long frame_number) {
+
+    long capacity = frame_capacity > 0 ? frame_capacity : INITIAL_FRAME_CAPACITY;
+
+    while (capacity <= frame_number) {
+        capacity *= 2;
+    }
+
+    int64_t size = sizeof (LabelStoreHeader) + (int64_t) capacity * objects_per_frame * sizeof (LabelRecord);
+
+    if (ftruncate(file_descriptor, size) != 0 || !map(size)) {
+        return false;
+    }
+
+    frame_capacity = capacity;
+
+    ((LabelStoreHeader *) mapping)->frame_capacity = capacity;
+
+    return true;
+}
+
+/**
+ * Get the slot of an object in a frame.
+ * 
+ * @param frame_number frame
+ * @param object_id object
+ * @return slot in the mapping
+ */
+LabelRecord * LabelStore::slot(long frame_number, uint32_t object_id) {
+    return (LabelRecord *) (mapping + sizeof (LabelStoreHeader)) + (int64_t) frame_number * objects_per_frame + object_id;
+}
+
+/**
+ * Check whether the store is open.
+ * 
+ * @return true if the store is mapped
+ */
+bool LabelStore::is_open() {
+    return mapping != NULL;
+}
+
+/**
+ * Store the label of an object in a frame, overwriting the previous one in
+ * place.
+ * 
+ * @param record label
+ * @return false if the store is not writable, could not grow or has no slot
+ * for the object
+ */
+bool LabelStore::put(const LabelRecord& record) {
+
+    if (mapping == NULL || !writable || record.frame_number < 0 || record.object_id >= (uint32_t) objects_per_frame) {
+        return false;
+    }
+
+    if (record.frame_number >= frame_capacity && !grow(record.frame_number)) {
+        return false;
+    }
+
+    LabelRecord * label = slot(record.frame_number, record.object_id);
+
+    *label = record;
+    label->flags |= LABEL_FLAG_PRESENT;
+
+    return true;
+}
+
+/**
+ * Get the label of an object in a frame.
+ * 
+ * @param frame_number frame
+ * @param object_id object
+ * @param record output
+ * @return false if the object is not labeled in the frame
+ */
+bool LabelStore::get(long frame_number, uint32_t object_id, LabelRecord& record) {
+
+    if (mapping == NULL || frame_number < 0 || frame_number >= frame_capacity || object_id >= (uint32_t) objects_per_frame) {
+        return false;
+    }
+
+    const LabelRecord * label = slot(frame_number, object_id);
+
+    if (!(label->flags & LABEL_FLAG_PRESENT)) {
+        return false;
+    }
+
+    record = *label;
+    record.flags &= ~LABEL_FLAG_PRESENT;
+
+    return true;
+}
+
+/**
+ * Remove the label of an object in a frame.
+ * 
+ * @param frame_number frame
+ * @param object_id object
+ * @return false if the store is not writable
+ */
+bool LabelStore::remove(long frame_number, uint32_t object_id) {
+
+    if (mapping == NULL || !writable) {
+        return false;
+    }
+
+    if (frame_number >= 0 && frame_number < frame_capacity && object_id < (uint32_t) objects_per_frame) {
+        memset(slot(frame_number, object_id), 0, sizeof (LabelRecord));
+    }
+
+    return true;
+}
+
+/**
+ * Get the number of frames the store has slots for.
+ * 
+ * @return number of frames
+ */
+long LabelStore::get_frame_capacity() {
+    return frame_capacity;
+}
+
+/**
+ * Get the number of objects each frame has slots for.
+ * 
+ * @return number of objects
+ */
+int LabelStore::get_objects_per_frame() {
+    return objects_per_frame;
+}
+
+/**
+ * Count the labeled frames. Scans all slots.
+ * 
+ * @return number of labels
+ */
+long LabelStore::count() {
+
+    long labels = 0;
+
+    LabelRecord * labels_begin = slot(0, 0);
+    LabelRecord * labels_end = slot(frame_capacity, 0);
+
+    for (LabelRecord * label = labels_begin; label < labels_end; label++) {
+        if (label->flags & LABEL_FLAG_PRESENT) {
+            labels++;
+        }
+    }
+
+    return labels;
+}
+
+/**
+ * Read all labels ordered by frame and object.
+ * 
+ * @param records receives the labels
+ * @return number of labels
+ */
+long LabelStore::read_all(vector<LabelRecord>& records) {
+
+    LabelRecord record;
+    long labels = 0;
+
+    for (long i = 0; i < frame_capacity; i++) {
+        for (int j = 0; j < objects_per_frame; j++) {
+            if (get(i, j, record)) {
+                records.push_back(record);
+                labels++;
+            }
+        }
+    }
+
+    return labels;
+}
+
+/**
+ * Write the modified slots to the disk.
+ * 
+ * @return true if the store is on the disk
+ */
+bool LabelStore::sync() {
+
+    if (mapping == NULL || !writable) {
+        return false;
+    }
+
+    return msync(mapping, mapping_size, MS_SYNC) == 0;
+}
+
+/**
+ * Unmap and close the store.
+ * 
+ */
+void LabelStore::close() {
+
+    if (mapping != NULL) {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+        mapping_size = 0;
+    }
+
+    if (file_descriptor >= 0) {
+        ::close(file_descriptor);
+        file_descriptor = -1;
+    }
+
+    frame_capacity = 0;
+}
+
+/**
+ * Import a text or binary label file. Later labels of a frame overwrite the
+ * earlier ones.
+ * 
+ * @param label_file_name label file
+ * @return number of imported labels, -1 if the file cannot be read
+ */
+long LabelStore::import_labels(string label_file_name) {
+
+    LabelReader reader(label_file_name);
+
+    if (!reader.is_open()) {
+        return -1;
+    }
+
+    LabelRecord record;
+    long labels = 0;
+
+    while (reader.next(record)) {
+        if (put(record)) {
+            labels++;
+        }
+    }
+
+    return labels;
+}
+
+/**
+ * Export the labels ordered by frame and object into a text or binary label
+ * file.
+ * 
+ * @param label_file_name label file
+ * @param label_format LABEL_FORMAT_TEXT or LABEL_FORMAT_BINARY
+ * @return number of exported labels, -1 if the file cannot be written
+ */
+long LabelStore::export_labels(string label_file_name, int label_format) {
+
+    LabelWriter writer(label_file_name, label_format, 65536, 1000);
+
+    if (!writer.is_open()) {
+        return -1;
+    }
+
+    LabelRecord record;
+    long labels = 0;
+
+    for (long i = 0; i < frame_capacity; i++) {
+        for (int j = 0; j < objects_per_frame; j++) {
+            if (get(i, j, record)) {
+                writer.write(record);
+                labels++;
+            }
+        }
+    }
+
+    writer.close();
+
+    return labels;
+}
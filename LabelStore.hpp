@@ -0,0 +1,92 @@
+/* 
+ * File:   LabelStore.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELSTORE_HPP
+#define LABELSTORE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "LabelRecord.hpp"
+
+using namespace std;
+
+// Identifies label store files and their version
+static const char LABEL_STORE_MAGIC[8] = {'G', 'T', 'L', 'S', 'T', 'O', '0', '1'};
+
+// Header of label store files, 32 bytes so that the records following it
+// stay aligned to 8 bytes
+struct LabelStoreHeader {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+    int64_t frame_capacity;
+    int64_t objects_per_frame;
+};
+
+class LabelStore {
+public:
+    LabelStore(string, int);
+    LabelStore(const LabelStore& orig);
+    virtual ~LabelStore();
+
+    bool open(bool);
+
+    bool is_open();
+
+    bool put(const LabelRecord&);
+
+    bool get(long, uint32_t, LabelRecord&);
+
+    bool remove(long, uint32_t);
+
+    long get_frame_capacity();
+
+    int get_objects_per_frame();
+
+    long count();
+
+    long read_all(vector<LabelRecord>&);
+
+    bool sync();
+
+    void close();
+
+    long import_labels(string);
+
+    long export_labels(string, int);
+
+    static bool is_store(string);
+
+private:
+
+    bool map(int64_t);
+
+    bool grow(long);
+
+    LabelRecord * slot(long, uint32_t);
+
+    // Store file
+    string file_name;
+
+    // Descriptor of the open store file, -1 if closed
+    int file_descriptor;
+
+    // The store was opened for writing
+    bool writable;
+
+    // Mapped file, the header is followed by one record per frame
+    char * mapping;
+    size_t mapping_size;
+
+    // Number of frames the file has slots for
+    long frame_capacity;
+
+    // Number of slots of each frame, labels of objects beyond it are not kept
+    int objects_per_frame;
+
+};
+
+#endif /* LABELSTORE_HPP */
@@ -0,0 +1,206 @@
+/* 
+ * File:   LabelTable.cpp
+ * Author: Jan Dufek
+ */
+
+#include "LabelTable.hpp"
+
+/**
+ * Creates an empty table of labels of several objects per frame. The labels
+ * are stored column by column and the rows of each frame are chained, so that
+ * all labels of a frame are found without searching.
+ * 
+ */
+LabelTable::LabelTable() {
+}
+
+LabelTable::LabelTable(const LabelTable& orig) {
+}
+
+LabelTable::~LabelTable() {
+}
+
+/**
+ * Store a label. A label of the same object in the same frame is overwritten.
+ * 
+ * @param record label
+ * @return row of the label
+ */
+int LabelTable::put(const LabelRecord& record) {
+
+    int row = find(record.frame_number, record.object_id);
+
+    if (row < 0) {
+
+        row = frame_numbers.size();
+
+        frame_numbers.push_back(record.frame_number);
+        times.push_back(0);
+        x.push_back(0);
+        y.push_back(0);
+        width.push_back(0);
+        height.push_back(0);
+        flags.push_back(0);
+        confidence.push_back(0);
+        object_ids.push_back(record.object_id);
+
+        // Prepend to the rows of the frame
+        unordered_map<long, int>::iterator head = frame_heads.find(record.frame_number);
+
+        if (head == frame_heads.end()) {
+            next_rows.push_back(-1);
+            frame_heads[record.frame_number] = row;
+        } else {
+            next_rows.push_back(head->second);
+            head->second = row;
+        }
+    }
+
+    times[row] = record.time;
+    x[row] = record.x;
+    y[row] = record.y;
+    width[row] = record.width;
+    height[row] = record.height;
+    flags[row] = record.flags;
+    confidence[row] = record.confidence;
+
+    return row;
+}
+
+/**
+ * Find the label of an object in a frame.
+ * 
+ * @param frame_number frame
+ * @param object_id object
+ * @return row of the label, -1 if the object is not labeled in the frame
+ */
+int LabelTable::find(long frame_number, uint32_t object_id) {
+
+    for (int row = first_in_frame(frame_number); row >= 0; row = next_in_frame(row)) {
+        if (object_ids[row] == object_id) {
+            return row;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Get the first label of a frame.
+ * 
+ * @param frame_number frame
+ * @return row of the label, -1 if the frame has no labels
+ */
+int LabelTable::first_in_frame(long frame_number) {
+
+    unordered_map<long, int>::iterator head = frame_heads.find(frame_number);
+
+    return head == frame_heads.end() ? -1 : head->second;
+}
+
+/**
+ * Get the next label of the same frame.
+ * 
+ * @param row row of a label
+ * @return row of the next label, -1 if it was the last one
+ */
+int LabelTable::next_in_frame(int row) {
+    return next_rows[row];
+}
+
+/**
+ * Get a label as a record.
+ * 
+ * @param row row of the label
+ * @return label
+ */
+LabelRecord LabelTable::get(int row) {
+
+    LabelRecord record;
+    record.frame_number = frame_numbers[row];
+    record.time = times[row];
+    record.x = x[row];
+    record.y = y[row];
+    record.flags = flags[row];
+    record.confidence = confidence[row];
+    record.object_id = object_ids[row];
+    record.width = width[row];
+    record.height = height[row];
+    record.reserved = 0;
+
+    return record;
+}
+
+/**
+ * Get the number of labels.
+ * 
+ * @return number of labels
+ */
+size_t LabelTable::size() {
+    return frame_numbers.size();
+}
+
+/**
+ * Pre-allocate the columns.
+ * 
+ * @param labels expected number of labels
+ */
+void LabelTable::reserve(size_t labels) {
+    frame_numbers.reserve(labels);
+    times.reserve(labels);
+    x.reserve(labels);
+    y.reserve(labels);
+    width.reserve(labels);
+    height.reserve(labels);
+    flags.reserve(labels);
+    confidence.reserve(labels);
+    object_ids.reserve(labels);
+    next_rows.reserve(labels);
+    frame_heads.reserve(labels);
+}
+
+/**
+ * Remove all labels.
+ * 
+ */
+void LabelTable::clear() {
+    frame_numbers.clear();
+    times.clear();
+    x.clear();
+    y.clear();
+    width.clear();
+    height.clear();
+    flags.clear();
+    confidence.clear();
+    object_ids.clear();
+    next_rows.clear();
+    frame_heads.clear();
+}
+
+const int64_t * LabelTable::get_frame_numbers() {
+    return frame_numbers.data();
+}
+
+const float * LabelTable::get_x() {
+    return x.data();
+}
+
+const float * LabelTable::get_y() {
+    return y.data();
+}
+
+const float * LabelTable::get_width() {
+    return width.data();
+}
+
+const float * LabelTable::get_height() {
+    return height.data();
+}
+
+const uint32_t * LabelTable::get_object_ids() {
+    return object_ids.data();
+}
+
+const uint32_t * LabelTable::get_flags() {
+    return flags.data();
+}
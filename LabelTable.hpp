@@ -0,0 +1,67 @@
+/* 
+ * File:   LabelTable.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELTABLE_HPP
+#define LABELTABLE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include "LabelRecord.hpp"
+
+using namespace std;
+
+class LabelTable {
+public:
+    LabelTable();
+    LabelTable(const LabelTable& orig);
+    virtual ~LabelTable();
+
+    int put(const LabelRecord&);
+
+    int find(long, uint32_t);
+
+    int first_in_frame(long);
+
+    int next_in_frame(int);
+
+    LabelRecord get(int);
+
+    size_t size();
+
+    void reserve(size_t);
+
+    void clear();
+
+    // Columns, indexed by row
+    const int64_t * get_frame_numbers();
+    const float * get_x();
+    const float * get_y();
+    const float * get_width();
+    const float * get_height();
+    const uint32_t * get_object_ids();
+    const uint32_t * get_flags();
+
+private:
+
+    // One column per field, so that drawing or searching the labels of a
+    // frame only touches the fields it needs
+    vector<int64_t> frame_numbers;
+    vector<int64_t> times;
+    vector<float> x;
+    vector<float> y;
+    vector<float> width;
+    vector<float> height;
+    vector<uint32_t> flags;
+    vector<float> confidence;
+    vector<uint32_t> object_ids;
+
+    // Rows of each frame are chained, the head is the first row of the frame
+    unordered_map<long, int> frame_heads;
+    vector<int> next_rows;
+
+};
+
+#endif /* LABELTABLE_HPP */
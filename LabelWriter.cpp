@@ -0,0 +1,392 @@
+/* 
+ * File:   LabelWriter.cpp
+ * Author: Jan Dufek
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include "LabelWriter.hpp"
+
+/**
+ * Opens the label file and starts the writer thread.
+ * 
+ * @param file_name label file
+ * @param label_format LABEL_FORMAT_TEXT or LABEL_FORMAT_BINARY
+ * @param buffer_records number of records pre-allocated in the buffers
+ * @param sync_interval_ms milliseconds between two synchronizations to the disk
+ * @param append append to an existing label file of the same format
+ */
+LabelWriter::LabelWriter(string file_name, int label_format, int buffer_records, int sync_interval_ms, bool append) : synced_frame(-1), status(0) {
+
+    format = label_format;
+    sync_interval = sync_interval_ms > 0 ? sync_interval_ms : 1;
+    stop_requested = false;
+    written_frame = -1;
+
+    // Pre-allocate the buffers so that writing a label does not allocate
+    front_buffer.reserve(buffer_records);
+    back_buffer.reserve(buffer_records);
+    flush_threshold = buffer_records / 2 > 0 ? buffer_records / 2 : 1;
+
+    if (append) {
+        file = fopen(file_name.c_str(), format == LABEL_FORMAT_BINARY ? "ab" : "a");
+    } else {
+        file = fopen(file_name.c_str(), format == LABEL_FORMAT_BINARY ? "wb" : "w");
+    }
+
+    if (file == NULL) {
+        return;
+    }
+
+    // Records of a different size cannot be appended
+    if (format == LABEL_FORMAT_BINARY && ftell(file) > 0) {
+
+        LabelFileHeader header;
+        FILE * existing_file = fopen(file_name.c_str(), "rb");
+
+        bool compatible = existing_file != NULL && fread(&header, sizeof (header), 1, existing_file) == 1 && header.record_size == sizeof (LabelRecord);
+
+        if (existing_file != NULL) {
+            fclose(existing_file);
+        }
+
+        if (!compatible) {
+            fclose(file);
+            file = NULL;
+            return;
+        }
+    }
+
+    // Appended files already have the header
+    if (format == LABEL_FORMAT_BINARY && ftell(file) == 0) {
+
+        LabelFileHeader header;
+        memcpy(header.magic, LABEL_FILE_MAGIC, sizeof (header.magic));
+        header.record_size = sizeof (LabelRecord);
+        header.reserved = 0;
+
+        fwrite(&header, sizeof (header), 1, file);
+    }
+
+    writer = thread(&LabelWriter::run, this);
+}
+
+LabelWriter::LabelWriter(const LabelWriter& orig) {
+}
+
+LabelWriter::~LabelWriter() {
+    close();
+}
+
+/**
+ * Check whether the label file was opened.
+ * 
+ * @return true if the file is open
+ */
+bool LabelWriter::is_open() {
+    return file != NULL;
+}
+
+/**
+ * Queue one label. Only copies the record into the pre-allocated buffer, the
+ * formatting and file output is done by the writer thread.
+ * 
+ * @param frame_number frame number
+ * @param time wall clock time in nanoseconds since the epoch
+ * @param x x coordinate
+ * @param y y coordinate
+ * @param flags label flags
+ * @param confidence confidence of tracked labels
+ */
+void LabelWriter::write(long frame_number, int64_t time, float x, float y, uint32_t flags, float confidence) {
+
+    LabelRecord record;
+    record.frame_number = frame_number;
+    record.time = time;
+    record.x = x;
+    record.y = y;
+    record.flags = flags;
+    record.confidence = confidence;
+    record.object_id = 0;
+    record.width = 0;
+    record.height = 0;
+    record.reserved = 0;
+
+    write(record);
+}
+
+/**
+ * Queue one label record.
+ * 
+ * @param record label
+ */
+void LabelWriter::write(const LabelRecord& record) {
+
+    if (file == NULL) {
+        return;
+    }
+
+    bool wake_writer;
+
+    {
+        lock_guard<mutex> lock(buffer_mutex);
+        front_buffer.push_back(record);
+        wake_writer = front_buffer.size() >= flush_threshold;
+    }
+
+    if (wake_writer) {
+        buffer_ready.notify_one();
+    }
+}
+
+/**
+ * Writer loop. Swaps the buffers when enough records are queued or the sync
+ * interval elapses, writes them and periodically synchronizes the file to the
+ * disk.
+ * 
+ */
+void LabelWriter::run() {
+
+    chrono::steady_clock::time_point last_sync = chrono::steady_clock::now();
+
+    unique_lock<mutex> lock(buffer_mutex);
+
+    while (true) {
+
+        buffer_ready.wait_for(lock, chrono::milliseconds(sync_interval), [this] {
+            return stop_requested || front_buffer.size() >= flush_threshold;
+        });
+
+        bool stopping = stop_requested;
+
+        front_buffer.swap(back_buffer);
+
+        function<void(long, int)> handler = sync_handler;
+
+        // Format and write without blocking the labeling loop
+        lock.unlock();
+
+        write_records(back_buffer);
+        back_buffer.clear();
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+        if (stopping || now - last_sync >= chrono::milliseconds(sync_interval)) {
+
+            sync();
+            last_sync = now;
+
+            // Blocking commits of the synced frame stay off the labeling loop
+            if (handler && synced_frame >= 0) {
+                handler(synced_frame, status);
+            }
+        }
+
+        lock.lock();
+
+        if (stopping && front_buffer.empty()) {
+            return;
+        }
+    }
+}
+
+/**
+ * Write records in the output format.
+ * 
+ * @param records records to write
+ */
+void LabelWriter::write_records(const vector<LabelRecord>& records) {
+
+    if (records.empty()) {
+        return;
+    }
+
+    written_frame = records.back().frame_number;
+
+    if (format == LABEL_FORMAT_BINARY) {
+        fwrite(&records[0], sizeof (LabelRecord), records.size(), file);
+        return;
+    }
+
+    char line[128];
+
+    for (size_t i = 0; i < records.size(); i++) {
+        int length = format_text(records[i], line, sizeof (line));
+        fwrite(line, 1, length, file);
+    }
+}
+
+/**
+ * Flush the file and synchronize it to the disk.
+ * 
+ */
+void LabelWriter::sync() {
+    fflush(file);
+
+    if (fsync(fileno(file)) == 0) {
+        synced_frame = written_frame;
+    }
+}
+
+/**
+ * Get the frame of the last label that is safely on the disk.
+ * 
+ * @return frame number, -1 if none
+ */
+long LabelWriter::get_synced_frame() {
+    return synced_frame;
+}
+
+/**
+ * Set the function called on the writer thread after each synchronization
+ * of the file, e.g., to record the synced frame in the session journal.
+ * 
+ * @param handler called with the synced frame and the labeling status
+ */
+void LabelWriter::set_sync_handler(function<void(long, int)> handler) {
+    lock_guard<mutex> lock(buffer_mutex);
+    sync_handler = handler;
+}
+
+/**
+ * Set the labeling status passed to the sync handler.
+ * 
+ * @param labeling_status status of the labeling
+ */
+void LabelWriter::set_status(int labeling_status) {
+    status = labeling_status;
+}
+
+/**
+ * Cut the incomplete last record a crash may leave at the end of a label file
+ * so that new records can be appended to it.
+ * 
+ * @param file_name label file
+ * @param label_format LABEL_FORMAT_TEXT or LABEL_FORMAT_BINARY
+ * @return false if the file could not be repaired
+ */
+bool LabelWriter::truncate_torn_record(string file_name, int label_format) {
+
+    struct stat file_status;
+
+    if (stat(file_name.c_str(), &file_status) != 0) {
+        return false;
+    }
+
+    off_t size = file_status.st_size;
+    off_t complete_size = size;
+
+    if (label_format == LABEL_FORMAT_BINARY) {
+
+        off_t header_size = sizeof (LabelFileHeader);
+
+        if (size < header_size) {
+            return false;
+        }
+
+        complete_size = header_size + (size - header_size) / sizeof (LabelRecord) * sizeof (LabelRecord);
+
+    } else {
+
+        FILE * label_file = fopen(file_name.c_str(), "rb");
+
+        if (label_file == NULL) {
+            return false;
+        }
+
+        // Keep everything up to the last line end
+        while (complete_size > 0) {
+
+            fseeko(label_file, complete_size - 1, SEEK_SET);
+
+            if (fgetc(label_file) == '\n') {
+                break;
+            }
+
+            complete_size--;
+        }
+
+        fclose(label_file);
+    }
+
+    if (complete_size == size) {
+        return true;
+    }
+
+    return truncate(file_name.c_str(), complete_size) == 0;
+}
+
+/**
+ * Write the remaining records, stop the writer thread and close the file.
+ * 
+ */
+void LabelWriter::close() {
+
+    if (file == NULL) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(buffer_mutex);
+        stop_requested = true;
+    }
+
+    buffer_ready.notify_one();
+
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    fclose(file);
+    file = NULL;
+}
+
+/**
+ * Get current wall clock time.
+ * 
+ * @return nanoseconds since the epoch
+ */
+int64_t LabelWriter::current_time() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Format one record as a line of the text label format. The line is
+ * "time frame x y", where the time is the local time in format
+ * yearmonthdayhourminutesecond.nanoseconds. Non-zero flags are appended as a
+ * fifth column and the confidence of tracked labels as a sixth column.
+ * 
+ * @param record label
+ * @param line output buffer
+ * @param size size of the output buffer
+ * @return length of the line
+ */
+int LabelWriter::format_text(const LabelRecord& record, char* line, int size) {
+
+    time_t raw_time = record.time / 1000000000;
+    struct tm local_time;
+    localtime_r(&raw_time, &local_time);
+
+    char seconds[20];
+    strftime(seconds, 20, "%Y%m%d%H%M%S", &local_time);
+
+    char current_time[40];
+    snprintf(current_time, 40, "%s.%09lld", seconds, (long long) (record.time % 1000000000));
+
+    int length;
+
+    if (record.object_id != 0 || record.width != 0 || record.height != 0) {
+        length = snprintf(line, size, "%s %lld %g %g %u %.3f %u %g %g \n", current_time, (long long) record.frame_number, record.x, record.y, record.flags, record.confidence, record.object_id, record.width, record.height);
+    } else if (record.flags == 0) {
+        length = snprintf(line, size, "%s %lld %g %g \n", current_time, (long long) record.frame_number, record.x, record.y);
+    } else if (record.flags & LABEL_FLAG_TRACKED) {
+        length = snprintf(line, size, "%s %lld %g %g %u %.3f \n", current_time, (long long) record.frame_number, record.x, record.y, record.flags, record.confidence);
+    } else {
+        length = snprintf(line, size, "%s %lld %g %g %u \n", current_time, (long long) record.frame_number, record.x, record.y, record.flags);
+    }
+
+    return length < size ? length : size - 1;
+}
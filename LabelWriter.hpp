@@ -0,0 +1,101 @@
+/* 
+ * File:   LabelWriter.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LABELWRITER_HPP
+#define LABELWRITER_HPP
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "LabelRecord.hpp"
+
+using namespace std;
+
+class LabelWriter {
+public:
+    LabelWriter(string, int, int, int, bool = false);
+    LabelWriter(const LabelWriter& orig);
+    virtual ~LabelWriter();
+
+    bool is_open();
+
+    void write(long, int64_t, float, float, uint32_t, float = 0);
+
+    void write(const LabelRecord&);
+
+    void close();
+
+    long get_synced_frame();
+
+    void set_sync_handler(function<void(long, int)>);
+
+    void set_status(int);
+
+    static int64_t current_time();
+
+    static bool truncate_torn_record(string, int);
+
+    static int format_text(const LabelRecord&, char*, int);
+
+private:
+
+    void run();
+
+    void write_records(const vector<LabelRecord>&);
+
+    void sync();
+
+    // Output file
+    FILE * file;
+
+    // Output format
+    int format;
+
+    // Records written by the labeling loop
+    vector<LabelRecord> front_buffer;
+
+    // Records being written to the file by the writer thread
+    vector<LabelRecord> back_buffer;
+
+    // Number of records that wakes up the writer thread before the interval
+    size_t flush_threshold;
+
+    // Milliseconds between two synchronizations of the file to the disk
+    int sync_interval;
+
+    // The writer thread should write the remaining records and exit
+    bool stop_requested;
+
+    // Frame of the last record written by the writer thread
+    long written_frame;
+
+    // Frame of the last record synchronized to the disk, -1 if none
+    atomic<long> synced_frame;
+
+    // Status of the labeling passed to the sync handler
+    atomic<int> status;
+
+    // Called by the writer thread after each synchronization with the synced
+    // frame and the status, protected by the buffer mutex
+    function<void(long, int)> sync_handler;
+
+    // Writer thread
+    thread writer;
+
+    // Protects the front buffer
+    mutex buffer_mutex;
+
+    // Signaled when the front buffer should be written
+    condition_variable buffer_ready;
+
+};
+
+#endif /* LABELWRITER_HPP */
+
@@ -0,0 +1,102 @@
+/* 
+ * File:   OverlayLayer.cpp
+ * Author: Jan Dufek
+ */
+
+#include "OverlayLayer.hpp"
+
+/**
+ * Creates an empty overlay layer. The crosshairs and the texts are drawn into
+ * a canvas holding a copy of the shown frame. Before the next redraw, only the
+ * regions they were drawn into are restored from the clean frame.
+ * 
+ */
+OverlayLayer::OverlayLayer() {
+    full_copies = 0;
+    restored_bytes = 0;
+}
+
+OverlayLayer::OverlayLayer(const OverlayLayer& orig) {
+}
+
+OverlayLayer::~OverlayLayer() {
+}
+
+/**
+ * Set a new clean frame. This is the only full frame copy and it happens once
+ * per new frame.
+ * 
+ * @param frame clean frame in display resolution, it is not modified
+ */
+void OverlayLayer::set_base(const Mat& frame) {
+
+    base = frame;
+
+    base.copyTo(canvas);
+
+    dirty_regions.clear();
+
+    full_copies++;
+}
+
+/**
+ * Remove the previously drawn overlay by copying back the clean regions under
+ * it.
+ * 
+ * @return canvas ready for drawing
+ */
+Mat& OverlayLayer::restore() {
+
+    for (size_t i = 0; i < dirty_regions.size(); i++) {
+
+        Mat region = canvas(dirty_regions[i]);
+        base(dirty_regions[i]).copyTo(region);
+
+        restored_bytes += (long) dirty_regions[i].area() * base.elemSize();
+    }
+
+    dirty_regions.clear();
+
+    return canvas;
+}
+
+/**
+ * Record a region of the canvas that was drawn into.
+ * 
+ * @param region bounding box of the drawing, it is clipped to the canvas
+ */
+void OverlayLayer::mark(Rect region) {
+
+    region &= Rect(0, 0, canvas.cols, canvas.rows);
+
+    if (region.area() > 0) {
+        dirty_regions.push_back(region);
+    }
+}
+
+/**
+ * Get the frame with the overlay.
+ * 
+ * @return canvas
+ */
+Mat& OverlayLayer::get_canvas() {
+    return canvas;
+}
+
+/**
+ * Get the number of full frame copies.
+ * 
+ * @return number of copies
+ */
+long OverlayLayer::get_full_copies() {
+    return full_copies;
+}
+
+/**
+ * Get the number of bytes copied to remove the overlay.
+ * 
+ * @return number of bytes
+ */
+long OverlayLayer::get_restored_bytes() {
+    return restored_bytes;
+}
@@ -0,0 +1,51 @@
+/* 
+ * File:   OverlayLayer.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef OVERLAYLAYER_HPP
+#define OVERLAYLAYER_HPP
+
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+using namespace std;
+using namespace cv;
+
+class OverlayLayer {
+public:
+    OverlayLayer();
+    OverlayLayer(const OverlayLayer& orig);
+    virtual ~OverlayLayer();
+
+    void set_base(const Mat&);
+
+    Mat& restore();
+
+    void mark(Rect);
+
+    Mat& get_canvas();
+
+    long get_full_copies();
+
+    long get_restored_bytes();
+
+private:
+
+    // Clean frame the overlay is drawn over
+    Mat base;
+
+    // Frame with the overlay drawn in
+    Mat canvas;
+
+    // Regions of the canvas the overlay was drawn into
+    vector<Rect> dirty_regions;
+
+    // Statistics
+    long full_copies;
+    long restored_bytes;
+
+};
+
+#endif /* OVERLAYLAYER_HPP */
@@ -0,0 +1,314 @@
+/* 
+ * File:   SessionJournal.cpp
+ * Author: Jan Dufek
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
+#include "SessionJournal.hpp"
+
+// Identifies session files and their version
+static const char * SESSION_MAGIC = "GTLSES01";
+
+/**
+ * Creates a journal of the labeling session stored in the given file. The
+ * file is append-only. The header identifies the video and the label file and
+ * each checkpoint line records the last frame whose label is on the disk.
+ * Every line is written by a single append and synchronized, so a crash can
+ * at most leave an incomplete last line, which is ignored.
+ * 
+ * @param session_file_name session file
+ */
+SessionJournal::SessionJournal(string session_file_name) {
+    file_name = session_file_name;
+    file_descriptor = -1;
+    last_frame_number = -1;
+    last_status = -1;
+}
+
+SessionJournal::SessionJournal(const SessionJournal& orig) {
+}
+
+SessionJournal::~SessionJournal() {
+    if (file_descriptor >= 0) {
+        close(file_descriptor);
+    }
+}
+
+/**
+ * Read size and modification time of the video file.
+ * 
+ * @param video_file_name video file
+ * @param size file size in bytes
+ * @param time modification time
+ * @return false if the source is not a file (e.g., a stream)
+ */
+bool SessionJournal::read_video_file_status(string video_file_name, int64_t& size, int64_t& time) {
+
+    struct stat file_status;
+
+    if (stat(video_file_name.c_str(), &file_status) != 0 || !S_ISREG(file_status.st_mode)) {
+        return false;
+    }
+
+    size = file_status.st_size;
+    time = file_status.st_mtime;
+
+    return true;
+}
+
+/**
+ * Append one line and synchronize it to the disk.
+ * 
+ * @param line line including its line end
+ * @return true if the line is on the disk
+ */
+bool SessionJournal::append(const string& line) {
+
+    if (file_descriptor < 0) {
+        return false;
+    }
+
+    // A single write to a file opened for appending is not interleaved
+    if (write(file_descriptor, line.c_str(), line.size()) != (ssize_t) line.size()) {
+        return false;
+    }
+
+    return fdatasync(file_descriptor) == 0;
+}
+
+/**
+ * Start a new session file.
+ * 
+ * @param state identity of the video and the label file
+ * @return true if the header was written
+ */
+bool SessionJournal::create(const SessionState& state) {
+
+    file_descriptor = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+
+    stringstream header;
+    header << SESSION_MAGIC << "\n";
+    header << "video " << state.video_file_size << " " << state.video_file_time << " " << state.video_file_name << "\n";
+    header << "labels " << state.label_format << " " << state.label_file_name << "\n";
+    header << "settings " << state.keyframe_interval << "\n";
+
+    return append(header.str());
+}
+
+/**
+ * Continue an existing session file.
+ * 
+ * @return true if the file was opened
+ */
+bool SessionJournal::reopen() {
+
+    file_descriptor = open(file_name.c_str(), O_WRONLY | O_APPEND);
+
+    if (file_descriptor < 0) {
+        return false;
+    }
+
+    // Start the continued part on a new line if the last one was torn
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) == 0 && file_status.st_size > 0) {
+
+        char last = '\n';
+        int read_descriptor = open(file_name.c_str(), O_RDONLY);
+
+        if (read_descriptor >= 0) {
+            if (pread(read_descriptor, &last, 1, file_status.st_size - 1) != 1) {
+                last = '\n';
+            }
+            close(read_descriptor);
+        }
+
+        if (last != '\n') {
+            return append("\n");
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Record the last committed frame and the status.
+ * 
+ * @param frame_number frame whose label is on the disk
+ * @param status status of the labeling
+ * @return true if the checkpoint is on the disk
+ */
+bool SessionJournal::checkpoint(long frame_number, int status) {
+
+    if (frame_number == last_frame_number && status == last_status) {
+        return true;
+    }
+
+    last_frame_number = frame_number;
+    last_status = status;
+
+    stringstream line;
+    line << "frame " << frame_number << " " << status << "\n";
+
+    return append(line.str());
+}
+
+/**
+ * Mark the session finished so that it is not resumed.
+ * 
+ * @return true if the mark is on the disk
+ */
+bool SessionJournal::finish() {
+    return append("end\n");
+}
+
+/**
+ * Check whether the session file is open.
+ * 
+ * @return true if checkpoints can be written
+ */
+bool SessionJournal::is_open() {
+    return file_descriptor >= 0;
+}
+
+/**
+ * Get the session file name.
+ * 
+ * @return file name
+ */
+string SessionJournal::get_file_name() {
+    return file_name;
+}
+
+/**
+ * Read a session file. Lines without a line end were torn by a crash and are
+ * ignored.
+ * 
+ * @param session_file_name session file
+ * @param state output
+ * @return false if the file is not a session file
+ */
+bool SessionJournal::load(string session_file_name, SessionState& state) {
+
+    ifstream session_file(session_file_name.c_str(), ios::binary);
+
+    if (!session_file.is_open()) {
+        return false;
+    }
+
+    string contents((istreambuf_iterator<char>(session_file)), istreambuf_iterator<char>());
+
+    // Drop the torn last line
+    size_t end = contents.rfind('\n');
+    contents = end == string::npos ? "" : contents.substr(0, end + 1);
+
+    stringstream lines(contents);
+    string line;
+
+    if (!getline(lines, line) || line != SESSION_MAGIC) {
+        return false;
+    }
+
+    state.video_file_name = "";
+    state.label_file_name = "";
+    state.label_format = 0;
+    state.keyframe_interval = 1;
+    state.frame_number = -1;
+    state.status = 0;
+    state.finished = false;
+
+    while (getline(lines, line)) {
+
+        stringstream fields(line);
+        string key;
+        fields >> key;
+
+        if (key == "video") {
+            fields >> state.video_file_size >> state.video_file_time;
+            fields.get();
+            getline(fields, state.video_file_name);
+        } else if (key == "labels") {
+            fields >> state.label_format;
+            fields.get();
+            getline(fields, state.label_file_name);
+        } else if (key == "settings") {
+            fields >> state.keyframe_interval;
+        } else if (key == "frame") {
+            fields >> state.frame_number >> state.status;
+        } else if (key == "end") {
+            state.finished = true;
+        }
+    }
+
+    return !state.video_file_name.empty() && !state.label_file_name.empty();
+}
+
+/**
+ * Find the most recent unfinished session of the video.
+ * 
+ * @param directory directory with the session files
+ * @param video_file_name labeled video
+ * @param state output
+ * @param session_file_name output
+ * @return true if a session to resume was found
+ */
+bool SessionJournal::find_resumable(string directory, string video_file_name, SessionState& state, string& session_file_name) {
+
+    int64_t video_size, video_time;
+
+    // Streams cannot be resumed
+    if (!read_video_file_status(video_file_name, video_size, video_time)) {
+        return false;
+    }
+
+    DIR * session_directory = opendir(directory.c_str());
+
+    if (session_directory == NULL) {
+        return false;
+    }
+
+    bool found = false;
+    time_t found_time = 0;
+
+    struct dirent * entry;
+
+    while ((entry = readdir(session_directory)) != NULL) {
+
+        string name = entry->d_name;
+
+        if (name.size() <= 8 || name.compare(name.size() - 8, 8, ".session") != 0) {
+            continue;
+        }
+
+        string path = directory + "/" + name;
+
+        struct stat file_status;
+        SessionState candidate;
+
+        if (stat(path.c_str(), &file_status) != 0 || !load(path, candidate)) {
+            continue;
+        }
+
+        if (candidate.finished || candidate.video_file_name != video_file_name || candidate.video_file_size != video_size || candidate.video_file_time != video_time) {
+            continue;
+        }
+
+        if (!found || file_status.st_mtime >= found_time) {
+            found = true;
+            found_time = file_status.st_mtime;
+            state = candidate;
+            session_file_name = path;
+        }
+    }
+
+    closedir(session_directory);
+
+    return found;
+}
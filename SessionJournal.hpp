@@ -0,0 +1,67 @@
+/* 
+ * File:   SessionJournal.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SESSIONJOURNAL_HPP
+#define SESSIONJOURNAL_HPP
+
+#include <stdint.h>
+#include <string>
+
+using namespace std;
+
+// Labeling session as recorded in a session file
+struct SessionState {
+    string video_file_name;
+    int64_t video_file_size;
+    int64_t video_file_time;
+    string label_file_name;
+    int label_format;
+    int keyframe_interval;
+    long frame_number; // Last committed frame, -1 if none
+    int status;
+    bool finished; // The end of the video was reached
+};
+
+class SessionJournal {
+public:
+    SessionJournal(string);
+    SessionJournal(const SessionJournal& orig);
+    virtual ~SessionJournal();
+
+    bool create(const SessionState&);
+
+    bool reopen();
+
+    bool checkpoint(long, int);
+
+    bool finish();
+
+    bool is_open();
+
+    string get_file_name();
+
+    static bool load(string, SessionState&);
+
+    static bool find_resumable(string, string, SessionState&, string&);
+
+    static bool read_video_file_status(string, int64_t&, int64_t&);
+
+private:
+
+    bool append(const string&);
+
+    // Session file
+    string file_name;
+
+    // Descriptor of the session file opened for appending, -1 if closed
+    int file_descriptor;
+
+    // Last checkpoint written, to skip repeated ones
+    long last_frame_number;
+    int last_status;
+
+};
+
+#endif /* SESSIONJOURNAL_HPP */
@@ -0,0 +1,54 @@
+/* 
+ * File:   SettingTypes.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SETTINGTYPES_HPP
+#define SETTINGTYPES_HPP
+
+// Values of the settings that choose between methods of the modules. Kept
+// apart from the modules so that the settings do not depend on them.
+
+// Interpolation between labeled frames
+enum InterpolationMethod {
+    INTERPOLATION_LINEAR = 0,
+
+    // Cubic Hermite spline with tangents from the neighboring labeled frames
+    INTERPOLATION_SPLINE = 1
+};
+
+// Where the lens distortion is removed
+enum UndistortionMode {
+    UNDISTORTION_NONE = 0,
+    UNDISTORTION_FRAMES = 1,
+    UNDISTORTION_LABELS = 2
+};
+
+// How the cursor samples of a frame are summarized into one label
+enum CursorSummary {
+    CURSOR_SUMMARY_LAST = 0,
+    CURSOR_SUMMARY_MEDIAN = 1,
+    CURSOR_SUMMARY_DWELL = 2
+};
+
+// Capture backends, DECODER_BACKEND_AUTO probes the others
+enum DecoderBackend {
+    DECODER_BACKEND_AUTO = 0,
+    DECODER_BACKEND_ANY = 1,
+    DECODER_BACKEND_FFMPEG = 2,
+    DECODER_BACKEND_GSTREAMER = 3,
+    DECODER_BACKEND_AVFOUNDATION = 4
+};
+
+// How the labels of several annotators are combined into one
+enum MergeConsensus {
+
+    // Median of the x and y coordinates
+    MERGE_CONSENSUS_MEDIAN = 0,
+
+    // Mean weighted by how long each annotator stayed on the frame
+    MERGE_CONSENSUS_DWELL = 1
+};
+
+#endif /* SETTINGTYPES_HPP */
+
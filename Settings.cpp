@@ -1 +1,485 @@
-#include "Settings.hpp"
\ No newline at end of file
+/*
+ * File:   Settings.cpp
+ * Author: Jan Dufek
+ */
+
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <limits.h>
+#include <iostream>
+#include <fstream>
+#include "Settings.hpp"
+
+// Names of the values of the enumerated settings, the index is the value
+static const char * const LABEL_FORMAT_NAMES[] = {"LABEL_FORMAT_TEXT", "LABEL_FORMAT_BINARY", NULL};
+static const char * const INTERPOLATION_NAMES[] = {"INTERPOLATION_LINEAR", "INTERPOLATION_SPLINE", NULL};
+static const char * const UNDISTORTION_NAMES[] = {"UNDISTORTION_NONE", "UNDISTORTION_FRAMES", "UNDISTORTION_LABELS", NULL};
+static const char * const CURSOR_SUMMARY_NAMES[] = {"CURSOR_SUMMARY_LAST", "CURSOR_SUMMARY_MEDIAN", "CURSOR_SUMMARY_DWELL", NULL};
+static const char * const MERGE_CONSENSUS_NAMES[] = {"MERGE_CONSENSUS_MEDIAN", "MERGE_CONSENSUS_DWELL", NULL};
+static const char * const DECODER_BACKEND_NAMES[] = {"DECODER_BACKEND_AUTO", "DECODER_BACKEND_ANY", "DECODER_BACKEND_FFMPEG", "DECODER_BACKEND_GSTREAMER", "DECODER_BACKEND_AVFOUNDATION", NULL};
+
+// Configuration file loaded if none is given on the command line
+static const char * DEFAULT_CONFIGURATION_FILE = "settings.cfg";
+
+Settings::Settings() {
+}
+
+Settings::Settings(const Settings& orig) {
+}
+
+Settings::~Settings() {
+}
+
+/**
+ * Get the settings that can be configured at run time with their valid
+ * ranges.
+ *
+ * @return settings
+ */
+vector<Settings::SettingField> Settings::fields() {
+
+    SettingField list[] = {
+        {"video_capture_source", SETTING_STRING, &video_capture_source, 0, 0, NULL},
+        {"time_for_annotation", SETTING_INT, &time_for_annotation, 1, 60000, NULL},
+        {"DECODER_BACKEND", SETTING_INT, &DECODER_BACKEND, DECODER_BACKEND_AUTO, DECODER_BACKEND_AVFOUNDATION, DECODER_BACKEND_NAMES},
+        {"DECODER_PROBE_FRAMES", SETTING_INT, &DECODER_PROBE_FRAMES, 1, 100000, NULL},
+        {"DECODER_FRAME_HEIGHT", SETTING_INT, &DECODER_FRAME_HEIGHT, 0, 65536, NULL},
+        {"CAPTURE_RING", SETTING_BOOL, &CAPTURE_RING, 0, 1, NULL},
+        {"CAPTURE_RING_SEGMENT_FRAMES", SETTING_INT, &CAPTURE_RING_SEGMENT_FRAMES, 1, 1 << 20, NULL},
+        {"CAPTURE_RING_SEGMENTS", SETTING_INT, &CAPTURE_RING_SEGMENTS, 2, 10000, NULL},
+        {"CAPTURE_RING_FORMAT", SETTING_STRING, &CAPTURE_RING_FORMAT, 0, 0, NULL},
+        {"CAPTURE_RING_QUALITY", SETTING_INT, &CAPTURE_RING_QUALITY, 0, 100, NULL},
+        {"CAPTURE_RING_KEEP", SETTING_BOOL, &CAPTURE_RING_KEEP, 0, 1, NULL},
+        {"UNDISTORTION", SETTING_INT, &UNDISTORTION, UNDISTORTION_NONE, UNDISTORTION_LABELS, UNDISTORTION_NAMES},
+        {"CAMERA_CALIBRATION_SIZE", SETTING_SIZE, &CAMERA_CALIBRATION_SIZE, 1, 65536, NULL},
+        {"UNDISTORTION_CACHE_DIRECTORY", SETTING_STRING, &UNDISTORTION_CACHE_DIRECTORY, 0, 0, NULL},
+        {"LABEL_FORMAT", SETTING_INT, &LABEL_FORMAT, LABEL_FORMAT_TEXT, LABEL_FORMAT_BINARY, LABEL_FORMAT_NAMES},
+        {"LABEL_BUFFER_RECORDS", SETTING_INT, &LABEL_BUFFER_RECORDS, 1, 1 << 24, NULL},
+        {"LABEL_SYNC_INTERVAL", SETTING_INT, &LABEL_SYNC_INTERVAL, 1, 3600000, NULL},
+        {"LABEL_STORE", SETTING_BOOL, &LABEL_STORE, 0, 1, NULL},
+        {"SESSION_RESUME", SETTING_BOOL, &SESSION_RESUME, 0, 1, NULL},
+        {"KEYFRAME_INTERVAL", SETTING_INT, &KEYFRAME_INTERVAL, 1, 10000, NULL},
+        {"INTERPOLATION_METHOD", SETTING_INT, &INTERPOLATION_METHOD, INTERPOLATION_LINEAR, INTERPOLATION_SPLINE, INTERPOLATION_NAMES},
+        {"MAXIMUM_INTERPOLATION_GAP", SETTING_INT, &MAXIMUM_INTERPOLATION_GAP, 1, INT_MAX, NULL},
+        {"CURSOR_SUMMARY", SETTING_INT, &CURSOR_SUMMARY, CURSOR_SUMMARY_LAST, CURSOR_SUMMARY_DWELL, CURSOR_SUMMARY_NAMES},
+        {"CURSOR_SUMMARY_WINDOW", SETTING_INT, &CURSOR_SUMMARY_WINDOW, 0, 60000, NULL},
+        {"CURSOR_SAMPLE_CAPACITY", SETTING_INT, &CURSOR_SAMPLE_CAPACITY, 16, 1 << 24, NULL},
+        {"CURSOR_TRACE", SETTING_BOOL, &CURSOR_TRACE, 0, 1, NULL},
+        {"ADAPTIVE_PACING", SETTING_BOOL, &ADAPTIVE_PACING, 0, 1, NULL},
+        {"PACING_MINIMUM_INTERVAL", SETTING_INT, &PACING_MINIMUM_INTERVAL, 1, 60000, NULL},
+        {"PACING_MAXIMUM_INTERVAL", SETTING_INT, &PACING_MAXIMUM_INTERVAL, 1, 60000, NULL},
+        {"PACING_MOTION_THRESHOLD", SETTING_DOUBLE, &PACING_MOTION_THRESHOLD, 0, 255, NULL},
+        {"PACING_CURSOR_THRESHOLD", SETTING_DOUBLE, &PACING_CURSOR_THRESHOLD, 0, DBL_MAX, NULL},
+        {"PACING_SPEEDUP", SETTING_DOUBLE, &PACING_SPEEDUP, 0.01, 1, NULL},
+        {"PACING_SLOWDOWN", SETTING_DOUBLE, &PACING_SLOWDOWN, 1, 100, NULL},
+        {"AUTO_SKIP", SETTING_BOOL, &AUTO_SKIP, 0, 1, NULL},
+        {"AUTO_SKIP_THRESHOLD", SETTING_DOUBLE, &AUTO_SKIP_THRESHOLD, 0, 255, NULL},
+        {"AUTO_SKIP_MAXIMUM_RUN", SETTING_INT, &AUTO_SKIP_MAXIMUM_RUN, 0, INT_MAX, NULL},
+        {"AUTO_SKIP_INTERVAL", SETTING_INT, &AUTO_SKIP_INTERVAL, 1, 60000, NULL},
+        {"AUTO_SKIP_SIGNATURE_WIDTH", SETTING_INT, &AUTO_SKIP_SIGNATURE_WIDTH, 8, 1024, NULL},
+        {"TIMING_TRACE", SETTING_BOOL, &TIMING_TRACE, 0, 1, NULL},
+        {"TIMING_TRACE_CAPACITY", SETTING_INT, &TIMING_TRACE_CAPACITY, 1, 1 << 26, NULL},
+        {"LATE_FRAME_TOLERANCE", SETTING_INT, &LATE_FRAME_TOLERANCE, 0, 60000, NULL},
+        {"TRACKER_ASSIST", SETTING_BOOL, &TRACKER_ASSIST, 0, 1, NULL},
+        {"TRACKER_SCALE", SETTING_DOUBLE, &TRACKER_SCALE, 0.01, 1, NULL},
+        {"TRACKER_TEMPLATE_SIZE", SETTING_INT, &TRACKER_TEMPLATE_SIZE, 4, 1024, NULL},
+        {"TRACKER_SEARCH_RADIUS", SETTING_INT, &TRACKER_SEARCH_RADIUS, 1, 1024, NULL},
+        {"TRACKER_UPDATE_CONFIDENCE", SETTING_DOUBLE, &TRACKER_UPDATE_CONFIDENCE, 0, 1, NULL},
+        {"TRACKER_REVIEW_CONFIDENCE", SETTING_DOUBLE, &TRACKER_REVIEW_CONFIDENCE, 0, 1, NULL},
+        {"BATCH_RENDER_OVERLAY", SETTING_BOOL, &BATCH_RENDER_OVERLAY, 0, 1, NULL},
+        {"BATCH_CROP_PATCHES", SETTING_BOOL, &BATCH_CROP_PATCHES, 0, 1, NULL},
+        {"BATCH_PATCH_SIZE", SETTING_INT, &BATCH_PATCH_SIZE, 1, 4096, NULL},
+        {"BATCH_THREADS", SETTING_INT, &BATCH_THREADS, 0, 1024, NULL},
+        {"BATCH_QUEUE_DEPTH", SETTING_INT, &BATCH_QUEUE_DEPTH, 1, 1024, NULL},
+        {"EVALUATION_LOST_THRESHOLD", SETTING_DOUBLE, &EVALUATION_LOST_THRESHOLD, 0, DBL_MAX, NULL},
+        {"EVALUATION_MAXIMUM_THRESHOLD", SETTING_INT, &EVALUATION_MAXIMUM_THRESHOLD, 1, 10000, NULL},
+        {"MERGE_CONSENSUS", SETTING_INT, &MERGE_CONSENSUS, MERGE_CONSENSUS_MEDIAN, MERGE_CONSENSUS_DWELL, MERGE_CONSENSUS_NAMES},
+        {"MERGE_OUTLIER_DISTANCE", SETTING_DOUBLE, &MERGE_OUTLIER_DISTANCE, 0, DBL_MAX, NULL},
+        {"MERGE_DISAGREEMENT_THRESHOLD", SETTING_DOUBLE, &MERGE_DISAGREEMENT_THRESHOLD, 0, DBL_MAX, NULL},
+        {"MERGE_REORDER_WINDOW", SETTING_INT, &MERGE_REORDER_WINDOW, 1, 1 << 24, NULL},
+        {"MERGE_MAXIMUM_DWELL", SETTING_INT, &MERGE_MAXIMUM_DWELL, 1, 3600000, NULL},
+        {"MINIMUM_BOX_DRAG", SETTING_INT, &MINIMUM_BOX_DRAG, 1, 1000, NULL},
+        {"DISPLAY_VIDEO_HEIGHT_LIMIT", SETTING_INT, &DISPLAY_VIDEO_HEIGHT_LIMIT, 16, 65536, NULL},
+        {"DISPLAY_MAXIMUM_ZOOM", SETTING_DOUBLE, &DISPLAY_MAXIMUM_ZOOM, 1, 1024, NULL},
+        {"DISPLAY_ZOOM_STEP", SETTING_DOUBLE, &DISPLAY_ZOOM_STEP, 1.01, 16, NULL},
+        {"EVENT_POLL_INTERVAL", SETTING_INT, &EVENT_POLL_INTERVAL, 1, 1000, NULL},
+        {"PROCESSING_VIDEO_HEIGHT_LIMIT", SETTING_INT, &PROCESSING_VIDEO_HEIGHT_LIMIT, 16, 65536, NULL},
+        {"PREFETCH_QUEUE_DEPTH", SETTING_INT, &PREFETCH_QUEUE_DEPTH, 1, 256, NULL},
+        {"FRAME_CACHE_BUDGET_MB", SETTING_INT, &FRAME_CACHE_BUDGET_MB, 0, 1 << 20, NULL},
+        {"FRAME_CACHE_DISPLAY_HEIGHT", SETTING_INT, &FRAME_CACHE_DISPLAY_HEIGHT, 0, 65536, NULL}
+    };
+
+    return vector<SettingField>(list, list + sizeof (list) / sizeof (list[0]));
+}
+
+/**
+ * Remove white space around a string.
+ *
+ * @param text string
+ * @return string without leading and trailing white space
+ */
+static string trim(const string& text) {
+
+    size_t first = text.find_first_not_of(" \t\r\n");
+
+    if (first == string::npos) {
+        return "";
+    }
+
+    return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+/**
+ * Configure the settings from the configuration file and the command line.
+ * The configuration file is applied first, then its profiles matching the
+ * video source and then the command line. Recognized options:
+ *
+ * --config file       configuration file instead of settings.cfg
+ * --set name=value    set a setting
+ *
+ * The first other argument is the video source, after --batch the second.
+ *
+ * @param argc number of arguments
+ * @param argv arguments
+ * @param arguments arguments that are not options
+ * @return false if a setting is invalid
+ */
+bool Settings::configure(int argc, char** argv, vector<string>& arguments) {
+
+    configuration_file_name = DEFAULT_CONFIGURATION_FILE;
+    bool configuration_required = false;
+
+    vector<string> assignments;
+
+    for (int i = 1; i < argc; i++) {
+
+        string argument = argv[i];
+
+        if (argument == "--config" && i + 1 < argc) {
+            configuration_file_name = argv[++i];
+            configuration_required = true;
+        } else if (argument == "--set" && i + 1 < argc) {
+            assignments.push_back(argv[++i]);
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+
+    // Only a configuration file given on the command line has to exist
+    if (!configuration_required && !ifstream(configuration_file_name.c_str()).good()) {
+        configuration_file_name.clear();
+    }
+
+    if (!configuration_file_name.empty() && !load(configuration_file_name, false)) {
+        return false;
+    }
+
+    // Video source from the command line selects the profiles
+    if (!arguments.empty()) {
+        if (arguments[0] == "--batch" && arguments.size() > 1) {
+            video_capture_source = arguments[1];
+        } else if (arguments[0].compare(0, 2, "--") != 0) {
+            video_capture_source = arguments[0];
+        }
+    }
+
+    // The command line is applied before the profiles so that a source set
+    // with --set selects them, and after them to override them
+    for (int pass = 0; pass < 2; pass++) {
+
+        for (size_t i = 0; i < assignments.size(); i++) {
+
+            size_t separator = assignments[i].find('=');
+
+            if (separator == string::npos) {
+                cout << "Invalid setting " << assignments[i] << ", expected name=value" << endl;
+                return false;
+            }
+
+            if (!set(trim(assignments[i].substr(0, separator)), trim(assignments[i].substr(separator + 1)))) {
+                return false;
+            }
+        }
+
+        if (pass == 0 && !configuration_file_name.empty() && !load(configuration_file_name, true)) {
+            return false;
+        }
+    }
+
+    return validate();
+}
+
+/**
+ * Load a configuration file. Lines are name = value pairs, # starts a comment.
+ * Settings after a [source pattern] line form a profile that applies only if
+ * the video source matches the shell wildcard pattern.
+ *
+ * @param file_name configuration file
+ * @param profiles true to apply the matching profiles, false to apply the
+ * settings outside of profiles
+ * @return false if the file cannot be read or a setting is invalid
+ */
+bool Settings::load(string file_name, bool profiles) {
+
+    ifstream file(file_name.c_str());
+
+    if (!file.is_open()) {
+        cout << "Cannot open configuration file " << file_name << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+
+    // Settings outside of profiles are applied in the first pass
+    bool applied = !profiles;
+
+    while (getline(file, line)) {
+
+        line_number++;
+
+        line = trim(line.substr(0, line.find('#')));
+
+        if (line.empty()) {
+            continue;
+        }
+
+        // Profile header
+        if (line[0] == '[') {
+
+            if (line[line.size() - 1] != ']' || line.compare(0, 8, "[source ") != 0) {
+                cout << file_name << ":" << line_number << ": expected [source pattern]" << endl;
+                return false;
+            }
+
+            string pattern = trim(line.substr(8, line.size() - 9));
+
+            applied = profiles && fnmatch(pattern.c_str(), video_capture_source.c_str(), 0) == 0;
+
+            if (applied) {
+                cout << "Applying profile " << pattern << " from " << file_name << endl;
+            }
+
+            continue;
+        }
+
+        size_t separator = line.find('=');
+
+        if (separator == string::npos) {
+            cout << file_name << ":" << line_number << ": expected name = value" << endl;
+            return false;
+        }
+
+        if (applied && !set(trim(line.substr(0, separator)), trim(line.substr(separator + 1)))) {
+            cout << "in " << file_name << ":" << line_number << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Set a setting from its text value.
+ *
+ * @param name name of the setting as in Settings.hpp
+ * @param value value, enumerated settings also accept the names of the values
+ * @return false if the setting does not exist, cannot be configured or the
+ * value is invalid
+ */
+bool Settings::set(string name, string value) {
+
+    vector<SettingField> list = fields();
+
+    for (size_t i = 0; i < list.size(); i++) {
+        if (name == list[i].name) {
+            return set_field(list[i], value);
+        }
+    }
+
+    cout << "Unknown setting " << name << endl;
+
+    return false;
+}
+
+/**
+ * Parse and check a value and store it.
+ *
+ * @param field setting
+ * @param value text value
+ * @return false if the value is invalid
+ */
+bool Settings::set_field(const SettingField& field, string value) {
+
+    // Quotes are optional around strings
+    if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"') {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    const char * text = value.c_str();
+    char * end = NULL;
+
+    switch (field.type) {
+
+        case SETTING_BOOL:
+
+            if (value == "true" || value == "1" || value == "yes") {
+                *((bool *) field.value) = true;
+                return true;
+            }
+
+            if (value == "false" || value == "0" || value == "no") {
+                *((bool *) field.value) = false;
+                return true;
+            }
+
+            cout << "Invalid value " << value << " of " << field.name << ", expected true or false" << endl;
+
+            return false;
+
+        case SETTING_INT:
+        {
+            long number = 0;
+            bool found = false;
+
+            if (field.names != NULL) {
+                for (int i = 0; field.names[i] != NULL; i++) {
+                    if (value == field.names[i]) {
+                        number = i;
+                        found = true;
+                    }
+                }
+            }
+
+            if (!found) {
+                number = strtol(text, &end, 0);
+                found = !value.empty() && *end == '\0';
+            }
+
+            if (!found || number < field.minimum || number > field.maximum) {
+                cout << "Invalid value " << value << " of " << field.name << ", expected an integer from " << (long) field.minimum << " to " << (long) field.maximum << endl;
+                return false;
+            }
+
+            *((int *) field.value) = number;
+
+            return true;
+        }
+
+        case SETTING_DOUBLE:
+        {
+            double number = strtod(text, &end);
+
+            if (value.empty() || *end != '\0' || number < field.minimum || number > field.maximum) {
+                cout << "Invalid value " << value << " of " << field.name << ", expected a number from " << field.minimum << " to " << field.maximum << endl;
+                return false;
+            }
+
+            *((double *) field.value) = number;
+
+            return true;
+        }
+
+        case SETTING_STRING:
+
+            *((string *) field.value) = value;
+
+            return true;
+
+        case SETTING_SIZE:
+        {
+            int width = 0;
+            int height = 0;
+            char separator = 0;
+            char rest = 0;
+
+            if (sscanf(text, "%d%c%d%c", &width, &separator, &height, &rest) != 3 || separator != 'x' || width < field.minimum || height < field.minimum || width > field.maximum || height > field.maximum) {
+                cout << "Invalid value " << value << " of " << field.name << ", expected widthxheight" << endl;
+                return false;
+            }
+
+            *((Size *) field.value) = Size(width, height);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Check the settings that depend on each other.
+ *
+ * @return false if the settings are inconsistent
+ */
+bool Settings::validate() {
+
+    bool valid = true;
+
+    if (video_capture_source.empty()) {
+        cout << "Invalid settings: no video source" << endl;
+        valid = false;
+    }
+
+    if (MAXIMUM_INTERPOLATION_GAP < KEYFRAME_INTERVAL) {
+        cout << "Invalid settings: MAXIMUM_INTERPOLATION_GAP is shorter than KEYFRAME_INTERVAL" << endl;
+        valid = false;
+    }
+
+    if (PACING_MINIMUM_INTERVAL > PACING_MAXIMUM_INTERVAL) {
+        cout << "Invalid settings: PACING_MINIMUM_INTERVAL is longer than PACING_MAXIMUM_INTERVAL" << endl;
+        valid = false;
+    }
+
+    if (TRACKER_REVIEW_CONFIDENCE > TRACKER_UPDATE_CONFIDENCE) {
+        cout << "Invalid settings: TRACKER_REVIEW_CONFIDENCE is above TRACKER_UPDATE_CONFIDENCE" << endl;
+        valid = false;
+    }
+
+    return valid;
+}
+
+/**
+ * Print the settings that can be configured in the configuration file format.
+ *
+ * @param output output stream
+ */
+void Settings::print(ostream& output) {
+
+    if (!configuration_file_name.empty()) {
+        output << "# Configured by " << configuration_file_name << endl;
+    }
+
+    vector<SettingField> list = fields();
+
+    for (size_t i = 0; i < list.size(); i++) {
+
+        output << list[i].name << " = ";
+
+        switch (list[i].type) {
+            case SETTING_BOOL:
+                output << (*((bool *) list[i].value) ? "true" : "false");
+                break;
+            case SETTING_INT:
+                if (list[i].names != NULL) {
+                    output << list[i].names[*((int *) list[i].value)];
+                } else {
+                    output << *((int *) list[i].value);
+                }
+                break;
+            case SETTING_DOUBLE:
+                output << *((double *) list[i].value);
+                break;
+            case SETTING_STRING:
+                output << *((string *) list[i].value);
+                break;
+            case SETTING_SIZE:
+                output << ((Size *) list[i].value)->width << "x" << ((Size *) list[i].value)->height;
+                break;
+        }
+
+        output << endl;
+    }
+}
@@ -1,13 +1,45 @@
 #ifndef SETTINGS_HPP
 #define SETTINGS_HPP
 
-#include "opencv2/opencv.hpp"
+#include "opencv2/core.hpp"
+#include "LabelRecord.hpp"
+#include "SettingTypes.hpp"
 
 using namespace std;
 using namespace cv;
 
+// Types of the settings that can be configured at run time
+enum SettingType {
+    SETTING_BOOL,
+    SETTING_INT,
+    SETTING_DOUBLE,
+    SETTING_STRING,
+    SETTING_SIZE
+};
+
+/**
+ * Program settings. The values below are the defaults. Settings that are not
+ * const can be changed without rebuilding in a configuration file (by default
+ * settings.cfg in the working directory), in its [source ...] profiles that
+ * apply to matching video sources only, and on the command line, which
+ * overrides both. See config/trials.cfg.
+ */
 class Settings {
 public:
+
+    Settings();
+    Settings(const Settings& orig);
+    virtual ~Settings();
+
+    bool configure(int, char**, vector<string>&);
+
+    bool load(string, bool);
+
+    bool set(string, string);
+
+    bool validate();
+
+    void print(ostream&);
     
     ////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////
@@ -56,21 +88,272 @@ public:
     // Video files
     ////////////////////////////////////////////////////////////////////////////
   
-    // Trial 1: Lake Bryan AI Robotic class field test 2016 03 28
+    // Trial 1: Lake Bryan AI Robotic class field test 2016 03 28. The other
+    // trials are profiles in config/trials.cfg, the video is chosen on the
+    // command line.
     string video_capture_source = "input/2016_03_28_lake_bryan.mp4"; // Source video file to annotate
     int time_for_annotation = 1000; // Time for annotation specifies how many milliseconds to wait before loading the next frame. This has to be hight enough so that the annotator has enough time to move the cursor to the position to be annotated before the next frame is loaded.
 
-    // Trial 2: Fort Bend floods 2016 04 23
-//    string video_capture_source = "input/2016_04_23_fort_bend.mp4";
-//    int time_for_annotation = 250;
-    
-    // Trial 3: Lake Bryan AI Robotics class final 2016 05 10
-//    string video_capture_source = "input/2016_05_10_lake_bryan.mov";
-//    int time_for_annotation = 250;
+    ////////////////////////////////////////////////////////////////////////////////
+    // Decoding
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Capture backend. DECODER_BACKEND_AUTO decodes the beginning of a video
+    // file with each available backend once, keeps the fastest and caches the
+    // choice in <video>.decoder. Streams use the default backend.
+    int DECODER_BACKEND = DECODER_BACKEND_AUTO;
 
-    // Trial 4: Lab 2016 07 05
-//    string video_capture_source = "input/2016_07_05_lab.mp4";
-//    int time_for_annotation = 500;
+    // Frames decoded per configuration when probing
+    int DECODER_PROBE_FRAMES = 90;
+
+    // Frame height requested from cameras and streams, e.g., to capture at a
+    // lower resolution than the default one. Labels are recorded in the
+    // captured resolution. 0 for the default, video files ignore it.
+    int DECODER_FRAME_HEIGHT = 0;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Capture Ring
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Record the source on a capture thread into a ring of segment files in
+    // output/<date>_ground_truth_ring and label the recording at its own pace.
+    // Meant for live sources, see the [source ...] profiles. Video files are
+    // played at their frame rate to stand in for a camera.
+    bool CAPTURE_RING = false;
+
+    // Frames per segment and number of segments. When the ring is full, the
+    // oldest segment is overwritten.
+    int CAPTURE_RING_SEGMENT_FRAMES = 300;
+    int CAPTURE_RING_SEGMENTS = 20;
+
+    // Format the frames are stored in: .jpg, or .png or .bmp for lossless
+    // frames
+    string CAPTURE_RING_FORMAT = ".jpg";
+
+    // Quality of JPEG frames
+    int CAPTURE_RING_QUALITY = 95;
+
+    // Keep the segment files when done
+    bool CAPTURE_RING_KEEP = false;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Undistortion
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Remove the lens distortion using the calibration data above.
+    // UNDISTORTION_NONE records labels in the pixels of the video,
+    // UNDISTORTION_FRAMES shows undistorted frames and UNDISTORTION_LABELS
+    // shows the video as it is and only undistorts the recorded positions.
+    int UNDISTORTION = UNDISTORTION_NONE;
+
+    // Frame size the calibration data was computed for, it is scaled to the
+    // size of the video
+    Size CAMERA_CALIBRATION_SIZE = Size(1600, 1200);
+
+    // Directory the undistortion maps are cached in
+    string UNDISTORTION_CACHE_DIRECTORY = ".";
+
+    ////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////
+    // Output
+    ////////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Label file format, LABEL_FORMAT_TEXT or LABEL_FORMAT_BINARY
+    int LABEL_FORMAT = LABEL_FORMAT_TEXT;
+
+    // Number of labels pre-allocated in the label writer buffer
+    int LABEL_BUFFER_RECORDS = 4096;
+
+    // Milliseconds between two synchronizations of the label file to the disk
+    int LABEL_SYNC_INTERVAL = 1000;
+
+    // Also keep the labels in a memory mapped store (<output>.store) with one
+    // slot per frame, relabeled frames overwrite the previous label
+    bool LABEL_STORE = true;
+
+    // Continue the last unfinished session of the same video file from the
+    // frame after its last label. Sessions are recorded in output/*.session.
+    bool SESSION_RESUME = true;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Keyframe Labeling
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Only every Nth frame is shown for labeling, the frames in between are
+    // interpolated when the labeling is finished. 1 to label every frame.
+    int KEYFRAME_INTERVAL = 1;
+
+    // INTERPOLATION_LINEAR or INTERPOLATION_SPLINE
+    int INTERPOLATION_METHOD = INTERPOLATION_LINEAR;
+
+    // Gaps between labeled frames longer than this number of frames are not
+    // interpolated (e.g., when the recording was stopped). It has to be at
+    // least KEYFRAME_INTERVAL.
+    int MAXIMUM_INTERPOLATION_GAP = 300;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Cursor Sampling
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Every cursor move is recorded. The label is CURSOR_SUMMARY_LAST (the
+    // position when the annotation time is over), CURSOR_SUMMARY_MEDIAN or
+    // CURSOR_SUMMARY_DWELL (weighted by how long the cursor rested) of the
+    // positions in the summary window.
+    int CURSOR_SUMMARY = CURSOR_SUMMARY_LAST;
+
+    // Milliseconds before the label is taken that are summarized
+    int CURSOR_SUMMARY_WINDOW = 200;
+
+    // Number of cursor moves buffered between two frames
+    int CURSOR_SAMPLE_CAPACITY = 4096;
+
+    // Keep all cursor moves in <output>_cursor.txt
+    bool CURSOR_TRACE = false;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Adaptive Pacing
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Adapt time_for_annotation to the annotator and the scene. The time
+    // shortens while the cursor rests and the scene is static and grows when
+    // the cursor moves fast or the scene changes.
+    bool ADAPTIVE_PACING = false;
+
+    // Bounds of the time for annotation in milliseconds
+    int PACING_MINIMUM_INTERVAL = 150;
+    int PACING_MAXIMUM_INTERVAL = 1500;
+
+    // Mean gray level difference of two successive frames above which the
+    // scene is considered changing
+    double PACING_MOTION_THRESHOLD = 4.0;
+
+    // Cursor speed in display pixels per second above which the annotator is
+    // considered moving
+    double PACING_CURSOR_THRESHOLD = 200.0;
+
+    // The time is multiplied by the first factor when speeding up and by the
+    // second one when slowing down
+    double PACING_SPEEDUP = 0.9;
+    double PACING_SLOWDOWN = 1.5;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Auto Skip
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Carry the last label forward over frames that barely differ from the
+    // last labeled frame, e.g., while the target stands still
+    bool AUTO_SKIP = false;
+
+    // Mean absolute difference in gray levels of the frame signatures below
+    // which a frame is static
+    double AUTO_SKIP_THRESHOLD = 1.5;
+
+    // Static frames carried forward in a row before the annotator labels one
+    // again, 0 for no limit
+    int AUTO_SKIP_MAXIMUM_RUN = 150;
+
+    // Time static frames are shown in milliseconds, moving the cursor in the
+    // meantime labels the frame manually
+    int AUTO_SKIP_INTERVAL = 40;
+
+    // Width of the downscaled grayscale frames that are compared, also by
+    // ADAPTIVE_PACING
+    int AUTO_SKIP_SIGNATURE_WIDTH = 64;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Timing
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Time the stages of the labeling loop and the background threads and
+    // save <output>_trace.json (Chrome trace format) and <output>_timing.txt
+    bool TIMING_TRACE = false;
+
+    // Timed sections kept per thread, later ones are dropped
+    int TIMING_TRACE_CAPACITY = 1 << 18;
+
+    // Frames labeled more than this many milliseconds after the time for
+    // annotation are counted as late
+    int LATE_FRAME_TOLERANCE = 20;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Tracker Assist
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Propose the position in each new frame by tracking the last label. The
+    // proposal is logged unless the annotator moves the cursor to correct it.
+    bool TRACKER_ASSIST = false;
+
+    // The tracker searches images downscaled by this factor
+    double TRACKER_SCALE = 0.5;
+
+    // Size of the tracked template in downscaled pixels
+    int TRACKER_TEMPLATE_SIZE = 32;
+
+    // Maximum movement of the target between two frames in downscaled pixels
+    int TRACKER_SEARCH_RADIUS = 24;
+
+    // The template is updated from tracked positions with at least this
+    // confidence to follow appearance changes
+    double TRACKER_UPDATE_CONFIDENCE = 0.9;
+
+    // Tracked positions with lower confidence are counted for review
+    double TRACKER_REVIEW_CONFIDENCE = 0.5;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Batch Processing
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Render the labels into an overlay video for quality assurance
+    bool BATCH_RENDER_OVERLAY = true;
+
+    // Crop patches around the labeled positions
+    bool BATCH_CROP_PATCHES = true;
+
+    // Size of the cropped patches in pixels
+    int BATCH_PATCH_SIZE = 64;
+
+    // Number of render threads, 0 to use all cores
+    int BATCH_THREADS = 0;
+
+    // Number of frames queued between the pipeline stages
+    int BATCH_QUEUE_DEPTH = 8;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Evaluation
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Ground truth frames with a larger tracker error in pixels, or without a
+    // tracker position, count as lost
+    double EVALUATION_LOST_THRESHOLD = 50.0;
+
+    // The success curve is sampled at every pixel from 0 to this threshold
+    int EVALUATION_MAXIMUM_THRESHOLD = 50;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Consensus Merge
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Consensus of the annotators: MERGE_CONSENSUS_MEDIAN or
+    // MERGE_CONSENSUS_DWELL (mean weighted by how long each annotator stayed
+    // on the frame)
+    int MERGE_CONSENSUS = MERGE_CONSENSUS_MEDIAN;
+
+    // With three or more annotators, labels farther than this many pixels from
+    // the median are rejected before the consensus is computed
+    double MERGE_OUTLIER_DISTANCE = 30.0;
+
+    // Merged labels with an annotator farther than this many pixels from the
+    // consensus are flagged as disputed and reported
+    double MERGE_DISAGREEMENT_THRESHOLD = 15.0;
+
+    // Labels read ahead per annotator. Labels placed after going back further
+    // than this are skipped.
+    int MERGE_REORDER_WINDOW = 4096;
+
+    // Dwell on one frame is limited to this many milliseconds, e.g., when the
+    // video was paused
+    int MERGE_MAXIMUM_DWELL = 5000;
 
     ////////////////////////////////////////////////////////////////////////////////
     // GUI Parameters
@@ -85,15 +368,90 @@ public:
     // Object position crosshairs thickness
     const int LOCATION_THICKNESS = 1;
 
+    // Tracker proposal color
+    const Scalar TRACKER_COLOR = Scalar(255, 255, 0);
+
+    // Keys to step one frame backward and forward while paused
+    const int KEY_STEP_BACKWARD = 'a';
+    const int KEY_STEP_FORWARD = 'd';
+
+    // Key to label the shown frame as a keyframe while paused
+    const int KEY_LABEL_KEYFRAME = 'k';
+
+    // Keys selecting the labeled object, the first key selects object 0. The
+    // object can be switched while recording.
+    const string OBJECT_KEYS = "1234567890";
+
+    // Key to label the selected object as a point again after its box size
+    // was set by dragging with shift and the left button
+    const int KEY_CLEAR_BOX = 'x';
+
+    // Shorter left button drags in display pixels are clicks
+    int MINIMUM_BOX_DRAG = 4;
+
+    // Frames are shown downscaled to this number of lines. Labels are still
+    // recorded in original pixel coordinates.
+    int DISPLAY_VIDEO_HEIGHT_LIMIT = 1080;
+
+    // Largest zoom relative to the whole frame and the zoom factor of one
+    // scroll step or zoom key press
+    double DISPLAY_MAXIMUM_ZOOM = 16.0;
+    double DISPLAY_ZOOM_STEP = 1.25;
+
+    // Keys to zoom in and out around the cursor and to show the whole frame.
+    // The alternate zoom in key is the unshifted + key of US keyboards.
+    const int KEY_ZOOM_IN = '+';
+    const int KEY_ZOOM_IN_ALTERNATE = '=';
+    const int KEY_ZOOM_OUT = '-';
+    const int KEY_RESET_VIEW = 'z';
+
+    // Longest time in milliseconds before starting or stopping recording and
+    // frame slider jumps are picked up. Cursor moves are drawn right away.
+    int EVENT_POLL_INTERVAL = 50;
+
+    // Frame slider name
+    const string FRAME_TRACKBAR = "Frame";
+
     ////////////////////////////////////////////////////////////////////////////////
     // Algorithm Static Parameters
     ////////////////////////////////////////////////////////////////////////////////
 
     // Input will be resized to this number of lines to speed up the processing
-    //const int PROCESSING_VIDEO_HEIGHT_LIMIT = 640; // MOD webcam resolution
-    // Higher resolution will be better if EMILY is in the distance
-    //const int PROCESSING_VIDEO_HEIGHT_LIMIT = 1200;
-    const int PROCESSING_VIDEO_HEIGHT_LIMIT = 2160;
+    // (e.g., 640 for the MOD webcam). Higher resolution will be better if
+    // EMILY is in the distance.
+    int PROCESSING_VIDEO_HEIGHT_LIMIT = 2160;
+
+    // Number of frames decoded ahead on the background thread. Each buffer
+    // holds one full resolution frame (about 25 MB for 4K), so keep it small
+    // for high resolution sources.
+    int PREFETCH_QUEUE_DEPTH = 4;
+
+    // Memory budget of the recently decoded frames kept for instant stepping
+    // backward. A full resolution 4K frame takes about 25 MB.
+    int FRAME_CACHE_BUDGET_MB = 512;
+
+    // Keep copies downscaled to this height instead of the full resolution
+    // frames to fit more frames into the budget, 0 to keep full resolution
+    int FRAME_CACHE_DISPLAY_HEIGHT = 0;
+
+private:
+
+    // Setting that can be configured at run time
+    struct SettingField {
+        const char * name;
+        SettingType type;
+        void * value;
+        double minimum;
+        double maximum;
+        const char * const * names;
+    };
+
+    vector<SettingField> fields();
+
+    bool set_field(const SettingField&, string);
+
+    // Configuration file given on the command line or the default one
+    string configuration_file_name;
 
 };
 
@@ -0,0 +1,177 @@
+/* 
+ * File:   TemplateTracker.cpp
+ * Author: Jan Dufek
+ */
+
+#include "TemplateTracker.hpp"
+
+/**
+ * Creates a tracker following a labeled point by normalized cross-correlation
+ * of a small template within a bounded region around the last position. Only
+ * the region is cropped, downscaled and converted to grayscale, the full frame
+ * is never searched.
+ * 
+ * @param template_size size of the template in downscaled pixels
+ * @param search_size maximum movement between two frames in downscaled pixels
+ * @param search_scale scale of the downscaled images the search runs on
+ */
+TemplateTracker::TemplateTracker(int template_size, int search_size, double search_scale) {
+    template_radius = template_size / 2 > 0 ? template_size / 2 : 1;
+    search_radius = search_size > 0 ? search_size : 1;
+    scale = search_scale > 0 && search_scale <= 1 ? search_scale : 1;
+}
+
+TemplateTracker::TemplateTracker(const TemplateTracker& orig) {
+}
+
+TemplateTracker::~TemplateTracker() {
+}
+
+/**
+ * Crop the region around the center, downscale it and convert it to
+ * grayscale. The region is clipped at the frame borders.
+ * 
+ * @param frame full resolution frame
+ * @param center center of the region in original pixels
+ * @param radius half size of the region in downscaled pixels
+ * @param patch receives the grayscale downscaled region
+ * @param origin receives the top left corner of the region in original pixels
+ * @param patch_scale receives the exact scale of the patch
+ * @return false if the region is outside of the frame
+ */
+bool TemplateTracker::extract(const Mat& frame, Point2f center, int radius, Mat& patch, Point2f& origin, double& patch_scale) {
+
+    int original_radius = radius / scale + 0.5;
+
+    Rect region(center.x + 0.5 - original_radius, center.y + 0.5 - original_radius, 2 * original_radius + 1, 2 * original_radius + 1);
+    region &= Rect(0, 0, frame.cols, frame.rows);
+
+    if (region.width < 2 || region.height < 2) {
+        return false;
+    }
+
+    if (scale < 1) {
+        resize(frame(region), resized_patch, Size(region.width * scale + 0.5, region.height * scale + 0.5), 0, 0, INTER_AREA);
+    } else {
+        resized_patch = frame(region);
+    }
+
+    if (resized_patch.channels() == 3) {
+        cvtColor(resized_patch, patch, COLOR_BGR2GRAY);
+    } else {
+        resized_patch.copyTo(patch);
+    }
+
+    origin = Point2f(region.x, region.y);
+    patch_scale = (double) patch.cols / region.width;
+
+    return true;
+}
+
+/**
+ * Start tracking the point at the given position, e.g., after it was labeled
+ * manually.
+ * 
+ * @param frame full resolution frame
+ * @param point labeled position in original pixels
+ * @return false if there is not enough image around the point
+ */
+bool TemplateTracker::initialize(const Mat& frame, Point2f point) {
+
+    Point2f origin;
+    double patch_scale;
+
+    if (!extract(frame, point, template_radius, template_patch, origin, patch_scale)) {
+        template_patch.release();
+        return false;
+    }
+
+    // Templates clipped at the frame borders are not used
+    if (template_patch.cols < 2 * template_radius || template_patch.rows < 2 * template_radius) {
+        template_patch.release();
+        return false;
+    }
+
+    template_center = Point2f((point.x - origin.x) * patch_scale, (point.y - origin.y) * patch_scale);
+    position = point;
+
+    return true;
+}
+
+/**
+ * Find the tracked point in the next frame.
+ * 
+ * @param frame full resolution frame
+ * @param point receives the proposed position in original pixels
+ * @param confidence receives the normalized cross-correlation of the match
+ * @return false if the tracker is not initialized or the point left the frame
+ */
+bool TemplateTracker::track(const Mat& frame, Point2f& point, float& confidence) {
+
+    if (template_patch.empty()) {
+        return false;
+    }
+
+    Point2f origin;
+    double patch_scale;
+
+    if (!extract(frame, position, template_radius + search_radius, search_patch, origin, patch_scale)) {
+        return false;
+    }
+
+    if (search_patch.cols < template_patch.cols || search_patch.rows < template_patch.rows) {
+        return false;
+    }
+
+    matchTemplate(search_patch, template_patch, response, TM_CCOEFF_NORMED);
+
+    double maximum;
+    Point maximum_location;
+    minMaxLoc(response, NULL, &maximum, NULL, &maximum_location);
+
+    // Sub-pixel refinement by fitting a parabola through the neighbors
+    Point2f match(maximum_location.x, maximum_location.y);
+
+    if (maximum_location.x > 0 && maximum_location.x < response.cols - 1) {
+        float left = response.at<float>(maximum_location.y, maximum_location.x - 1);
+        float right = response.at<float>(maximum_location.y, maximum_location.x + 1);
+        float denominator = left - 2 * (float) maximum + right;
+        if (denominator < 0) {
+            match.x += 0.5f * (left - right) / denominator;
+        }
+    }
+
+    if (maximum_location.y > 0 && maximum_location.y < response.rows - 1) {
+        float top = response.at<float>(maximum_location.y - 1, maximum_location.x);
+        float bottom = response.at<float>(maximum_location.y + 1, maximum_location.x);
+        float denominator = top - 2 * (float) maximum + bottom;
+        if (denominator < 0) {
+            match.y += 0.5f * (top - bottom) / denominator;
+        }
+    }
+
+    // Map back to original pixels
+    position = Point2f(origin.x + (match.x + template_center.x) / patch_scale, origin.y + (match.y + template_center.y) / patch_scale);
+
+    point = position;
+    confidence = maximum;
+
+    return true;
+}
+
+/**
+ * Check whether a template is available for tracking.
+ * 
+ * @return true if the tracker can track
+ */
+bool TemplateTracker::is_initialized() {
+    return !template_patch.empty();
+}
+
+/**
+ * Stop tracking.
+ * 
+ */
+void TemplateTracker::reset() {
+    template_patch.release();
+}
@@ -0,0 +1,59 @@
+/* 
+ * File:   TemplateTracker.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TEMPLATETRACKER_HPP
+#define TEMPLATETRACKER_HPP
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+using namespace std;
+using namespace cv;
+
+class TemplateTracker {
+public:
+    TemplateTracker(int, int, double);
+    TemplateTracker(const TemplateTracker& orig);
+    virtual ~TemplateTracker();
+
+    bool initialize(const Mat&, Point2f);
+
+    bool track(const Mat&, Point2f&, float&);
+
+    bool is_initialized();
+
+    void reset();
+
+private:
+
+    bool extract(const Mat&, Point2f, int, Mat&, Point2f&, double&);
+
+    // Half size of the template in downscaled pixels
+    int template_radius;
+
+    // Maximum movement between two frames in downscaled pixels
+    int search_radius;
+
+    // Scale of the downscaled images the search runs on
+    double scale;
+
+    // Grayscale downscaled template
+    Mat template_patch;
+
+    // Position of the tracked point within the template in downscaled pixels
+    Point2f template_center;
+
+    // Last tracked position in original pixels
+    Point2f position;
+
+    // Buffers reused between frames
+    Mat search_patch;
+    Mat response;
+    Mat resized_patch;
+
+};
+
+#endif /* TEMPLATETRACKER_HPP */
+
@@ -0,0 +1,258 @@
+/*
+ * File:   TimingTrace.cpp
+ * Author: Jan Dufek
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include "TimingTrace.hpp"
+
+TimingTrace * TimingTrace::active = NULL;
+
+// Buffer of the calling thread and the trace it belongs to
+static thread_local TimingTrace * buffer_owner = NULL;
+static thread_local void * buffer_of_thread = NULL;
+
+/**
+ * Creates a trace with preallocated event buffers.
+ *
+ * @param events_per_thread number of events kept per thread, later events are
+ * counted as dropped
+ */
+TimingTrace::TimingTrace(int events_per_thread) {
+    capacity = events_per_thread;
+    start_time = now();
+}
+
+TimingTrace::TimingTrace(const TimingTrace& orig) {
+}
+
+TimingTrace::~TimingTrace() {
+
+    if (active == this) {
+        active = NULL;
+    }
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+        delete buffers[i];
+    }
+}
+
+/**
+ * Set the trace the scoped timers record into. Set before the timed threads
+ * start and cleared after they stop.
+ *
+ * @param trace trace or NULL to disable timing
+ */
+void TimingTrace::set_active(TimingTrace* trace) {
+    active = trace;
+}
+
+/**
+ * Get the time of the monotonic clock.
+ *
+ * @return nanoseconds
+ */
+int64_t TimingTrace::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Get the buffer of the calling thread, it is allocated on the first event of
+ * the thread.
+ *
+ * @return buffer
+ */
+TimingTrace::ThreadBuffer * TimingTrace::thread_buffer() {
+
+    if (buffer_owner == this) {
+        return (ThreadBuffer *) buffer_of_thread;
+    }
+
+    ThreadBuffer * buffer = new ThreadBuffer();
+    buffer->events.resize(capacity);
+    buffer->used = 0;
+    buffer->dropped = 0;
+
+    {
+        lock_guard<mutex> lock(buffers_mutex);
+
+        buffer->index = buffers.size() + 1;
+        buffers.push_back(buffer);
+    }
+
+    buffer_owner = this;
+    buffer_of_thread = buffer;
+
+    return buffer;
+}
+
+/**
+ * Record a timed section of the calling thread. It does not lock nor allocate
+ * after the first event of the thread.
+ *
+ * @param name name of the section
+ * @param start start in nanoseconds of the monotonic clock
+ * @param duration duration in nanoseconds
+ * @param frame frame the section belongs to, -1 if none
+ */
+void TimingTrace::record(const char* name, int64_t start, int64_t duration, long frame) {
+
+    ThreadBuffer * buffer = thread_buffer();
+
+    size_t used = buffer->used.load(memory_order_relaxed);
+
+    if (used == buffer->events.size()) {
+        buffer->dropped++;
+        return;
+    }
+
+    TimingEvent& event = buffer->events[used];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.frame = frame;
+
+    // Publish the event
+    buffer->used.store(used + 1, memory_order_release);
+}
+
+/**
+ * Name the calling thread in the exported trace.
+ *
+ * @param name thread name
+ */
+void TimingTrace::name_thread(const char* name) {
+    thread_buffer()->name = name;
+}
+
+/**
+ * Export the events in the Chrome trace event format, which can be opened in
+ * chrome://tracing or Perfetto.
+ *
+ * @param file_name output file
+ * @return false if the file cannot be written
+ */
+bool TimingTrace::write_trace(string file_name) {
+
+    FILE * file = fopen(file_name.c_str(), "w");
+
+    if (file == NULL) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(buffers_mutex);
+
+    fprintf(file, "{\"traceEvents\": [\n");
+
+    bool first = true;
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+
+        ThreadBuffer * buffer = buffers[i];
+
+        if (!buffer->name.empty()) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", buffer->index, buffer->name.c_str());
+            first = false;
+        }
+
+        size_t used = buffer->used.load(memory_order_acquire);
+
+        for (size_t j = 0; j < used; j++) {
+
+            const TimingEvent& event = buffer->events[j];
+
+            // Microseconds from the creation of the trace
+            fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %ld}}", first ? "" : ",\n", event.name, buffer->index, (event.start - start_time) / 1000.0, event.duration / 1000.0, event.frame);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+    return fclose(file) == 0;
+}
+
+/**
+ * Print the duration statistics of every section and save them with the
+ * frame counts.
+ *
+ * @param file_name output file
+ * @param frames number of frames labeled while recording
+ * @param late_frames frames labeled later than planned
+ * @param dropped_frames frames the decoder skipped while recording
+ * @return false if the file cannot be written
+ */
+bool TimingTrace::write_summary(string file_name, long frames, long late_frames, long dropped_frames) {
+
+    // Durations in milliseconds by section
+    map<string, vector<double> > durations;
+
+    {
+        lock_guard<mutex> lock(buffers_mutex);
+
+        for (size_t i = 0; i < buffers.size(); i++) {
+
+            size_t used = buffers[i]->used.load(memory_order_acquire);
+
+            for (size_t j = 0; j < used; j++) {
+                durations[buffers[i]->events[j].name].push_back(buffers[i]->events[j].duration / 1e6);
+            }
+        }
+    }
+
+    FILE * file = fopen(file_name.c_str(), "w");
+
+    if (file == NULL) {
+        return false;
+    }
+
+    char line[160];
+
+    snprintf(line, sizeof (line), "%-12s %8s %10s %10s %10s %10s\n", "section", "count", "mean_ms", "p50_ms", "p99_ms", "max_ms");
+    fputs(line, file);
+    cout << "Timing:" << endl << line;
+
+    for (map<string, vector<double> >::iterator it = durations.begin(); it != durations.end(); it++) {
+
+        vector<double>& sorted = it->second;
+        sort(sorted.begin(), sorted.end());
+
+        double sum = 0;
+
+        for (size_t i = 0; i < sorted.size(); i++) {
+            sum += sorted[i];
+        }
+
+        snprintf(line, sizeof (line), "%-12s %8zu %10.3f %10.3f %10.3f %10.3f\n", it->first.c_str(), sorted.size(), sum / sorted.size(), sorted[sorted.size() / 2], sorted[min(sorted.size() - 1, sorted.size() * 99 / 100)], sorted.back());
+        fputs(line, file);
+        cout << line;
+    }
+
+    // The frame counts are printed by the labeling loop
+    fprintf(file, "frames %ld, late %ld, dropped %ld, dropped events %ld\n", frames, late_frames, dropped_frames, get_dropped_events());
+
+    return fclose(file) == 0;
+}
+
+/**
+ * Get the number of events that did not fit into the buffers.
+ *
+ * @return number of dropped events
+ */
+long TimingTrace::get_dropped_events() {
+
+    lock_guard<mutex> lock(buffers_mutex);
+
+    long dropped = 0;
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+        dropped += buffers[i]->dropped;
+    }
+
+    return dropped;
+}
@@ -0,0 +1,120 @@
+/*
+ * File:   TimingTrace.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TIMINGTRACE_HPP
+#define TIMINGTRACE_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Timed section of one thread, times in nanoseconds of the monotonic clock
+struct TimingEvent {
+    const char * name;
+    int64_t start;
+    int64_t duration;
+    long frame;
+};
+
+class TimingTrace {
+public:
+    TimingTrace(int);
+    TimingTrace(const TimingTrace& orig);
+    virtual ~TimingTrace();
+
+    static void set_active(TimingTrace*);
+
+    /**
+     * Get the trace the timers record into.
+     *
+     * @return trace or NULL if timing is disabled
+     */
+    static TimingTrace * get_active() {
+        return active;
+    }
+
+    void record(const char*, int64_t, int64_t, long);
+
+    void name_thread(const char*);
+
+    bool write_trace(string);
+
+    bool write_summary(string, long, long, long);
+
+    long get_dropped_events();
+
+    static int64_t now();
+
+private:
+
+    // Preallocated events of one thread, only that thread writes them
+    struct ThreadBuffer {
+        vector<TimingEvent> events;
+        atomic<size_t> used;
+        atomic<long> dropped;
+        string name;
+        int index;
+    };
+
+    ThreadBuffer * thread_buffer();
+
+    // Trace the timers record into, NULL if timing is disabled
+    static TimingTrace * active;
+
+    // Events per thread
+    int capacity;
+
+    // Buffers of all threads that recorded an event
+    vector<ThreadBuffer*> buffers;
+
+    // Protects the list of buffers, taken once per thread
+    mutex buffers_mutex;
+
+    // Trace times are relative to the creation of the trace
+    int64_t start_time;
+
+};
+
+/**
+ * Times the enclosing scope into the active trace. If timing is disabled, it
+ * costs a single check.
+ */
+class ScopedTimer {
+public:
+
+    /**
+     * Start timing.
+     *
+     * @param section_name name of the timed section, it must outlive the trace
+     * @param frame frame the section belongs to, -1 if none
+     */
+    ScopedTimer(const char * section_name, long frame = -1) : trace(TimingTrace::get_active()) {
+        if (trace != NULL) {
+            name = section_name;
+            frame_number = frame;
+            start = TimingTrace::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (trace != NULL) {
+            trace->record(name, start, TimingTrace::now() - start, frame_number);
+        }
+    }
+
+private:
+
+    TimingTrace * trace;
+    const char * name;
+    long frame_number;
+    int64_t start;
+
+};
+
+#endif /* TIMINGTRACE_HPP */
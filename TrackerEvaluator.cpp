@@ -0,0 +1,411 @@
+/*
+ * File:   TrackerEvaluator.cpp
+ * Author: Jan Dufek
+ */
+
+#include <sys/stat.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "TrackerEvaluator.hpp"
+#include "LabelReader.hpp"
+
+/**
+ * Read a ground truth file into a table indexed by frame and object.
+ *
+ * @param file_name label file in the text or binary format
+ * @return table or NULL if the file cannot be read
+ */
+static LabelTable * load_ground_truth(const string& file_name) {
+
+    LabelReader reader(file_name);
+
+    if (!reader.is_open()) {
+        return NULL;
+    }
+
+    LabelTable * table = new LabelTable();
+
+    // Labels are streamed, a frame labeled twice keeps the last label
+    LabelRecord record;
+
+    while (reader.next(record)) {
+        table->put(record);
+    }
+
+    return table;
+}
+
+/**
+ * Loads the ground truth files in parallel.
+ */
+class GroundTruthLoader : public ParallelLoopBody {
+public:
+
+    GroundTruthLoader(vector<string>& f, vector<LabelTable*>& t) : file_names(f), tables(t) {
+    }
+
+    void operator()(const Range& range) const {
+        for (int i = range.start; i < range.end; i++) {
+            tables[i] = load_ground_truth(file_names[i]);
+        }
+    }
+
+private:
+
+    vector<string>& file_names;
+    vector<LabelTable*>& tables;
+
+};
+
+/**
+ * Evaluates the runs in parallel, each run is a separate task.
+ */
+class RunEvaluator : public ParallelLoopBody {
+public:
+
+    RunEvaluator(TrackerEvaluator& e, vector<EvaluationRun>& r) : evaluator(e), runs(r) {
+    }
+
+    void operator()(const Range& range) const {
+        for (int i = range.start; i < range.end; i++) {
+            evaluator.evaluate(runs[i], i);
+        }
+    }
+
+private:
+
+    TrackerEvaluator& evaluator;
+    vector<EvaluationRun>& runs;
+
+};
+
+/**
+ * Creates an evaluator scoring tracker output files against ground truth.
+ *
+ * @param directory output directory
+ * @param lost error in pixels above which the target is considered lost
+ * @param threshold largest threshold of the success curve in pixels
+ */
+TrackerEvaluator::TrackerEvaluator(string directory, double lost, int threshold) {
+    output_directory = directory;
+    lost_threshold = lost;
+    maximum_threshold = threshold;
+}
+
+TrackerEvaluator::TrackerEvaluator(const TrackerEvaluator& orig) {
+}
+
+TrackerEvaluator::~TrackerEvaluator() {
+    for (map<string, LabelTable*>::iterator it = ground_truths.begin(); it != ground_truths.end(); it++) {
+        delete it->second;
+    }
+}
+
+/**
+ * Add a tracker output to evaluate.
+ *
+ * @param ground_truth_file_name ground truth labels
+ * @param tracker_file_name positions reported by the tracker in the label
+ * format, frames the tracker did not report count as missed
+ */
+void TrackerEvaluator::add_run(string ground_truth_file_name, string tracker_file_name) {
+
+    EvaluationRun run;
+    run.ground_truth_file_name = ground_truth_file_name;
+    run.tracker_file_name = tracker_file_name;
+    run.valid = false;
+
+    runs.push_back(run);
+
+    ground_truths[ground_truth_file_name] = NULL;
+}
+
+/**
+ * Add the runs listed in a file, one "ground_truth tracker_output" pair per
+ * line. Empty lines and lines starting with # are skipped.
+ *
+ * @param list_file_name run list
+ * @return false if the list cannot be read
+ */
+bool TrackerEvaluator::add_runs(string list_file_name) {
+
+    ifstream list_file(list_file_name.c_str());
+
+    if (!list_file.is_open()) {
+        return false;
+    }
+
+    string line;
+
+    while (getline(list_file, line)) {
+
+        stringstream fields(line);
+
+        string ground_truth_file_name;
+        string tracker_file_name;
+
+        if (!(fields >> ground_truth_file_name) || ground_truth_file_name[0] == '#') {
+            continue;
+        }
+
+        if (!(fields >> tracker_file_name)) {
+            cout << "Missing tracker output for " << ground_truth_file_name << " in " << list_file_name << endl;
+            return false;
+        }
+
+        add_run(ground_truth_file_name, tracker_file_name);
+    }
+
+    return true;
+}
+
+/**
+ * Get a loaded ground truth.
+ *
+ * @param file_name ground truth file
+ * @return table or NULL if it could not be read
+ */
+LabelTable * TrackerEvaluator::get_ground_truth(const string& file_name) {
+
+    map<string, LabelTable*>::iterator found = ground_truths.find(file_name);
+
+    return found != ground_truths.end() ? found->second : NULL;
+}
+
+/**
+ * Evaluate all runs and write the results. The ground truth files are loaded
+ * first, then the tracker outputs are streamed and scored in parallel.
+ *
+ * @return false if a file could not be read or written
+ */
+bool TrackerEvaluator::run() {
+
+    mkdir(output_directory.c_str(), 0755);
+
+    int64 start_ticks = getTickCount();
+
+    // Load each ground truth once
+    vector<string> file_names;
+
+    for (map<string, LabelTable*>::iterator it = ground_truths.begin(); it != ground_truths.end(); it++) {
+        file_names.push_back(it->first);
+    }
+
+    vector<LabelTable*> tables(file_names.size(), (LabelTable*) NULL);
+
+    parallel_for_(Range(0, file_names.size()), GroundTruthLoader(file_names, tables), file_names.size());
+
+    for (size_t i = 0; i < file_names.size(); i++) {
+
+        ground_truths[file_names[i]] = tables[i];
+
+        if (tables[i] == NULL) {
+            cout << "Cannot read ground truth " << file_names[i] << endl;
+        }
+    }
+
+    // The ground truth is only read from here on
+    parallel_for_(Range(0, runs.size()), RunEvaluator(* this, runs), runs.size());
+
+    bool success = write_summary();
+
+    long valid_runs = 0;
+
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i].valid) {
+            valid_runs++;
+        } else {
+            cout << "Cannot evaluate " << runs[i].tracker_file_name << endl;
+            success = false;
+        }
+    }
+
+    cout << "Evaluated " << valid_runs << " of " << runs.size() << " runs in " << (getTickCount() - start_ticks) / getTickFrequency() << " s" << endl;
+
+    return success;
+}
+
+/**
+ * Score one tracker output. The tracker positions are streamed and matched to
+ * the ground truth label of the same frame and object. The per-frame errors
+ * are written to errors_<run>.txt, -1 for frames the tracker did not report.
+ *
+ * @param run run to evaluate
+ * @param index number of the run
+ */
+void TrackerEvaluator::evaluate(EvaluationRun& run, int index) {
+
+    run.valid = false;
+
+    LabelTable * truth = get_ground_truth(run.ground_truth_file_name);
+
+    if (truth == NULL) {
+        return;
+    }
+
+    LabelReader reader(run.tracker_file_name);
+
+    if (!reader.is_open()) {
+        return;
+    }
+
+    size_t rows = truth->size();
+
+    const int64_t * frame_numbers = truth->get_frame_numbers();
+    const uint32_t * object_ids = truth->get_object_ids();
+    const float * x = truth->get_x();
+    const float * y = truth->get_y();
+
+    // Error of each ground truth label, -1 if the tracker did not report it
+    vector<float> errors(rows, -1);
+
+    run.extra_frames = 0;
+
+    LabelRecord record;
+
+    while (reader.next(record)) {
+
+        int row = truth->find(record.frame_number, record.object_id);
+
+        if (row < 0) {
+            run.extra_frames++;
+            continue;
+        }
+
+        errors[row] = hypot(record.x - x[row], record.y - y[row]);
+    }
+
+    // Ground truth in frame order per object
+    vector<int> order(rows);
+
+    for (size_t i = 0; i < rows; i++) {
+        order[i] = i;
+    }
+
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        return object_ids[a] != object_ids[b] ? object_ids[a] < object_ids[b] : frame_numbers[a] < frame_numbers[b];
+    });
+
+    char file_name[32];
+    snprintf(file_name, sizeof (file_name), "/errors_%04d.txt", index);
+
+    FILE * errors_file = fopen((output_directory + file_name).c_str(), "w");
+
+    vector<float> matched_errors;
+    matched_errors.reserve(rows);
+
+    run.lost_segments.clear();
+
+    bool lost = false;
+
+    for (size_t i = 0; i < rows; i++) {
+
+        int row = order[i];
+
+        if (errors_file != NULL) {
+            fprintf(errors_file, "%lld %u %.3f\n", (long long) frame_numbers[row], object_ids[row], errors[row]);
+        }
+
+        if (errors[row] >= 0) {
+            matched_errors.push_back(errors[row]);
+        }
+
+        bool frame_lost = errors[row] < 0 || errors[row] > lost_threshold;
+
+        // Extend the segment of the same object or start a new one
+        if (frame_lost && lost && run.lost_segments.back().object_id == object_ids[row]) {
+            run.lost_segments.back().last_frame = frame_numbers[row];
+        } else if (frame_lost) {
+            LostSegment segment;
+            segment.object_id = object_ids[row];
+            segment.first_frame = frame_numbers[row];
+            segment.last_frame = frame_numbers[row];
+            run.lost_segments.push_back(segment);
+        }
+
+        lost = frame_lost;
+    }
+
+    if (errors_file != NULL) {
+        fclose(errors_file);
+    }
+
+    run.ground_truth_frames = rows;
+    run.matched_frames = matched_errors.size();
+    run.missed_frames = rows - matched_errors.size();
+
+    sort(matched_errors.begin(), matched_errors.end());
+
+    double sum = 0;
+
+    for (size_t i = 0; i < matched_errors.size(); i++) {
+        sum += matched_errors[i];
+    }
+
+    run.mean_error = matched_errors.empty() ? 0 : sum / matched_errors.size();
+    run.median_error = matched_errors.empty() ? 0 : matched_errors[matched_errors.size() / 2];
+
+    // Missed frames count as failures at every threshold
+    run.success_rates.resize(maximum_threshold + 1);
+    run.success_area = 0;
+
+    size_t within = 0;
+
+    for (int threshold = 0; threshold <= maximum_threshold; threshold++) {
+
+        while (within < matched_errors.size() && matched_errors[within] <= threshold) {
+            within++;
+        }
+
+        run.success_rates[threshold] = rows > 0 ? (double) within / rows : 0;
+        run.success_area += run.success_rates[threshold] / (maximum_threshold + 1);
+    }
+
+    run.valid = true;
+}
+
+/**
+ * Write the summary of all runs: evaluation.txt with one line per run,
+ * success.txt with the success curves and lost.txt with the lost segments.
+ *
+ * @return false if the files cannot be written
+ */
+bool TrackerEvaluator::write_summary() {
+
+    ofstream summary_file((output_directory + "/evaluation.txt").c_str());
+    ofstream success_file((output_directory + "/success.txt").c_str());
+    ofstream lost_file((output_directory + "/lost.txt").c_str());
+
+    summary_file << "# run ground_truth tracker_output frames matched missed extra mean_error median_error success_area lost_segments" << endl;
+    success_file << "# run success rate at 0.." << maximum_threshold << " pixels" << endl;
+    lost_file << "# run object first_frame last_frame" << endl;
+
+    for (size_t i = 0; i < runs.size(); i++) {
+
+        const EvaluationRun& run = runs[i];
+
+        if (!run.valid) {
+            continue;
+        }
+
+        summary_file << i << " " << run.ground_truth_file_name << " " << run.tracker_file_name << " " << run.ground_truth_frames << " " << run.matched_frames << " " << run.missed_frames << " " << run.extra_frames << " " << run.mean_error << " " << run.median_error << " " << run.success_area << " " << run.lost_segments.size() << endl;
+
+        success_file << i;
+
+        for (size_t j = 0; j < run.success_rates.size(); j++) {
+            success_file << " " << run.success_rates[j];
+        }
+
+        success_file << endl;
+
+        for (size_t j = 0; j < run.lost_segments.size(); j++) {
+            lost_file << i << " " << run.lost_segments[j].object_id << " " << run.lost_segments[j].first_frame << " " << run.lost_segments[j].last_frame << endl;
+        }
+    }
+
+    return summary_file.good() && success_file.good() && lost_file.good();
+}
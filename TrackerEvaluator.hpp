@@ -0,0 +1,90 @@
+/*
+ * File:   TrackerEvaluator.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TRACKEREVALUATOR_HPP
+#define TRACKEREVALUATOR_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "LabelTable.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Frames of one object in which the tracker lost the target
+struct LostSegment {
+    uint32_t object_id;
+    long first_frame;
+    long last_frame;
+};
+
+// Tracker output scored against its ground truth
+struct EvaluationRun {
+    string ground_truth_file_name;
+    string tracker_file_name;
+
+    // The files were read
+    bool valid;
+
+    // Labeled frames, ground truth frames with a tracker position, ground
+    // truth frames without one and tracker positions without ground truth
+    long ground_truth_frames;
+    long matched_frames;
+    long missed_frames;
+    long extra_frames;
+
+    // Error statistics in pixels over the matched frames
+    double mean_error;
+    double median_error;
+
+    // Fraction of the ground truth frames tracked within each threshold
+    vector<double> success_rates;
+
+    // Area under the success curve, normalized to 0..1
+    double success_area;
+
+    vector<LostSegment> lost_segments;
+};
+
+class TrackerEvaluator {
+public:
+    TrackerEvaluator(string, double, int);
+    TrackerEvaluator(const TrackerEvaluator& orig);
+    virtual ~TrackerEvaluator();
+
+    void add_run(string, string);
+
+    bool add_runs(string);
+
+    bool run();
+
+    void evaluate(EvaluationRun&, int);
+
+private:
+
+    LabelTable * get_ground_truth(const string&);
+
+    bool write_summary();
+
+    // Directory the results are written to
+    string output_directory;
+
+    // Ground truth frames with a larger error count as lost
+    double lost_threshold;
+
+    // The success curve is sampled at every pixel up to this threshold
+    int maximum_threshold;
+
+    // Runs to evaluate
+    vector<EvaluationRun> runs;
+
+    // Ground truth files, each loaded once and shared by its runs
+    map<string, LabelTable*> ground_truths;
+
+};
+
+#endif /* TRACKEREVALUATOR_HPP */
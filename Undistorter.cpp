@@ -0,0 +1,255 @@
+/* 
+ * File:   Undistorter.cpp
+ * Author: Jan Dufek
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <iostream>
+#include "opencv2/calib3d.hpp"
+#include "Undistorter.hpp"
+
+// Identifies undistortion map files and their version
+static const char MAP_MAGIC[8] = {'G', 'T', 'L', 'U', 'N', 'D', '0', '1'};
+
+/**
+ * Creates an undistorter for the given camera calibration.
+ * 
+ * @param camera_intrinsic_matrix 3x3 camera matrix
+ * @param camera_distortion_vector distortion coefficients
+ * @param calibration_frame_size frame size the calibration was computed for
+ * @param map_cache_directory directory the remap tables are cached in
+ */
+Undistorter::Undistorter(const Mat& camera_intrinsic_matrix, const Mat& camera_distortion_vector, Size calibration_frame_size, string map_cache_directory) {
+
+    camera_intrinsic_matrix.convertTo(calibration_camera_matrix, CV_64F);
+    camera_distortion_vector.convertTo(distortion, CV_64F);
+
+    calibration_size = calibration_frame_size;
+
+    cache_directory = map_cache_directory;
+}
+
+Undistorter::Undistorter(const Undistorter& orig) {
+}
+
+Undistorter::~Undistorter() {
+}
+
+/**
+ * Prepare undistortion of frames of the given size. The calibration is scaled
+ * to the frame size. The remap tables are loaded from the cache or computed
+ * once and cached.
+ * 
+ * @param size frame size
+ * @param build_maps false if only points are undistorted
+ * @return false if the maps could not be prepared
+ */
+bool Undistorter::prepare(Size size, bool build_maps) {
+
+    frame_size = size;
+
+    // Scale the focal lengths and the principal point
+    double scale_x = (double) size.width / calibration_size.width;
+    double scale_y = (double) size.height / calibration_size.height;
+
+    camera_matrix = calibration_camera_matrix.clone();
+    camera_matrix.at<double>(0, 0) *= scale_x;
+    camera_matrix.at<double>(0, 2) *= scale_x;
+    camera_matrix.at<double>(1, 1) *= scale_y;
+    camera_matrix.at<double>(1, 2) *= scale_y;
+
+    map_coordinates.release();
+    map_weights.release();
+
+    if (!build_maps) {
+        return true;
+    }
+
+    if (load()) {
+        return true;
+    }
+
+    // Keep the camera matrix so that labels stay in the scale of the frame
+    initUndistortRectifyMap(camera_matrix, distortion, Mat(), camera_matrix, frame_size, CV_16SC2, map_coordinates, map_weights);
+
+    if (!save()) {
+        cerr << "Cannot cache undistortion maps in " << get_cache_file_name() << endl;
+    }
+
+    return !map_coordinates.empty();
+}
+
+/**
+ * Check whether the remap tables are ready.
+ * 
+ * @return true if frames can be undistorted
+ */
+bool Undistorter::is_prepared() {
+    return !map_coordinates.empty();
+}
+
+/**
+ * Undistort a frame with the precomputed tables. The fixed-point remap is a
+ * single lookup pass and OpenCV splits it into stripes over all cores.
+ * 
+ * @param frame distorted frame of the prepared size
+ * @param undistorted_frame output, its buffer is reused
+ */
+void Undistorter::undistort_frame(const Mat& frame, Mat& undistorted_frame) {
+    remap(frame, undistorted_frame, map_coordinates, map_weights, INTER_LINEAR, BORDER_CONSTANT);
+}
+
+/**
+ * Undistort a single position.
+ * 
+ * @param position position in distorted frame pixels
+ * @return position in undistorted frame pixels
+ */
+Point2f Undistorter::undistort_point(Point2f position) {
+
+    vector<Point2f> distorted(1, position);
+    vector<Point2f> undistorted;
+
+    undistortPoints(distorted, undistorted, camera_matrix, distortion, noArray(), camera_matrix);
+
+    return undistorted[0];
+}
+
+/**
+ * Distort a single position, the inverse of undistort_point.
+ * 
+ * @param position position in undistorted frame pixels
+ * @return position in distorted frame pixels
+ */
+Point2f Undistorter::distort_point(Point2f position) {
+
+    // Ray through the undistorted position, projected through the lens
+    double x = (position.x - camera_matrix.at<double>(0, 2)) / camera_matrix.at<double>(0, 0);
+    double y = (position.y - camera_matrix.at<double>(1, 2)) / camera_matrix.at<double>(1, 1);
+
+    vector<Point3f> rays(1, Point3f(x, y, 1));
+    vector<Point2f> distorted;
+
+    projectPoints(rays, Mat::zeros(3, 1, CV_64F), Mat::zeros(3, 1, CV_64F), camera_matrix, distortion, distorted);
+
+    return distorted[0];
+}
+
+/**
+ * Hash of the scaled calibration and the frame size identifying the cached
+ * maps (FNV-1a).
+ * 
+ * @return hash
+ */
+uint64_t Undistorter::calibration_hash() {
+
+    uint64_t hash = 14695981039346656037ULL;
+
+    // Both matrices are continuous after the conversion
+    vector<double> values;
+    values.insert(values.end(), camera_matrix.ptr<double>(), camera_matrix.ptr<double>() + camera_matrix.total());
+    values.insert(values.end(), distortion.ptr<double>(), distortion.ptr<double>() + distortion.total());
+    values.push_back(frame_size.width);
+    values.push_back(frame_size.height);
+
+    const unsigned char * bytes = (const unsigned char *) &values[0];
+
+    for (size_t i = 0; i < values.size() * sizeof (double); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Get the name of the file the maps are cached in. It is keyed by the
+ * calibration and the frame size.
+ * 
+ * @return cache file name
+ */
+string Undistorter::get_cache_file_name() {
+
+    char name[64];
+    snprintf(name, sizeof (name), "undistort_%016llx_%dx%d.map", (unsigned long long) calibration_hash(), frame_size.width, frame_size.height);
+
+    return cache_directory + "/" + name;
+}
+
+/**
+ * Load the cached maps.
+ * 
+ * @return true if the maps were loaded
+ */
+bool Undistorter::load() {
+
+    ifstream map_file(get_cache_file_name().c_str(), ios::binary);
+
+    if (!map_file.is_open()) {
+        return false;
+    }
+
+    char magic[8];
+    uint64_t cached_hash;
+    int32_t cached_width, cached_height;
+
+    map_file.read(magic, sizeof (magic));
+    map_file.read((char *) &cached_hash, sizeof (cached_hash));
+    map_file.read((char *) &cached_width, sizeof (cached_width));
+    map_file.read((char *) &cached_height, sizeof (cached_height));
+
+    if (!map_file || memcmp(magic, MAP_MAGIC, sizeof (magic)) != 0) {
+        return false;
+    }
+
+    // Maps of a different calibration or frame size
+    if (cached_hash != calibration_hash() || cached_width != frame_size.width || cached_height != frame_size.height) {
+        return false;
+    }
+
+    Mat coordinates(frame_size, CV_16SC2);
+    Mat weights(frame_size, CV_16UC1);
+
+    map_file.read((char *) coordinates.data, coordinates.total() * coordinates.elemSize());
+    map_file.read((char *) weights.data, weights.total() * weights.elemSize());
+
+    if (!map_file) {
+        return false;
+    }
+
+    map_coordinates = coordinates;
+    map_weights = weights;
+
+    return true;
+}
+
+/**
+ * Save the maps to the cache.
+ * 
+ * @return true if the maps were saved
+ */
+bool Undistorter::save() {
+
+    ofstream map_file(get_cache_file_name().c_str(), ios::binary | ios::trunc);
+
+    if (!map_file.is_open()) {
+        return false;
+    }
+
+    uint64_t hash = calibration_hash();
+    int32_t width = frame_size.width;
+    int32_t height = frame_size.height;
+
+    map_file.write(MAP_MAGIC, sizeof (MAP_MAGIC));
+    map_file.write((const char *) &hash, sizeof (hash));
+    map_file.write((const char *) &width, sizeof (width));
+    map_file.write((const char *) &height, sizeof (height));
+
+    // Maps created by initUndistortRectifyMap are continuous
+    map_file.write((const char *) map_coordinates.data, map_coordinates.total() * map_coordinates.elemSize());
+    map_file.write((const char *) map_weights.data, map_weights.total() * map_weights.elemSize());
+
+    return (bool) map_file;
+}
@@ -0,0 +1,64 @@
+/* 
+ * File:   Undistorter.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef UNDISTORTER_HPP
+#define UNDISTORTER_HPP
+
+#include <stdint.h>
+#include <string>
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "SettingTypes.hpp"
+
+using namespace std;
+using namespace cv;
+
+class Undistorter {
+public:
+    Undistorter(const Mat&, const Mat&, Size, string);
+    Undistorter(const Undistorter& orig);
+    virtual ~Undistorter();
+
+    bool prepare(Size, bool);
+
+    bool is_prepared();
+
+    void undistort_frame(const Mat&, Mat&);
+
+    Point2f undistort_point(Point2f);
+
+    Point2f distort_point(Point2f);
+
+    string get_cache_file_name();
+
+private:
+
+    uint64_t calibration_hash();
+
+    bool load();
+
+    bool save();
+
+    // Calibration as measured for the calibration frame size
+    Mat calibration_camera_matrix;
+    Mat distortion;
+    Size calibration_size;
+
+    // Camera matrix scaled to the frame size
+    Mat camera_matrix;
+
+    // Size of the undistorted frames
+    Size frame_size;
+
+    // Directory the maps are cached in
+    string cache_directory;
+
+    // Fixed-point remap tables, integer coordinates and interpolation weights
+    Mat map_coordinates;
+    Mat map_weights;
+
+};
+
+#endif /* UNDISTORTER_HPP */
@@ -3,6 +3,7 @@
  * Author: Jan Dufek
  */
 
+#include <cmath>
 #include "UserInterface.hpp"
 
 // Program settings
@@ -10,11 +11,39 @@ Settings * UserInterface::settings;
 
 Size UserInterface::video_size;
 
-UserInterface::UserInterface(Settings& s, Size sz) {
+DisplayPipeline * UserInterface::display_pipeline;
+
+void (*UserInterface::redraw_handler)() = NULL;
+
+CursorSampler * UserInterface::cursor_sampler = NULL;
+
+Point UserInterface::drag_start(-1, -1);
+Point UserInterface::pan_start(-1, -1);
+
+// Colors of the objects after the first one, which uses LOCATION_COLOR
+static const Scalar OBJECT_COLORS[] = {
+    Scalar(0, 0, 255), Scalar(255, 0, 0), Scalar(0, 255, 255), Scalar(255, 0, 255),
+    Scalar(255, 255, 255), Scalar(0, 128, 255), Scalar(255, 128, 0), Scalar(128, 0, 255),
+    Scalar(128, 255, 0)
+};
+
+int UserInterface::frame_trackbar_position = 0;
+
+bool UserInterface::frame_trackbar_created = false;
+
+UserInterface::UserInterface(Settings& s, DisplayPipeline& d, bool create_window) {
 
     UserInterface::settings = &s;
 
-    UserInterface::video_size = sz;
+    UserInterface::display_pipeline = &d;
+
+    // Frames are shown in display resolution
+    UserInterface::video_size = d.get_display_size();
+
+    // Drawing works without a window, e.g., in the pipeline benchmark
+    if (!create_window) {
+        return;
+    }
 
     // Show main window including slide bars
     create_main_window();
@@ -38,8 +67,9 @@ UserInterface::~UserInterface() {
  */
 void UserInterface::create_main_window() {
 
-    // Show new window
-    namedWindow(UserInterface::settings->MAIN_WINDOW, CV_GUI_NORMAL);
+    // Show new window. The frames are shown unscaled, zoom and pan are done
+    // by the display pipeline, so the Qt backend must not zoom on its own.
+    namedWindow(UserInterface::settings->MAIN_WINDOW, WINDOW_AUTOSIZE | CV_GUI_NORMAL);
 
 }
 
@@ -52,9 +82,59 @@ void UserInterface::onMouse(int event, int x, int y, int flags, void*) {
     // Check mouse button
     switch (event) {
 
-        // Right drag is reserved for moving over the image
         // Left click context menu is disabled
-        // Scrool is reserved for zoom
+
+        // Scroll zooms around the cursor
+        case EVENT_MOUSEWHEEL:
+
+            UserInterface::display_pipeline->zoom_at(Point2f(x, y), getMouseWheelDelta(flags) > 0 ? UserInterface::settings->DISPLAY_ZOOM_STEP : 1 / UserInterface::settings->DISPLAY_ZOOM_STEP);
+
+            if (UserInterface::redraw_handler != NULL) {
+                UserInterface::redraw_handler();
+            }
+
+            break;
+
+        // Right drag moves the zoomed image
+        case EVENT_RBUTTONDOWN:
+
+            UserInterface::pan_start = Point(x, y);
+
+            break;
+
+        case EVENT_RBUTTONUP:
+
+            UserInterface::pan_start = Point(-1, -1);
+
+            break;
+
+        // Left drag with shift sets the box size of the selected object
+        case EVENT_LBUTTONDOWN:
+
+            if (flags & EVENT_FLAG_SHIFTKEY) {
+                UserInterface::drag_start = Point(x, y);
+            }
+
+            break;
+
+        case EVENT_LBUTTONUP:
+
+            // Clicks, including the ones of a double click, keep the box
+            if (UserInterface::drag_start.x >= 0 && (abs(x - UserInterface::drag_start.x) >= UserInterface::settings->MINIMUM_BOX_DRAG || abs(y - UserInterface::drag_start.y) >= UserInterface::settings->MINIMUM_BOX_DRAG)) {
+
+                Point2f corner_1 = UserInterface::display_pipeline->to_source(Point2f(UserInterface::drag_start.x, UserInterface::drag_start.y));
+                Point2f corner_2 = UserInterface::display_pipeline->to_source(Point2f(x, y));
+
+                object_box_sizes[active_object] = Size2f(fabs(corner_2.x - corner_1.x), fabs(corner_2.y - corner_1.y));
+
+                if (UserInterface::redraw_handler != NULL) {
+                    UserInterface::redraw_handler();
+                }
+            }
+
+            UserInterface::drag_start = Point(-1, -1);
+
+            break;
 
         // Left double click to start/stop recording
         case EVENT_LBUTTONDBLCLK:
@@ -69,60 +149,277 @@ void UserInterface::onMouse(int event, int x, int y, int flags, void*) {
                 status = 1;
             }
 
+            // Show the new status right away
+            if (UserInterface::redraw_handler != NULL) {
+                UserInterface::redraw_handler();
+            }
+
             break;
 
         // Change of cursor
         case EVENT_MOUSEMOVE:
 
-            // Get mouse location
-            cursor_position = Point(x, y);
+            if (UserInterface::pan_start.x >= 0 && (flags & EVENT_FLAG_RBUTTON)) {
+                UserInterface::display_pipeline->pan(Point2f(x - UserInterface::pan_start.x, y - UserInterface::pan_start.y));
+                UserInterface::pan_start = Point(x, y);
+            }
+
+            // Get mouse location in original pixel coordinates
+            cursor_position = UserInterface::display_pipeline->to_source(Point2f(x, y));
+
+            // Keep every position, not only the one at the time of the label
+            if (UserInterface::cursor_sampler != NULL) {
+                UserInterface::cursor_sampler->push(cursor_position.x, cursor_position.y);
+            }
+
+            // The cursor was moved, e.g., to correct the tracker proposal
+            cursor_moved = true;
 
             // Print mouse location
             //cout << int_to_string(mouse_location.x) + " " + int_to_string(mouse_location.y) << endl;
 
+            // Draw the cursor right away instead of at the next frame
+            if (UserInterface::redraw_handler != NULL) {
+                UserInterface::redraw_handler();
+            }
+
             break;
     }
 }
 
+/**
+ * Frame slider handler. Requests a jump to the selected frame.
+ * 
+ */
+void UserInterface::onFrameTrackbar(int position, void*) {
+
+    // Ignore the updates made while playing
+    if (position != frame_number) {
+        requested_frame_number = position;
+    }
+}
+
+/**
+ * Creates the frame slider used to jump to any frame.
+ * 
+ * @param frame_count number of frames in the video
+ */
+void UserInterface::create_frame_trackbar(long frame_count) {
+    createTrackbar(UserInterface::settings->FRAME_TRACKBAR, UserInterface::settings->MAIN_WINDOW, &frame_trackbar_position, frame_count - 1, onFrameTrackbar);
+    frame_trackbar_created = true;
+}
+
+/**
+ * Moves the frame slider to the current frame.
+ * 
+ * @param frame_number current frame
+ */
+void UserInterface::set_frame_trackbar_position(long frame_number) {
+    if (!frame_trackbar_created) {
+        return;
+    }
+    setTrackbarPos(UserInterface::settings->FRAME_TRACKBAR, UserInterface::settings->MAIN_WINDOW, frame_number);
+}
+
+/**
+ * Sets the function called from the mouse handler when the overlay has to be
+ * redrawn.
+ * 
+ * @param handler redraw function
+ */
+void UserInterface::set_redraw_handler(void (*handler)()) {
+    UserInterface::redraw_handler = handler;
+}
+
+/**
+ * Sets the sampler receiving every cursor move.
+ * 
+ * @param sampler cursor sampler
+ */
+void UserInterface::set_cursor_sampler(CursorSampler* sampler) {
+    UserInterface::cursor_sampler = sampler;
+}
+
 /**
  * Draws position of the object as crosshairs with the center in the object's
- * centroid.
+ * centroid and its box if it has one.
  * 
- * @param x x coordinate
- * @param y y coordinate
+ * @param source_x x coordinate in original pixels
+ * @param source_y y coordinate in original pixels
+ * @param box box size in original pixels, empty for a point
+ * @param object_id labeled object
  * @param radius radius of crosshairs
- * @param frame frame to which draw into
+ * @param frame frame in display resolution to which draw into
+ * @return bounding box of the drawing
  */
-void UserInterface::draw_position(int x, int y, double radius, Mat &frame) {
+Rect UserInterface::draw_position(float source_x, float source_y, Size2f box, uint32_t object_id, double radius, Mat &frame) {
+
+    Scalar color = object_color(object_id);
+
+    // Position in the shown frame
+    Point2f display_position = UserInterface::display_pipeline->to_display(Point2f(source_x, source_y));
+
+    int x = cvRound(display_position.x);
+    int y = cvRound(display_position.y);
 
     // Lines
     if (y - radius > 0) {
-        line(frame, Point(x, y), Point(x, y - radius), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(x, y - radius), color, UserInterface::settings->LOCATION_THICKNESS);
     } else {
-        line(frame, Point(x, y), Point(x, 0), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(x, 0), color, UserInterface::settings->LOCATION_THICKNESS);
     }
 
     if (y + radius < UserInterface::video_size.height) {
-        line(frame, Point(x, y), Point(x, y + radius), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(x, y + radius), color, UserInterface::settings->LOCATION_THICKNESS);
     } else {
-        line(frame, Point(x, y), Point(x, UserInterface::video_size.height), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(x, UserInterface::video_size.height), color, UserInterface::settings->LOCATION_THICKNESS);
     }
 
     if (x - radius > 0) {
-        line(frame, Point(x, y), Point(x - radius, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(x - radius, y), color, UserInterface::settings->LOCATION_THICKNESS);
     } else {
-        line(frame, Point(x, y), Point(0, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(0, y), color, UserInterface::settings->LOCATION_THICKNESS);
     }
 
     if (x + radius < UserInterface::video_size.width) {
-        line(frame, Point(x, y), Point(x + radius, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(x + radius, y), color, UserInterface::settings->LOCATION_THICKNESS);
     } else {
-        line(frame, Point(x, y), Point(UserInterface::video_size.width, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+        line(frame, Point(x, y), Point(UserInterface::video_size.width, y), color, UserInterface::settings->LOCATION_THICKNESS);
+    }
+
+    // Text coordinates in original pixels, other objects than the first one
+    // are marked with their key
+    string text = "[" + int_to_string(cvRound(source_x)) + "," + int_to_string(cvRound(source_y)) + "]";
+
+    if (object_id > 0 && object_id < UserInterface::settings->OBJECT_KEYS.size()) {
+        text += string(" ") + UserInterface::settings->OBJECT_KEYS[object_id];
+    }
+
+    putText(frame, text, Point(x, y + radius + 20), 1, 1, color, 1, 8);
+
+    // Lines including their thickness
+    int margin = cvCeil(radius) + UserInterface::settings->LOCATION_THICKNESS + 1;
+    Rect bounds(Point(x - margin, y - margin), Point(x + margin + 1, y + margin + 1));
+
+    bounds |= text_bounds(text, Point(x, y + radius + 20), 1, 1, 1);
+
+    if (box.area() > 0) {
+        bounds |= draw_box(Point2f(source_x, source_y), box, color, frame);
+    }
+
+    return bounds;
+}
+
+/**
+ * Draws a recorded label of an object as a small cross, its box if it has one
+ * and the key of the object.
+ * 
+ * @param source_x x coordinate in original pixels
+ * @param source_y y coordinate in original pixels
+ * @param width box width in original pixels, 0 for a point
+ * @param height box height in original pixels, 0 for a point
+ * @param object_id labeled object
+ * @param frame frame in display resolution to which draw into
+ * @return bounding box of the drawing
+ */
+Rect UserInterface::draw_label(float source_x, float source_y, float width, float height, uint32_t object_id, Mat& frame) {
+
+    Scalar color = object_color(object_id);
+
+    Point2f display_position = UserInterface::display_pipeline->to_display(Point2f(source_x, source_y));
+
+    Point center(cvRound(display_position.x), cvRound(display_position.y));
+
+    int radius = 4;
+
+    line(frame, Point(center.x - radius, center.y - radius), Point(center.x + radius, center.y + radius), color, UserInterface::settings->LOCATION_THICKNESS);
+    line(frame, Point(center.x - radius, center.y + radius), Point(center.x + radius, center.y - radius), color, UserInterface::settings->LOCATION_THICKNESS);
+
+    int margin = radius + UserInterface::settings->LOCATION_THICKNESS + 1;
+    Rect bounds(Point(center.x - margin, center.y - margin), Point(center.x + margin + 1, center.y + margin + 1));
+
+    if (object_id < UserInterface::settings->OBJECT_KEYS.size()) {
+
+        string text(1, UserInterface::settings->OBJECT_KEYS[object_id]);
+
+        putText(frame, text, Point(center.x + 6, center.y - 6), 1, 1, color, 1, 8);
+
+        bounds |= text_bounds(text, Point(center.x + 6, center.y - 6), 1, 1, 1);
+    }
+
+    if (width > 0 && height > 0) {
+        bounds |= draw_box(Point2f(source_x, source_y), Size2f(width, height), color, frame);
+    }
+
+    return bounds;
+}
+
+/**
+ * Draws a box centered at a position.
+ * 
+ * @param center center in original pixels
+ * @param box box size in original pixels
+ * @param color color
+ * @param frame frame in display resolution to which draw into
+ * @return bounding box of the drawing
+ */
+Rect UserInterface::draw_box(Point2f center, Size2f box, const Scalar& color, Mat& frame) {
+
+    Point2f top_left = UserInterface::display_pipeline->to_display(Point2f(center.x - box.width / 2, center.y - box.height / 2));
+    Point2f bottom_right = UserInterface::display_pipeline->to_display(Point2f(center.x + box.width / 2, center.y + box.height / 2));
+
+    Point corner_1(cvRound(top_left.x), cvRound(top_left.y));
+    Point corner_2(cvRound(bottom_right.x), cvRound(bottom_right.y));
+
+    rectangle(frame, corner_1, corner_2, color, UserInterface::settings->LOCATION_THICKNESS);
+
+    int margin = UserInterface::settings->LOCATION_THICKNESS + 1;
+
+    return Rect(Point(corner_1.x - margin, corner_1.y - margin), Point(corner_2.x + margin + 1, corner_2.y + margin + 1));
+}
+
+/**
+ * Get the color of an object.
+ * 
+ * @param object_id object
+ * @return color
+ */
+Scalar UserInterface::object_color(uint32_t object_id) {
+
+    if (object_id == 0) {
+        return UserInterface::settings->LOCATION_COLOR;
     }
 
-    // Text coordinates
-    putText(frame, "[" + int_to_string(x) + "," + int_to_string(y) + "]", Point(x, y + radius + 20), 1, 1, UserInterface::settings->LOCATION_COLOR, 1, 8);
+    return OBJECT_COLORS[(object_id - 1) % (sizeof (OBJECT_COLORS) / sizeof (OBJECT_COLORS[0]))];
+}
 
+/**
+ * Draws the position proposed by the tracker as a circle with the confidence
+ * of the match.
+ * 
+ * @param position proposed position in original pixels
+ * @param confidence confidence of the proposal
+ * @param frame frame in display resolution to which draw into
+ * @return bounding box of the drawing
+ */
+Rect UserInterface::draw_proposal(Point2f position, float confidence, Mat &frame) {
+
+    Point2f display_position = UserInterface::display_pipeline->to_display(position);
+
+    Point center(cvRound(display_position.x), cvRound(display_position.y));
+
+    circle(frame, center, 6, UserInterface::settings->TRACKER_COLOR, UserInterface::settings->LOCATION_THICKNESS);
+
+    stringstream text;
+    text.precision(2);
+    text << fixed << confidence;
+
+    putText(frame, text.str(), Point(center.x + 10, center.y - 10), 1, 1, UserInterface::settings->TRACKER_COLOR, 1, 8);
+
+    int margin = 6 + UserInterface::settings->LOCATION_THICKNESS + 1;
+    Rect bounds(Point(center.x - margin, center.y - margin), Point(center.x + margin + 1, center.y + margin + 1));
+
+    return bounds | text_bounds(text.str(), Point(center.x + 10, center.y - 10), 1, 1, 1);
 }
 
 /**
@@ -130,9 +427,9 @@ void UserInterface::draw_position(int x, int y, double radius, Mat &frame) {
  * 
  * @param frame
  * @param status
- * @param time_to_target
+ * @return bounding box of the text
  */
-void UserInterface::print_status(Mat& frame, int status) {
+Rect UserInterface::print_status(Mat& frame, int status) {
 
     String stringStatus;
 
@@ -151,6 +448,7 @@ void UserInterface::print_status(Mat& frame, int status) {
     // Print status
     putText(frame, stringStatus, Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
 
+    return text_bounds(stringStatus, Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, 2);
 }
 
 /**
@@ -165,6 +463,25 @@ string UserInterface::int_to_string(int number) {
     return stringStream.str();
 }
 
+/**
+ * Get the region a text drawn by putText covers.
+ * 
+ * @param text text
+ * @param origin bottom-left corner of the text
+ * @param font font face
+ * @param scale font scale
+ * @param thickness line thickness
+ * @return bounding box of the text
+ */
+Rect UserInterface::text_bounds(const String& text, Point origin, int font, double scale, int thickness) {
+
+    int baseline = 0;
+    Size size = getTextSize(text, font, scale, thickness, &baseline);
+
+    // Strokes reach over the nominal box by their thickness
+    return Rect(origin.x - thickness - 1, origin.y - size.height - thickness - 1, size.width + 2 * thickness + 2, size.height + baseline + 2 * thickness + 2);
+}
+
 /**
  * Show main window.
  * 
@@ -8,39 +8,89 @@
 
 #include "opencv2/opencv.hpp"
 #include "Settings.hpp"
+#include "DisplayPipeline.hpp"
+#include "CursorSampler.hpp"
 
 using namespace std;
 using namespace cv;
 
-extern Point cursor_position;
+extern Point2f cursor_position;
 extern int status;
+extern long frame_number;
+extern long requested_frame_number;
+extern bool cursor_moved;
+extern int active_object;
+extern vector<Size2f> object_box_sizes;
 
 class UserInterface {
 public:
 
-    UserInterface(Settings&, Size);
+    UserInterface(Settings&, DisplayPipeline&, bool = true);
     UserInterface(const UserInterface& orig);
     virtual ~UserInterface();
     
-    void draw_position(int, int, double, Mat&);
+    Rect draw_position(float, float, Size2f, uint32_t, double, Mat&);
+
+    Rect draw_label(float, float, float, float, uint32_t, Mat&);
     
-    void print_status(Mat&, int);
+    Rect draw_proposal(Point2f, float, Mat&);
+
+    Rect print_status(Mat&, int);
     
     void show_main(Mat&);
+
+    void create_frame_trackbar(long);
+
+    void set_frame_trackbar_position(long);
+
+    void set_redraw_handler(void (*)());
+
+    void set_cursor_sampler(CursorSampler*);
     
 private:
     
     void create_main_window();
     
     static void onMouse(int, int, int, int, void*);
+
+    static void onFrameTrackbar(int, void*);
     
     string int_to_string(int);
+
+    Rect text_bounds(const String&, Point, int, double, int);
+
+    Scalar object_color(uint32_t);
+
+    Rect draw_box(Point2f, Size2f, const Scalar&, Mat&);
     
     // Program settings
     static Settings * settings;
     
     static Size video_size;
 
+    // Maps between display and original pixel coordinates
+    static DisplayPipeline * display_pipeline;
+
+    // Called when the overlay has to be redrawn
+    static void (*redraw_handler)();
+
+    // Records every cursor move, NULL if not used
+    static CursorSampler * cursor_sampler;
+
+    // Display position where the left button was pressed, x is -1 if it is
+    // not pressed
+    static Point drag_start;
+
+    // Display position where the image was last moved with the right button,
+    // x is -1 if it is not pressed
+    static Point pan_start;
+
+    // Frame slider position
+    static int frame_trackbar_position;
+
+    // Frame slider was created
+    static bool frame_trackbar_created;
+
 };
 
 #endif /* USERINTERFACE_HPP */
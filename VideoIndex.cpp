@@ -0,0 +1,678 @@
+/* 
+ * File:   VideoIndex.cpp
+ * Author: Jan Dufek
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <algorithm>
+#include "VideoIndex.hpp"
+
+// Identifies index files and their version
+static const char INDEX_MAGIC[8] = {'G', 'T', 'L', 'I', 'D', 'X', '0', '2'};
+
+// Key frame flag of AVI index entries
+static const uint32_t AVI_KEY_FRAME = 0x10;
+
+/**
+ * Read a big endian integer of the given number of bytes.
+ * 
+ * @param file input file
+ * @param bytes 4 or 8
+ * @return value, 0 if it could not be read
+ */
+static uint64_t read_big_endian(ifstream& file, int bytes) {
+
+    unsigned char buffer[8];
+
+    if (!file.read((char *) buffer, bytes)) {
+        return 0;
+    }
+
+    uint64_t value = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | buffer[i];
+    }
+
+    return value;
+}
+
+/**
+ * Read a little endian integer of the given number of bytes.
+ * 
+ * @param file input file
+ * @param bytes 4 or 8
+ * @return value, 0 if it could not be read
+ */
+static uint64_t read_little_endian(ifstream& file, int bytes) {
+
+    unsigned char buffer[8];
+
+    if (!file.read((char *) buffer, bytes)) {
+        return 0;
+    }
+
+    uint64_t value = 0;
+
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+
+    return value;
+}
+
+/**
+ * Find the first box of the given type in an MP4 file between the given
+ * offsets.
+ * 
+ * @param file MP4 file
+ * @param start offset of the first box
+ * @param end end of the parent box
+ * @param type four character box type
+ * @param payload receives the offset of the box content
+ * @param box_end receives the end of the box
+ * @return false if there is no such box
+ */
+static bool find_mp4_box(ifstream& file, int64_t start, int64_t end, const char* type, int64_t& payload, int64_t& box_end) {
+
+    int64_t position = start;
+
+    while (position + 8 <= end) {
+
+        file.clear();
+        file.seekg(position);
+
+        int64_t size = read_big_endian(file, 4);
+
+        char box_type[4];
+        if (!file.read(box_type, 4)) {
+            return false;
+        }
+
+        int64_t header = 8;
+
+        if (size == 1) {
+
+            // 64-bit size follows the type
+            size = read_big_endian(file, 8);
+            header = 16;
+
+        } else if (size == 0) {
+
+            // Box extends to the end of its parent
+            size = end - position;
+
+        }
+
+        if (size < header || position + size > end) {
+            return false;
+        }
+
+        if (memcmp(box_type, type, 4) == 0) {
+            payload = position + header;
+            box_end = position + size;
+            return true;
+        }
+
+        position += size;
+    }
+
+    return false;
+}
+
+/**
+ * Creates an index for the given video file.
+ * 
+ * @param file_name video file
+ */
+VideoIndex::VideoIndex(string file_name) : ready(false) {
+
+    video_file_name = file_name;
+
+    video_file_size = 0;
+    video_file_time = 0;
+
+    frame_count = 0;
+}
+
+VideoIndex::VideoIndex(const VideoIndex& orig) : ready(false) {
+}
+
+VideoIndex::~VideoIndex() {
+    if (builder.joinable()) {
+        builder.join();
+    }
+}
+
+/**
+ * Get the name of the file the index is cached in. It is stored next to the
+ * video.
+ * 
+ * @return index file name
+ */
+string VideoIndex::get_index_file_name() {
+    return video_file_name + ".index";
+}
+
+/**
+ * Read size and modification time of the video file.
+ * 
+ * @param size file size in bytes
+ * @param time modification time
+ * @return false if the source is not a file (e.g., a stream)
+ */
+bool VideoIndex::read_video_file_status(int64_t& size, int64_t& time) {
+
+    struct stat file_status;
+
+    if (stat(video_file_name.c_str(), &file_status) != 0 || !S_ISREG(file_status.st_mode)) {
+        return false;
+    }
+
+    size = file_status.st_size;
+    time = file_status.st_mtime;
+
+    return true;
+}
+
+/**
+ * Load the cached index right away or read it from the container on a
+ * background thread. The index is used for seeking once it is valid, until
+ * then the backend seeks by itself.
+ * 
+ */
+void VideoIndex::start() {
+
+    if (load()) {
+        ready = true;
+        return;
+    }
+
+    if (!builder.joinable()) {
+        builder = thread(&VideoIndex::run, this);
+    }
+}
+
+/**
+ * Background thread reading the index from the container and caching it.
+ * 
+ */
+void VideoIndex::run() {
+
+    if (!build()) {
+        return;
+    }
+
+    ready = true;
+
+    if (!save()) {
+        cout << "Cannot save video index " << get_index_file_name() << endl;
+    }
+}
+
+/**
+ * Load the cached index. The cache is only used if it was built for the same
+ * video file size and modification time.
+ * 
+ * @return true if the index was loaded
+ */
+bool VideoIndex::load() {
+
+    int64_t size, time;
+
+    if (!read_video_file_status(size, time)) {
+        return false;
+    }
+
+    ifstream index_file(get_index_file_name().c_str(), ios::binary);
+
+    if (!index_file.is_open()) {
+        return false;
+    }
+
+    char magic[8];
+    int64_t cached_size, cached_time, cached_frame_count, cached_seek_point_count;
+
+    index_file.read(magic, sizeof (magic));
+    index_file.read((char *) &cached_size, sizeof (cached_size));
+    index_file.read((char *) &cached_time, sizeof (cached_time));
+    index_file.read((char *) &cached_frame_count, sizeof (cached_frame_count));
+    index_file.read((char *) &cached_seek_point_count, sizeof (cached_seek_point_count));
+
+    if (!index_file || memcmp(magic, INDEX_MAGIC, sizeof (magic)) != 0) {
+        return false;
+    }
+
+    // Stale index
+    if (cached_size != size || cached_time != time || cached_seek_point_count < 0) {
+        return false;
+    }
+
+    vector<SeekPoint> cached_seek_points(cached_seek_point_count);
+
+    if (cached_seek_point_count > 0) {
+        index_file.read((char *) &cached_seek_points[0], cached_seek_point_count * sizeof (SeekPoint));
+    }
+
+    if (!index_file) {
+        return false;
+    }
+
+    video_file_size = cached_size;
+    video_file_time = cached_time;
+    frame_count = cached_frame_count;
+    seek_points.swap(cached_seek_points);
+
+    return true;
+}
+
+/**
+ * Build the index from the sample tables of the container. Nothing is
+ * decoded, so it takes about as long as reading the file header.
+ * 
+ * @return false if the container is not supported or has no index
+ */
+bool VideoIndex::build() {
+
+    if (!read_video_file_status(video_file_size, video_file_time)) {
+        return false;
+    }
+
+    ifstream video_file(video_file_name.c_str(), ios::binary);
+
+    if (!video_file.is_open()) {
+        return false;
+    }
+
+    char header[12];
+
+    if (!video_file.read(header, sizeof (header))) {
+        return false;
+    }
+
+    seek_points.clear();
+    frame_count = 0;
+
+    bool built;
+
+    if (memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "AVI ", 4) == 0) {
+        built = read_avi(video_file, video_file_size);
+    } else {
+        built = read_mp4(video_file, video_file_size);
+    }
+
+    return built && !seek_points.empty();
+}
+
+/**
+ * Read the key frames of the first video track of an MP4 or QuickTime file.
+ * Fragmented files without sample tables are not supported.
+ * 
+ * @param file video file
+ * @param size file size
+ * @return true if a video track was found
+ */
+bool VideoIndex::read_mp4(ifstream& file, int64_t size) {
+
+    int64_t moov, moov_end;
+
+    if (!find_mp4_box(file, 0, size, "moov", moov, moov_end)) {
+        return false;
+    }
+
+    int64_t position = moov;
+    int64_t trak, trak_end;
+
+    while (find_mp4_box(file, position, moov_end, "trak", trak, trak_end)) {
+
+        if (read_mp4_track(file, trak, trak_end)) {
+            return true;
+        }
+
+        position = trak_end;
+    }
+
+    return false;
+}
+
+/**
+ * Read the key frames of an MP4 track if it is a video track. Key frames are
+ * listed in decode order, which matches the display order at key frames of
+ * closed groups of pictures.
+ * 
+ * @param file video file
+ * @param start content of the trak box
+ * @param end end of the trak box
+ * @return false if it is not a video track or its tables are broken
+ */
+bool VideoIndex::read_mp4_track(ifstream& file, int64_t start, int64_t end) {
+
+    int64_t mdia, mdia_end, box, box_end;
+
+    if (!find_mp4_box(file, start, end, "mdia", mdia, mdia_end)) {
+        return false;
+    }
+
+    // Handler type follows version, flags and a predefined field
+    if (!find_mp4_box(file, mdia, mdia_end, "hdlr", box, box_end)) {
+        return false;
+    }
+
+    file.clear();
+    file.seekg(box + 8);
+
+    char handler[4];
+
+    if (!file.read(handler, 4) || memcmp(handler, "vide", 4) != 0) {
+        return false;
+    }
+
+    // Time scale of the track
+    if (!find_mp4_box(file, mdia, mdia_end, "mdhd", box, box_end)) {
+        return false;
+    }
+
+    file.clear();
+    file.seekg(box);
+
+    int version = read_big_endian(file, 4) >> 24;
+
+    file.seekg(version == 1 ? 16 : 8, ios::cur);
+
+    double time_scale = read_big_endian(file, 4);
+
+    if (time_scale <= 0) {
+        return false;
+    }
+
+    // Sample tables
+    int64_t minf, minf_end, stbl, stbl_end;
+
+    if (!find_mp4_box(file, mdia, mdia_end, "minf", minf, minf_end) || !find_mp4_box(file, minf, minf_end, "stbl", stbl, stbl_end)) {
+        return false;
+    }
+
+    // Number of samples
+    if (!find_mp4_box(file, stbl, stbl_end, "stsz", box, box_end)) {
+        return false;
+    }
+
+    file.clear();
+    file.seekg(box + 8);
+
+    long samples = read_big_endian(file, 4);
+
+    // Sample durations as runs of equal durations
+    if (!find_mp4_box(file, stbl, stbl_end, "stts", box, box_end)) {
+        return false;
+    }
+
+    file.clear();
+    file.seekg(box + 4);
+
+    long runs = read_big_endian(file, 4);
+
+    if (runs < 0 || box + 8 + runs * 8 > box_end) {
+        return false;
+    }
+
+    vector<uint32_t> run_counts(runs);
+    vector<uint32_t> run_durations(runs);
+
+    for (long i = 0; i < runs; i++) {
+        run_counts[i] = read_big_endian(file, 4);
+        run_durations[i] = read_big_endian(file, 4);
+    }
+
+    // Sync samples, 1-based. Without the table every sample is a key frame.
+    vector<uint32_t> key_samples;
+
+    if (find_mp4_box(file, stbl, stbl_end, "stss", box, box_end)) {
+
+        file.clear();
+        file.seekg(box + 4);
+
+        long keys = read_big_endian(file, 4);
+
+        if (keys < 0 || box + 8 + keys * 4 > box_end) {
+            return false;
+        }
+
+        key_samples.resize(keys);
+
+        for (long i = 0; i < keys; i++) {
+            key_samples[i] = read_big_endian(file, 4);
+        }
+
+    } else {
+
+        key_samples.resize(samples);
+
+        for (long i = 0; i < samples; i++) {
+            key_samples[i] = i + 1;
+        }
+
+    }
+
+    if (!file) {
+        return false;
+    }
+
+    // Walk the durations to the decode time of each key frame
+    long run = 0;
+    long run_start = 0;
+    int64_t run_time = 0;
+
+    for (size_t i = 0; i < key_samples.size(); i++) {
+
+        long sample = (long) key_samples[i] - 1;
+
+        if (sample < 0 || sample >= samples) {
+            continue;
+        }
+
+        while (run < runs && sample >= run_start + (long) run_counts[run]) {
+            run_time += (int64_t) run_counts[run] * run_durations[run];
+            run_start += run_counts[run];
+            run++;
+        }
+
+        int64_t duration = run < runs ? run_durations[run] : 0;
+
+        SeekPoint seek_point;
+        seek_point.frame_number = sample;
+        seek_point.timestamp = (run_time + (sample - run_start) * duration) * 1000.0 / time_scale;
+
+        seek_points.push_back(seek_point);
+    }
+
+    frame_count = samples;
+
+    return !seek_points.empty();
+}
+
+/**
+ * Read the key frames of the first video stream of an AVI file from its idx1
+ * index. OpenDML files without idx1 are not supported.
+ * 
+ * @param file video file
+ * @param size file size
+ * @return true if the index was found
+ */
+bool VideoIndex::read_avi(ifstream& file, int64_t size) {
+
+    double frame_duration = 0;
+
+    // Chunks of the RIFF list, each padded to an even size
+    int64_t position = 12;
+
+    while (position + 8 <= size) {
+
+        file.clear();
+        file.seekg(position);
+
+        char id[4];
+        file.read(id, 4);
+
+        int64_t chunk_size = read_little_endian(file, 4);
+
+        if (!file) {
+            return false;
+        }
+
+        if (memcmp(id, "LIST", 4) == 0) {
+
+            char list_type[4];
+            file.read(list_type, 4);
+
+            // The main header starts with the frame duration in microseconds
+            if (memcmp(list_type, "hdrl", 4) == 0) {
+
+                char header_id[4];
+                file.read(header_id, 4);
+                file.seekg(4, ios::cur);
+
+                if (memcmp(header_id, "avih", 4) == 0) {
+                    frame_duration = read_little_endian(file, 4) / 1000.0;
+                }
+            }
+
+        } else if (memcmp(id, "idx1", 4) == 0) {
+
+            // Entries of chunk id, flags, offset and size
+            long entries = chunk_size / 16;
+
+            char video_stream[2] = {0, 0};
+
+            for (long i = 0; i < entries; i++) {
+
+                char chunk_id[4];
+                file.read(chunk_id, 4);
+
+                uint32_t flags = read_little_endian(file, 4);
+
+                file.seekg(8, ios::cur);
+
+                if (!file) {
+                    return false;
+                }
+
+                // Compressed or uncompressed video of the first video stream
+                bool video = (chunk_id[2] == 'd' && (chunk_id[3] == 'c' || chunk_id[3] == 'b'));
+
+                if (!video) {
+                    continue;
+                }
+
+                if (video_stream[0] == 0) {
+                    video_stream[0] = chunk_id[0];
+                    video_stream[1] = chunk_id[1];
+                } else if (chunk_id[0] != video_stream[0] || chunk_id[1] != video_stream[1]) {
+                    continue;
+                }
+
+                if (flags & AVI_KEY_FRAME) {
+
+                    SeekPoint seek_point;
+                    seek_point.frame_number = frame_count;
+                    seek_point.timestamp = frame_count * frame_duration;
+
+                    seek_points.push_back(seek_point);
+                }
+
+                frame_count++;
+            }
+
+            return true;
+        }
+
+        position += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+/**
+ * Save the index next to the video.
+ * 
+ * @return true if the index was saved
+ */
+bool VideoIndex::save() {
+
+    ofstream index_file(get_index_file_name().c_str(), ios::binary | ios::trunc);
+
+    if (!index_file.is_open()) {
+        return false;
+    }
+
+    int64_t saved_frame_count = frame_count;
+    int64_t saved_seek_point_count = seek_points.size();
+
+    index_file.write(INDEX_MAGIC, sizeof (INDEX_MAGIC));
+    index_file.write((const char *) &video_file_size, sizeof (video_file_size));
+    index_file.write((const char *) &video_file_time, sizeof (video_file_time));
+    index_file.write((const char *) &saved_frame_count, sizeof (saved_frame_count));
+    index_file.write((const char *) &saved_seek_point_count, sizeof (saved_seek_point_count));
+
+    if (!seek_points.empty()) {
+        index_file.write((const char *) &seek_points[0], seek_points.size() * sizeof (SeekPoint));
+    }
+
+    return (bool) index_file;
+}
+
+/**
+ * Check whether the index is complete and contains any seek points. Can be
+ * called from any thread.
+ * 
+ * @return true if the index can be used for seeking
+ */
+bool VideoIndex::is_valid() {
+    return ready && !seek_points.empty();
+}
+
+/**
+ * Check whether the indexed source is a regular file that can be read.
+ * 
+ * @return false for streams and cameras
+ */
+bool VideoIndex::is_file() {
+    int64_t size, time;
+    return read_video_file_status(size, time);
+}
+
+/**
+ * Get the number of frames in the video.
+ * 
+ * @return frame count
+ */
+long VideoIndex::get_frame_count() {
+    return frame_count;
+}
+
+/**
+ * Get the last key frame at or before the given frame. The index has to be
+ * valid.
+ * 
+ * @param frame_number target frame
+ * @return seek point
+ */
+SeekPoint VideoIndex::get_seek_point(long frame_number) {
+
+    SeekPoint target;
+    target.frame_number = frame_number;
+    target.timestamp = 0;
+
+    // First key frame after the target
+    vector<SeekPoint>::iterator next = upper_bound(seek_points.begin(), seek_points.end(), target, [](const SeekPoint& a, const SeekPoint& b) {
+        return a.frame_number < b.frame_number;
+    });
+
+    if (next == seek_points.begin()) {
+        return seek_points.front();
+    }
+
+    return * (next - 1);
+}
@@ -0,0 +1,89 @@
+/* 
+ * File:   VideoIndex.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef VIDEOINDEX_HPP
+#define VIDEOINDEX_HPP
+
+#include <fstream>
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Key frame the decoder can be positioned to directly
+struct SeekPoint {
+    int64_t frame_number;
+    double timestamp;
+};
+
+/**
+ * Key frames of a video file read from the sample tables of the container,
+ * without decoding. Supports MP4 and QuickTime files (stss, stts and stsz
+ * boxes of the video track) and AVI files with an idx1 index. The index is
+ * read on a background thread and cached next to the video.
+ */
+class VideoIndex {
+public:
+    VideoIndex(string);
+    VideoIndex(const VideoIndex& orig);
+    virtual ~VideoIndex();
+
+    void start();
+
+    bool load();
+
+    bool build();
+
+    bool save();
+
+    bool is_valid();
+
+    bool is_file();
+
+    long get_frame_count();
+
+    SeekPoint get_seek_point(long);
+
+    string get_index_file_name();
+
+private:
+
+    void run();
+
+    bool read_mp4(ifstream&, int64_t);
+
+    bool read_mp4_track(ifstream&, int64_t, int64_t);
+
+    bool read_avi(ifstream&, int64_t);
+
+    bool read_video_file_status(int64_t&, int64_t&);
+
+    // Indexed video file
+    string video_file_name;
+
+    // Size and modification time of the video when the index was built
+    int64_t video_file_size;
+    int64_t video_file_time;
+
+    // Number of frames in the video
+    long frame_count;
+
+    // Key frames ordered by frame number
+    vector<SeekPoint> seek_points;
+
+    // The index was loaded or built, set after the seek points are complete
+    atomic<bool> ready;
+
+    // Reads the index from the container
+    thread builder;
+
+};
+
+#endif /* VIDEOINDEX_HPP */
+
@@ -17,10 +17,31 @@
 #include <stdio.h>
 #include <time.h>
 #include <iostream>
+#include <algorithm>
 #include "opencv2/opencv.hpp"
 #include "Settings.hpp"
-#include "Logger.hpp"
+#include "LabelWriter.hpp"
 #include "UserInterface.hpp"
+#include "FramePrefetcher.hpp"
+#include "VideoIndex.hpp"
+#include "FrameCache.hpp"
+#include "BatchProcessor.hpp"
+#include "LabelInterpolator.hpp"
+#include "TemplateTracker.hpp"
+#include "DisplayPipeline.hpp"
+#include "OverlayLayer.hpp"
+#include "SessionJournal.hpp"
+#include "LabelReader.hpp"
+#include "LabelStore.hpp"
+#include "LabelTable.hpp"
+#include "TimingTrace.hpp"
+#include "DecoderSelector.hpp"
+#include "TrackerEvaluator.hpp"
+#include "LabelMerger.hpp"
+#include "CaptureRing.hpp"
+#include "AnnotationPacer.hpp"
+#include "CursorSampler.hpp"
+#include "Undistorter.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 // TODOs
@@ -37,19 +58,24 @@ using namespace std;
 // Settings
 ////////////////////////////////////////////////////////////////////////////////
 
-Settings * settings = new Settings();
+// Configured in main from the configuration file and the command line
+Settings * settings = NULL;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Video Capture
 ////////////////////////////////////////////////////////////////////////////////
 
-VideoCapture video_capture = VideoCapture(settings->video_capture_source);
+// Created in main so that the batch mode does not open the configured source
+VideoCapture * video_capture = NULL;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Global variables
 ////////////////////////////////////////////////////////////////////////////////
 
-// New resized size of video used in processing
+// Original size of input video
+Size input_video_size;
+
+// New resized size of video used in processing and display
 Size resized_video_size;
 
 // Indicates that resizing is necessary
@@ -58,11 +84,24 @@ bool resize_video = false;
 // Original frame
 Mat original_frame;
 
+// A new frame was loaded and the shown frame has to be rebuilt
+bool frame_changed = false;
+
+// Buffer exchanged with the prefetch queue
+Mat decoded_frame;
+
+// Downscaled grayscale signature of the current frame computed by the
+// prefetcher, empty for frames taken from the cache
+Mat frame_signature;
+
 // EMILY location
 Point emily_location;
 
-// Cursor location
-Point cursor_position;
+// Cursor location in original pixel coordinates
+Point2f cursor_position;
+
+// The cursor was moved since the current frame was shown
+bool cursor_moved = false;
 
 // Status of the algorithm
 int status = 0;
@@ -70,24 +109,83 @@ int status = 0;
 // Frame number
 long frame_number = -1;
 
+// Frame to jump to while paused, -1 if none
+long requested_frame_number = -1;
+
+// Decodes frames ahead of the labeling loop
+FramePrefetcher * frame_prefetcher;
+
+// Recently decoded frames
+FrameCache * frame_cache;
+
+// Removes the lens distortion from frames or labels, NULL if not used
+Undistorter * undistorter = NULL;
+
+// Labels recorded in this session by run of consecutively labeled frames,
+// interpolated at the end in keyframe mode
+vector<vector<LabelRecord> > session_runs(1);
+
+// Labels indexed by frame for lookups and corrections, NULL if not used
+LabelStore * label_store = NULL;
+
+// Builds the shown frames in display resolution
+DisplayPipeline * display_pipeline;
+
+// Graphical user interface
+UserInterface * user_interface;
+
+// Cursor and texts drawn over the shown frame
+OverlayLayer * overlay_layer;
+
+// Records every cursor move between two labels
+CursorSampler * cursor_sampler;
+
+// Adapts the time for annotation, NULL if it is fixed
+AnnotationPacer * annotation_pacer = NULL;
+
+// Labels of this session by frame and object, drawn over the labeled frames
+LabelTable frame_labels;
+
+// Object labeled now and the box size of every object, empty for points
+int active_object = 0;
+vector<Size2f> object_box_sizes;
+
+// Tracker proposal for the current frame
+bool label_tracked = false;
+Point2f tracked_position;
+float tracked_confidence = 0;
+
+// Overlay state of the frame shown last
+Point2f shown_cursor_position(-1, -1);
+int shown_status = -1;
+bool shown_label_tracked = false;
+Point2f shown_tracked_position;
+float shown_tracked_confidence = 0;
+int shown_active_object = -1;
+Size2f shown_box_size;
+size_t shown_label_count = 0;
+
 /**
  * Get the resolution of the input video feed.
  */
 void get_input_video_size() {
 
-    Size input_video_size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+    input_video_size = Size(video_capture->get(CV_CAP_PROP_FRAME_WIDTH), video_capture->get(CV_CAP_PROP_FRAME_HEIGHT));
+
+    // Frames are also shown at most in display resolution
+    int video_height_limit = min(settings->PROCESSING_VIDEO_HEIGHT_LIMIT, settings->DISPLAY_VIDEO_HEIGHT_LIMIT);
 
     // If the input video exceeds processing video size limits, we will have to resize it
-    if (input_video_size.height > settings->PROCESSING_VIDEO_HEIGHT_LIMIT) {
+    if (input_video_size.height > video_height_limit) {
 
         // Compute scale ratio
-        double ratio = (double) settings->PROCESSING_VIDEO_HEIGHT_LIMIT / input_video_size.height;
+        double ratio = (double) video_height_limit / input_video_size.height;
 
         // Compute new width
-        int new_video_width = input_video_size.width * ratio;
+        int new_video_width = input_video_size.width * ratio + 0.5;
 
         // Set new size
-        resized_video_size.height = settings->PROCESSING_VIDEO_HEIGHT_LIMIT;
+        resized_video_size.height = video_height_limit;
         resized_video_size.width = new_video_width;
 
         // Indicate that resizing is necessary
@@ -106,41 +204,607 @@ void get_input_video_size() {
 }
 
 /**
- * Create one log entry with current system status.
+ * End the run of consecutively labeled frames, e.g., at a pause or a jump.
+ * Frames are only interpolated between keyframes of the same run.
  * 
- * @param logger
- * @param current_commands
  */
-void create_log_entry(Logger* logger) {
+void end_label_run() {
+    if (!session_runs.back().empty()) {
+        session_runs.push_back(vector<LabelRecord>());
+    }
+}
 
-    // Get current time
-    time_t raw_time;
-    time(&raw_time);
-    struct tm * local_time;
-    local_time = localtime(&raw_time);
-    char current_time[40];
-    strftime(current_time, 40, "%Y%m%d%H%M%S", local_time);
+/**
+ * Load the given frame as the original frame. Frames are taken from the
+ * prefetch queue when they are next in it, revisited frames from the cache,
+ * and otherwise the decoder is positioned to the frame.
+ * 
+ * @param number frame to load
+ * @return false if the frame does not exist
+ */
+bool load_frame(long number) {
+
+    ScopedTimer read_timer("read", number);
+
+    if (number < 0) {
+        return false;
+    }
+
+    // Jumps end the run, frames are interpolated only between keyframes one
+    // step apart
+    if (number != frame_number + settings->KEYFRAME_INTERVAL) {
+        end_label_run();
+    }
+
+    if (frame_prefetcher->get_next_frame_number() != number) {
+
+        // The decoded frame shown last is cached only once it is returned
+        frame_prefetcher->return_frame(decoded_frame);
+
+        // Revisited frames do not touch the decoder
+        if (frame_cache->get(number, original_frame)) {
+            frame_number = number;
+            frame_changed = true;
+            frame_signature.release();
+            return true;
+        }
+
+        frame_prefetcher->seek(number);
+    }
+
+    long decoded_frame_number;
+
+    if (!frame_prefetcher->next_frame(decoded_frame, decoded_frame_number, &frame_signature)) {
+        return false;
+    }
+
+    original_frame = decoded_frame;
+    frame_number = decoded_frame_number;
+    frame_changed = true;
+
+    return true;
+}
+
+/**
+ * Show the current frame with the cursor, the tracker proposal and the status
+ * drawn over it. Nothing is drawn nor shown if neither the frame nor the
+ * overlay changed. Called by the labeling loop and by the mouse handler, so
+ * that cursor moves are drawn right away.
+ * 
+ */
+void show_frame() {
+
+    // Nothing to show before the first frame is loaded
+    if (original_frame.empty()) {
+        return;
+    }
+
+    // Redraw only if anything drawn over the frame changed
+    bool overlay_changed = cursor_position != shown_cursor_position || status != shown_status || label_tracked != shown_label_tracked || (label_tracked && (tracked_position != shown_tracked_position || tracked_confidence != shown_tracked_confidence));
+
+    overlay_changed = overlay_changed || active_object != shown_active_object || object_box_sizes[active_object] != shown_box_size || frame_labels.size() != shown_label_count;
+
+    // Render the shown region of the new frame in display resolution
+    if (frame_changed) {
+
+        ScopedTimer preprocess_timer("preprocess", frame_number);
+
+        display_pipeline->build(original_frame);
+
+        // Single full copy per new frame
+        overlay_layer->set_base(display_pipeline->get_display());
+
+        frame_changed = false;
+
+        overlay_changed = true;
+
+    } else if (display_pipeline->is_view_changed()) {
+
+        ScopedTimer preprocess_timer("preprocess", frame_number);
+
+        // Zoomed or moved, the same frame is rendered again
+        display_pipeline->render();
+
+        overlay_layer->set_base(display_pipeline->get_display());
+
+        overlay_changed = true;
+
+    }
+
+    if (!overlay_changed) {
+        return;
+    }
+
+    {
+        ScopedTimer overlay_timer("overlay", frame_number);
+
+        // Remove the previous overlay from the frame in display resolution
+        Mat& output = overlay_layer->restore();
+
+        // Visualize the labels of the objects in this frame
+        for (int row = frame_labels.first_in_frame(frame_number); row >= 0; row = frame_labels.next_in_frame(row)) {
+            overlay_layer->mark(user_interface->draw_label(frame_labels.get_x()[row], frame_labels.get_y()[row], frame_labels.get_width()[row], frame_labels.get_height()[row], frame_labels.get_object_ids()[row], output));
+        }
+
+        // Visualize cursor location
+        overlay_layer->mark(user_interface->draw_position(cursor_position.x, cursor_position.y, object_box_sizes[active_object], active_object, 10, output));
+
+        // Visualize tracker proposal
+        if (label_tracked) {
+            overlay_layer->mark(user_interface->draw_proposal(tracked_position, tracked_confidence, output));
+        }
+
+        // Get status as a string message
+        overlay_layer->mark(user_interface->print_status(output, status));
+    }
+
+    // Show output frame in the main window
+    {
+        ScopedTimer show_timer("show", frame_number);
+
+        user_interface->show_main(overlay_layer->get_canvas());
+    }
+
+    shown_cursor_position = cursor_position;
+    shown_status = status;
+    shown_label_tracked = label_tracked;
+    shown_tracked_position = tracked_position;
+    shown_tracked_confidence = tracked_confidence;
+    shown_active_object = active_object;
+    shown_box_size = object_box_sizes[active_object];
+    shown_label_count = frame_labels.size();
+
+}
+
+/**
+ * Select the labeled object or clear its box. Handled while recording, so
+ * that the labeled object can be switched without pausing.
+ * 
+ * @param key pressed key
+ * @return true if the key was handled
+ */
+bool handle_object_key(int key) {
+
+    if (key < 0 || key > 255) {
+        return false;
+    }
+
+    if (key == settings->KEY_CLEAR_BOX) {
+
+        object_box_sizes[active_object] = Size2f();
+
+        return true;
+    }
+
+    size_t object = settings->OBJECT_KEYS.find((char) key);
+
+    if (object == string::npos) {
+        return false;
+    }
+
+    // Proposals of the tracker belong to the previous object
+    if ((int) object != active_object) {
+        active_object = object;
+        label_tracked = false;
+    }
+
+    return true;
+}
+
+/**
+ * Zoom around the cursor or show the whole frame. Handled while recording.
+ * 
+ * @param key pressed key
+ * @return true if the key was handled
+ */
+bool handle_view_key(int key) {
+
+    Point2f cursor = display_pipeline->to_display(cursor_position);
+
+    if (key == settings->KEY_ZOOM_IN || key == settings->KEY_ZOOM_IN_ALTERNATE) {
+        display_pipeline->zoom_at(cursor, settings->DISPLAY_ZOOM_STEP);
+    } else if (key == settings->KEY_ZOOM_OUT) {
+        display_pipeline->zoom_at(cursor, 1 / settings->DISPLAY_ZOOM_STEP);
+    } else if (key == settings->KEY_RESET_VIEW) {
+        display_pipeline->reset_view();
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Wait for GUI events. Cursor moves are drawn by the mouse handler while
+ * waiting, so the wait ends early only if there is something for the labeling
+ * loop to do: recording was started or stopped, ESC was pressed, or a key was
+ * pressed or a frame slider jump was requested while paused.
+ * 
+ * @param time longest wait in milliseconds
+ * @return pressed key, -1 if none
+ */
+int wait_for_events(int time) {
+
+    ScopedTimer wait_timer("wait", frame_number);
+
+    int64 start = getTickCount();
+
+    int waiting_status = status;
+
+    while (true) {
+
+        int remaining = time - (int) ((getTickCount() - start) * 1000 / getTickFrequency());
 
-    // Log time
-    logger->log_general(current_time);
-    logger->log_general(" ");
+        if (remaining <= 0) {
+            return -1;
+        }
+
+        // Wake up now and then to check the state changed by the handlers,
+        // keys end the wait right away
+        int key = waitKey(min(remaining, settings->EVENT_POLL_INTERVAL));
+
+        if (key == 27 || status != waiting_status) {
+            return key;
+        }
+
+        // Object and view keys only change the shown frame
+        if (handle_object_key(key) || handle_view_key(key)) {
+            show_frame();
+            continue;
+        }
+
+        if (status != 2 && (key >= 0 || requested_frame_number >= 0)) {
+            return key;
+        }
+    }
+}
+
+/**
+ * Create one log entry with current system status. The entry is only queued,
+ * formatting and file output is done by the label writer thread.
+ * 
+ * @param label_writer
+ * @param position labeled EMILY location
+ * @param flags label flags
+ * @param confidence confidence of tracked labels
+ */
+void create_log_entry(LabelWriter* label_writer, Point2f position, uint32_t flags, float confidence) {
+
+    ScopedTimer log_timer("log", frame_number);
+
+    // Log time, frame number and EMILY location
+    LabelRecord record;
+    record.frame_number = frame_number;
+    record.time = LabelWriter::current_time();
+    record.x = position.x;
+    record.y = position.y;
+    record.flags = flags;
+    record.confidence = confidence;
+    record.object_id = active_object;
+    record.width = object_box_sizes[active_object].width;
+    record.height = object_box_sizes[active_object].height;
+    record.reserved = 0;
+
+    // Draw the label over the frame while it is shown
+    frame_labels.put(record);
+
+    // Record undistorted positions over distorted frames
+    if (settings->UNDISTORTION == UNDISTORTION_LABELS && undistorter != NULL) {
+        Point2f undistorted_position = undistorter->undistort_point(position);
+        record.x = undistorted_position.x;
+        record.y = undistorted_position.y;
+    }
+
+    label_writer->write(record);
+
+    // Relabeled frames are overwritten in place
+    if (label_store != NULL) {
+        label_store->put(record);
+    }
+
+    // Keep the label for the interpolation
+    session_runs.back().push_back(record);
+
+}
+
+/**
+ * Draw a recorded label over the frames it belongs to. Labels recorded
+ * undistorted over distorted frames are mapped back to the frame pixels.
+ * 
+ * @param record label as recorded
+ */
+void put_frame_label(LabelRecord record) {
+
+    if (settings->UNDISTORTION == UNDISTORTION_LABELS && undistorter != NULL) {
+        Point2f position = undistorter->distort_point(Point2f(record.x, record.y));
+        record.x = position.x;
+        record.y = position.y;
+    }
+
+    frame_labels.put(record);
+}
+
+/**
+ * Prepare the label file of a resumed session. A torn last record left by a
+ * crash is cut, the keyframes the interpolation continues from are reloaded
+ * and the frame to continue at is found. The labels are reloaded from the
+ * label store if it exists, without parsing the label file.
+ * 
+ * @param label_file_name label file of the session
+ * @param label_format format of the label file
+ * @param committed_frame last committed frame from the session file
+ * @param from_store reload the labels from the open label store
+ * @return first frame to show
+ */
+long resume_labels(string label_file_name, int label_format, long committed_frame, bool from_store) {
+
+    if (!LabelWriter::truncate_torn_record(label_file_name, label_format)) {
+        cout << "Cannot repair label file " << label_file_name << endl;
+    }
+
+    vector<LabelRecord> labels;
+
+    if (from_store) {
+        label_store->read_all(labels);
+    } else {
+        LabelReader::read_all(label_file_name, labels);
+    }
+
+    long last_frame = committed_frame;
+    long last_interpolated_frame = -1;
+
+    for (size_t i = 0; i < labels.size(); i++) {
+
+        put_frame_label(labels[i]);
+
+        // Labels of earlier sessions are sorted by frame and interpolated
+        // labels may follow the last keyframe, the file order does not tell
+        // the last labeled frame
+        if (labels[i].flags & LABEL_FLAG_INTERPOLATED) {
+            last_interpolated_frame = max(last_interpolated_frame, (long) labels[i].frame_number);
+        } else {
+            last_frame = max(last_frame, (long) labels[i].frame_number);
+        }
+    }
+
+    // Keyframes not interpolated yet, e.g., after a crash. Pauses before the
+    // crash are not known, they form one run.
+    for (size_t i = 0; i < labels.size(); i++) {
+        if (!(labels[i].flags & LABEL_FLAG_INTERPOLATED) && labels[i].frame_number > last_interpolated_frame) {
+            session_runs.back().push_back(labels[i]);
+        }
+    }
+
+    end_label_run();
+
+    return last_frame >= 0 ? last_frame + settings->KEYFRAME_INTERVAL : 0;
+}
+
+/**
+ * Rewrite the label file ordered by frame at the end of a session, so that
+ * labels placed after going back are in place. If requested, the frames
+ * between the keyframes of each run of this session are interpolated first
+ * and added marked as interpolated. Labels of the same frame keep the order
+ * they were written in and frames labeled by the annotator, the tracker or
+ * carried forward are never replaced by interpolated labels. A file already
+ * in frame order is not rewritten when nothing was interpolated.
+ * 
+ * @param label_file_name closed label file of the session
+ * @param label_format format of the label file
+ * @param interpolate interpolate the keyframes of the session
+ */
+void finish_session_labels(string label_file_name, int label_format, bool interpolate) {
+
+    LabelInterpolator label_interpolator(settings->MAXIMUM_INTERPOLATION_GAP, settings->INTERPOLATION_METHOD);
+
+    vector<LabelRecord> keyframes;
+    vector<LabelRecord> run_labels;
+    vector<LabelRecord> interpolated_labels;
+    long keyframe_count = 0;
+
+    // Runs are interpolated separately, segments do not cross pauses or jumps
+    for (size_t i = 0; interpolate && i < session_runs.size(); i++) {
+
+        // Frames labeled more than once keep the last label
+        LabelInterpolator::sort_labels(session_runs[i], keyframes);
+
+        label_interpolator.interpolate(keyframes, run_labels, false);
+
+        interpolated_labels.insert(interpolated_labels.end(), run_labels.begin(), run_labels.end());
+        keyframe_count += keyframes.size();
+    }
+
+    vector<LabelRecord> labels;
+
+    if (!LabelReader::read_all(label_file_name, labels)) {
+        cout << "Cannot read label file " << label_file_name << endl;
+        return;
+    }
+
+    auto frame_order = [](const LabelRecord& a, const LabelRecord & b) {
+        return a.frame_number < b.frame_number;
+    };
+
+    if (interpolated_labels.empty() && is_sorted(labels.begin(), labels.end(), frame_order)) {
+        return;
+    }
+
+    labels.insert(labels.end(), interpolated_labels.begin(), interpolated_labels.end());
 
-    // Log frame number
-    logger->log_general(frame_number);
-    logger->log_general(" ");
+    stable_sort(labels.begin(), labels.end(), frame_order);
+
+    // Write the labels into a new file that replaces the label file at once
+    string sorted_file_name = label_file_name + ".sorted";
+
+    LabelWriter sorted_writer(sorted_file_name, label_format, settings->LABEL_BUFFER_RECORDS, settings->LABEL_SYNC_INTERVAL);
+
+    if (!sorted_writer.is_open()) {
+        cout << "Cannot open label file " << sorted_file_name << endl;
+        return;
+    }
+
+    long interpolated_count = 0;
+    size_t frame_start = 0;
+
+    for (size_t i = 0; i < labels.size(); i++) {
+
+        if (labels[i].frame_number != labels[frame_start].frame_number) {
+            frame_start = i;
+        }
 
-    // Log EMILY location
-    logger->log_general(cursor_position.x);
-    logger->log_general(" ");
-    logger->log_general(cursor_position.y);
-    logger->log_general(" ");
+        if (labels[i].flags & LABEL_FLAG_INTERPOLATED) {
 
-    // End of log entry
-    logger->log_general("\n");
+            // Skip if the object has another label in the frame
+            bool labeled = false;
+
+            for (size_t j = frame_start; j < labels.size() && labels[j].frame_number == labels[i].frame_number && !labeled; j++) {
+                labeled = j != i && labels[j].object_id == labels[i].object_id && !(labels[j].flags & LABEL_FLAG_INTERPOLATED);
+            }
+
+            if (labeled) {
+                continue;
+            }
+
+            if (label_store != NULL) {
+                label_store->put(labels[i]);
+            }
+
+            interpolated_count++;
+        }
+
+        sorted_writer.write(labels[i]);
+    }
+
+    sorted_writer.close();
+
+    if (rename(sorted_file_name.c_str(), label_file_name.c_str()) != 0) {
+        cout << "Cannot replace label file " << label_file_name << endl;
+        return;
+    }
+
+    if (interpolate) {
+        cout << "Interpolated " << interpolated_count << " frames between " << keyframe_count << " keyframes" << endl;
+    }
 }
 
 int main(int argc, char** argv) {
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Settings
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Defaults from Settings.hpp, then the configuration file, its profiles
+    // for the video source and the command line
+    settings = new Settings();
+
+    vector<string> arguments;
+
+    if (!settings->configure(argc, argv, arguments)) {
+        return 1;
+    }
+
+    // Print the effective settings as a configuration file
+    if (!arguments.empty() && arguments[0] == "--print-settings") {
+        settings->print(cout);
+        return 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Batch mode
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Process an existing label file without the GUI
+    if (!arguments.empty() && arguments[0] == "--batch") {
+
+        if (arguments.size() != 4) {
+            cout << "Usage: " << argv[0] << " [--config file] [--set name=value] --batch video labels output_directory" << endl;
+            return 1;
+        }
+
+        BatchProcessor batch_processor(* settings, arguments[1], arguments[2], arguments[3]);
+
+        return batch_processor.run() ? 0 : 1;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Evaluation mode
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Score tracker outputs against ground truth labels
+    if (!arguments.empty() && arguments[0] == "--evaluate") {
+
+        bool run_list = arguments.size() == 4 && arguments[2] == "--runs";
+
+        if (!run_list && arguments.size() < 4) {
+            cout << "Usage: " << argv[0] << " [--config file] [--set name=value] --evaluate output_directory ground_truth tracker_output ..." << endl;
+            cout << "       " << argv[0] << " [--config file] [--set name=value] --evaluate output_directory --runs run_list" << endl;
+            return 1;
+        }
+
+        TrackerEvaluator tracker_evaluator(arguments[1], settings->EVALUATION_LOST_THRESHOLD, settings->EVALUATION_MAXIMUM_THRESHOLD);
+
+        if (run_list) {
+
+            if (!tracker_evaluator.add_runs(arguments[3])) {
+                cout << "Cannot read run list " << arguments[3] << endl;
+                return 1;
+            }
+
+        } else {
+            for (size_t i = 3; i < arguments.size(); i++) {
+                tracker_evaluator.add_run(arguments[2], arguments[i]);
+            }
+        }
+
+        return tracker_evaluator.run() ? 0 : 1;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Merge mode
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Combine the labels of several annotators of the same video
+    if (!arguments.empty() && arguments[0] == "--merge") {
+
+        if (arguments.size() < 4) {
+            cout << "Usage: " << argv[0] << " [--config file] [--set name=value] --merge merged_labels labels labels ..." << endl;
+            return 1;
+        }
+
+        LabelMerger label_merger(* settings);
+
+        for (size_t i = 2; i < arguments.size(); i++) {
+            if (!label_merger.add_annotator(arguments[i])) {
+                cout << "Cannot read labels " << arguments[i] << endl;
+                return 1;
+            }
+        }
+
+        return label_merger.merge(arguments[1]) ? 0 : 1;
+    }
+
+    if (arguments.size() > 1) {
+        cout << "Usage: " << argv[0] << " [--config file] [--set name=value] [--print-settings] [video]" << endl;
+        return 1;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Video capture
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Choose the backend, probed once per video file
+    DecoderSelector decoder_selector(settings->video_capture_source, settings->DECODER_PROBE_FRAMES, settings->DECODER_FRAME_HEIGHT);
+
+    if (!decoder_selector.select(settings->DECODER_BACKEND)) {
+        cout << "No decoder can decode " << settings->video_capture_source << endl;
+    }
+
+    video_capture = new VideoCapture();
+
+    if (!decoder_selector.open(* video_capture)) {
+        cout << "Cannot open video " << settings->video_capture_source << endl;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Output video initialization
     //////////////////////////////////////////////////////////////////////////// 
@@ -157,24 +821,297 @@ int main(int argc, char** argv) {
     strftime(output_file_name, 40, "output/%Y_%m_%d_%H_%M_%S_ground_truth", local_time);
     string output_file_name_string(output_file_name);
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Capture ring
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Record the live source on a capture thread and label the recording, so
+    // that the source does not wait for the labeling
+    CaptureRing * capture_ring = NULL;
+
+    if (settings->CAPTURE_RING) {
+        capture_ring = new CaptureRing(video_capture, settings->video_capture_source, output_file_name_string + "_ring", settings->CAPTURE_RING_SEGMENT_FRAMES, settings->CAPTURE_RING_SEGMENTS, settings->CAPTURE_RING_FORMAT, settings->CAPTURE_RING_QUALITY, settings->CAPTURE_RING_KEEP);
+        video_capture = capture_ring;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Undistortion
+    ////////////////////////////////////////////////////////////////////////////
+
+    // The remap tables are built once per frame size and cached on disk
+    if (settings->UNDISTORTION != UNDISTORTION_NONE) {
+
+        undistorter = new Undistorter(settings->camera_intrinsic_matrix, settings->camera_distortion_vector, settings->CAMERA_CALIBRATION_SIZE, settings->UNDISTORTION_CACHE_DIRECTORY);
+
+        if (!undistorter->prepare(input_video_size, settings->UNDISTORTION == UNDISTORTION_FRAMES)) {
+            cout << "Cannot prepare undistortion maps, frames are shown distorted" << endl;
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Log
     ////////////////////////////////////////////////////////////////////////////
 
-    Logger * logger = new Logger(output_file_name_string);
+    // Labels are written in the text format by default, binary label files can
+    // be converted to text using the LabelConverter tool
+    int label_format = settings->LABEL_FORMAT;
+    string label_file_name = output_file_name_string + (label_format == LABEL_FORMAT_BINARY ? ".bin" : ".txt");
+
+    // Continue the last unfinished session of the same video instead of
+    // starting from the first frame
+    SessionState session_state;
+    string session_file_name = output_file_name_string + ".session";
+
+    bool resume_session = settings->SESSION_RESUME && SessionJournal::find_resumable("output", settings->video_capture_source, session_state, session_file_name);
+
+    // First frame shown
+    long start_frame_number = 0;
+
+    if (resume_session) {
+
+        label_format = session_state.label_format;
+        label_file_name = session_state.label_file_name;
+
+        // Continue with the keyframe interval the session was labeled with,
+        // otherwise the frame steps and interpolated runs would not match
+        if (session_state.keyframe_interval > 0 && session_state.keyframe_interval != settings->KEYFRAME_INTERVAL) {
+            cout << "Using keyframe interval " << session_state.keyframe_interval << " of the resumed session" << endl;
+            settings->KEYFRAME_INTERVAL = session_state.keyframe_interval;
+        }
+
+    }
+
+    // Label store next to the label file, a resumed session reopens it
+    bool resume_from_store = false;
+
+    if (settings->LABEL_STORE) {
+
+        string label_store_file_name = label_file_name.substr(0, label_file_name.rfind('.')) + ".store";
+
+        resume_from_store = resume_session && LabelStore::is_store(label_store_file_name);
+
+        label_store = new LabelStore(label_store_file_name, settings->OBJECT_KEYS.size());
+
+        if (!label_store->open(true)) {
+            cout << "Cannot open label store " << label_store_file_name << endl;
+            delete label_store;
+            label_store = NULL;
+            resume_from_store = false;
+        }
+    }
+
+    if (resume_session) {
+
+        start_frame_number = resume_labels(label_file_name, label_format, session_state.frame_number, resume_from_store);
+
+        cout << "Resuming session " << session_file_name << " at frame " << start_frame_number << endl;
+    }
+
+    LabelWriter * label_writer = new LabelWriter(label_file_name, label_format, settings->LABEL_BUFFER_RECORDS, settings->LABEL_SYNC_INTERVAL, resume_session);
+
+    if (!label_writer->is_open()) {
+        cout << "Cannot open label file " << label_file_name << endl;
+    }
+
+    // Records the last committed frame so that a crash or exit can be resumed
+    SessionJournal * session_journal = new SessionJournal(session_file_name);
+
+    if (resume_session) {
+        session_journal->reopen();
+    } else {
+
+        session_state.video_file_name = settings->video_capture_source;
+        session_state.label_file_name = label_file_name;
+        session_state.label_format = label_format;
+        session_state.keyframe_interval = settings->KEYFRAME_INTERVAL;
+
+        // Sessions of streams are recorded but cannot be resumed
+        if (!SessionJournal::read_video_file_status(session_state.video_file_name, session_state.video_file_size, session_state.video_file_time)) {
+            session_state.video_file_size = -1;
+            session_state.video_file_time = -1;
+        }
+
+        session_journal->create(session_state);
+    }
+
+    if (!session_journal->is_open()) {
+        cout << "Cannot open session file " << session_file_name << endl;
+    }
+
+    // The writer thread commits the synced frames, the checkpoint is
+    // synchronized to the disk as well
+    label_writer->set_status(status);
+    label_writer->set_sync_handler([session_journal](long synced_frame, int synced_status) {
+        session_journal->checkpoint(synced_frame, synced_status);
+    });
 
     ////////////////////////////////////////////////////////////////////////////
     // GUI
     ////////////////////////////////////////////////////////////////////////////
 
-    UserInterface * user_interface = new UserInterface(* settings, resized_video_size);
+    // Builds the shown frames in display resolution, labels stay in original
+    // pixel coordinates
+    display_pipeline = new DisplayPipeline(input_video_size, resized_video_size);
+
+    display_pipeline->set_maximum_zoom(settings->DISPLAY_MAXIMUM_ZOOM);
+
+    user_interface = new UserInterface(* settings, * display_pipeline);
+
+    // Every object is labeled as a point until its box is dragged
+    object_box_sizes.resize(settings->OBJECT_KEYS.size());
+
+    // Cursor and texts are drawn over a copy of the shown frame
+    overlay_layer = new OverlayLayer();
+
+    // Draw cursor moves right away
+    user_interface->set_redraw_handler(show_frame);
+
+    // Record every cursor move, not only the position when the label is taken
+    cursor_sampler = new CursorSampler(settings->CURSOR_SAMPLE_CAPACITY, settings->CURSOR_SUMMARY_WINDOW, settings->CURSOR_SUMMARY);
+
+    if (settings->CURSOR_TRACE && !cursor_sampler->open_trace(output_file_name_string + "_cursor.txt")) {
+        cout << "Cannot open cursor trace " << output_file_name_string << "_cursor.txt" << endl;
+    }
+
+    user_interface->set_cursor_sampler(cursor_sampler);
+
+    // Adapt the time for annotation to the cursor and scene motion
+    if (settings->ADAPTIVE_PACING) {
+
+        annotation_pacer = new AnnotationPacer(settings->time_for_annotation, settings->PACING_MINIMUM_INTERVAL, settings->PACING_MAXIMUM_INTERVAL, settings->PACING_MOTION_THRESHOLD, settings->PACING_CURSOR_THRESHOLD, settings->PACING_SPEEDUP, settings->PACING_SLOWDOWN);
+
+        if (!annotation_pacer->open_log(output_file_name_string + "_pacing.txt")) {
+            cout << "Cannot open pacing log " << output_file_name_string << "_pacing.txt" << endl;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Seeking
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Load the key frames cached next to the video or read them from the
+    // container in the background on the first open
+    VideoIndex * video_index = new VideoIndex(settings->video_capture_source);
+
+    // The capture ring is indexed by frame, the source is not seeked
+    if (capture_ring == NULL && video_index->is_file()) {
+        video_index->start();
+    }
+
+    // Frame slider to jump to any frame
+    long frame_count = video_index->is_valid() ? video_index->get_frame_count() : (long) video_capture->get(CV_CAP_PROP_FRAME_COUNT);
+
+    if (frame_count > 0) {
+        user_interface->create_frame_trackbar(frame_count);
+    }
+
+    // Recently decoded frames for instant stepping backward
+    frame_cache = new FrameCache((size_t) settings->FRAME_CACHE_BUDGET_MB * 1024 * 1024, settings->FRAME_CACHE_DISPLAY_HEIGHT);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Timing
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Time the labeling loop and the decoder thread, which starts next
+    TimingTrace * timing_trace = NULL;
+
+    if (settings->TIMING_TRACE) {
+        timing_trace = new TimingTrace(settings->TIMING_TRACE_CAPACITY);
+        timing_trace->name_thread("labeling");
+        TimingTrace::set_active(timing_trace);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Frame prefetching
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Decode frames ahead on a background thread so that the labeling loop
+    // only hands off already decoded buffers
+    frame_prefetcher = new FramePrefetcher(* video_capture, settings->PREFETCH_QUEUE_DEPTH, input_video_size, video_index, frame_cache);
+
+    // In keyframe mode the frames in between are skipped by the decoder
+    frame_prefetcher->set_frame_step(settings->KEYFRAME_INTERVAL);
+
+    // Undistort the frames on the decoding thread
+    if (undistorter != NULL && undistorter->is_prepared()) {
+        frame_prefetcher->set_undistorter(undistorter);
+    }
+
+    // Frames are numbered by the capture ring, which skips frames that were
+    // overwritten before they were labeled
+    if (capture_ring != NULL) {
+
+        frame_prefetcher->set_live_source(true);
+
+        if (!capture_ring->start()) {
+            cout << "Cannot start capture ring " << output_file_name_string << "_ring" << endl;
+        }
+    }
+
+    // Frames are compared with the last labeled one and the scene motion is
+    // measured on signatures computed on the decoding thread
+    if (settings->AUTO_SKIP || settings->ADAPTIVE_PACING) {
+        frame_prefetcher->set_signature_width(settings->AUTO_SKIP_SIGNATURE_WIDTH);
+    }
+
+    frame_prefetcher->start();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Tracker assist
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Proposes the position in new frames from the last label
+    TemplateTracker * template_tracker = NULL;
+
+    if (settings->TRACKER_ASSIST) {
+        template_tracker = new TemplateTracker(settings->TRACKER_TEMPLATE_SIZE, settings->TRACKER_SEARCH_RADIUS, settings->TRACKER_SCALE);
+    }
 
     ////////////////////////////////////////////////////////////////////////////
     // Local variables
     ////////////////////////////////////////////////////////////////////////////
 
-    // Was the first frame annotated?
-    bool first_frame_annotated = false;
+    // The current frame was shown while paused and was not annotated yet
+    bool frame_pending = false;
+
+    // Keyframes were labeled manually while paused
+    bool keyframes_labeled = false;
+
+    // The end of the video was reached
+    bool video_finished = false;
+
+    // Status the current run of labeled frames was started in
+    int run_status = status;
+
+    // Last frame the scene motion was measured on
+    long paced_frame_number = -1;
+
+    // Number of accepted tracker proposals and those with low confidence
+    long tracked_labels = 0;
+    long low_confidence_labels = 0;
+
+    // Frames labeled while recording, those labeled later than planned and
+    // those skipped by the decoder
+    long labeled_frames = 0;
+    long late_frames = 0;
+    long dropped_frames = 0;
+
+    // Time of the last label while recording, 0 after a pause
+    int64_t last_label_time = 0;
+
+    // Signature, position and object of the last label placed by the
+    // annotator or the tracker, static frames are compared with it
+    Mat skip_reference;
+    Point2f skip_position;
+    int skip_object = -1;
+
+    // The current frame looks like the last labeled one and its label is
+    // carried forward
+    bool frame_static = false;
+
+    // Frames carried forward since the last label and in total
+    long static_run = 0;
+    long carried_labels = 0;
     
     ////////////////////////////////////////////////////////////////////////////
     // Labeling
@@ -182,51 +1119,101 @@ int main(int argc, char** argv) {
 
     // Iterate over each frame from the video input and wait between iterations.
     while (true) {
+
+        // Pausing or resuming the recording ends the run of labeled frames
+        if (status != run_status) {
+            end_label_run();
+            run_status = status;
+        }
         
-        // If status is initialization or recording, load new frame     
-        if (status == 2 || status == 0) {
+        // If status is initialization, load the first frame
+        if (status == 0) {
 
-            // If the first frame was not annotated yet, do not load the next frame and use the last one (frame 0)
-            if (frame_number == 0 && !first_frame_annotated) {
+            // End if there is no frame, a resumed session may be complete
+            if (!load_frame(start_frame_number)) {
+                video_finished = true;
+                break;
+            }
+
+            user_interface->set_frame_trackbar_position(frame_number);
+
+            // Switch to ready
+            status = 1;
+
+        // If status is recording, load new frame
+        } else if (status == 2) {
+
+            // If the frame shown while paused was not annotated yet, do not
+            // load the next frame and annotate that one now
+            if (frame_pending) {
                 
-                // First frame (frame 0) will be annotated now
-                first_frame_annotated = true;
+                frame_pending = false;
+
+                // The first frame after the pause is labeled manually
+                label_tracked = false;
+                frame_static = false;
                 
             } else {
-                
-                // Read one frame
-                video_capture >> original_frame;
-                
-                // Increase frame number counter
-                frame_number++;
-                
-            }
 
-            // End if frame is empty
-            if (original_frame.empty()) {
-                break;
-            }
+                long expected_frame_number = frame_number + settings->KEYFRAME_INTERVAL;
+
+                // End if there are no more frames
+                if (!load_frame(expected_frame_number)) {
+                    video_finished = true;
+                    break;
+                }
+
+                // A live source may skip frames the decoder did not keep up with
+                if (frame_number > expected_frame_number) {
+                    dropped_frames += (frame_number - expected_frame_number) / settings->KEYFRAME_INTERVAL;
+                }
+
+                // Carry the last label over frames that did not change since
+                frame_static = settings->AUTO_SKIP && skip_object == active_object && !frame_signature.empty() && frame_signature.size() == skip_reference.size();
+                frame_static = frame_static && (settings->AUTO_SKIP_MAXIMUM_RUN == 0 || static_run < settings->AUTO_SKIP_MAXIMUM_RUN);
+                frame_static = frame_static && norm(frame_signature, skip_reference, NORM_L1) / frame_signature.total() < settings->AUTO_SKIP_THRESHOLD;
+
+                // Propose the position of the target in the new frame. Static
+                // frames carry the last label, a proposal of an earlier frame
+                // must not be shown or logged for them.
+                if (frame_static) {
+                    label_tracked = false;
+                } else if (template_tracker != NULL) {
+
+                    ScopedTimer track_timer("track", frame_number);
+
+                    label_tracked = template_tracker->track(original_frame, tracked_position, tracked_confidence);
+                }
 
-            // If status was initialization, switch to ready
-            if (status == 0) {
-                status = 1;
             }
 
-        }
+            // Cursor movements while the frame is shown correct the proposal
+            cursor_moved = false;
 
-        ////////////////////////////////////////////////////////////////////////
-        // Preprocessing
-        ////////////////////////////////////////////////////////////////////////
+            // Ignore jumps requested while recording
+            requested_frame_number = -1;
+
+            // Keep the frame slider at the current frame
+            user_interface->set_frame_trackbar_position(frame_number);
+
+        // If status is ready, jump to the requested frame
+        } else {
+
+            if (requested_frame_number >= 0) {
+
+                load_frame(requested_frame_number);
+
+                requested_frame_number = -1;
 
-        // Make copy of current frame
-        Mat output;
-        original_frame.copyTo(output);
+                user_interface->set_frame_trackbar_position(frame_number);
 
+            }
 
-        if (resize_video) {
+            // The frame shown while paused is annotated when recording starts
+            frame_pending = true;
 
-            // Resize the input
-            //resize(original_frame, original_frame, resized_video_size, 0, 0, INTER_LANCZOS4);
+            label_tracked = false;
+            frame_static = false;
 
         }
 
@@ -234,34 +1221,155 @@ int main(int argc, char** argv) {
         // Visualization
         ////////////////////////////////////////////////////////////////////////
 
-        // Visualize cursor location
-        user_interface->draw_position(cursor_position.x, cursor_position.y, 10, output);
+        // Show the frame, unchanged frames are not shown again
+        show_frame();
 
-        // Get status as a string message
-        user_interface->print_status(output, status);
+        // Measure the scene motion on the whole frame, not on the zoomed view
+        if (annotation_pacer != NULL && status == 2 && frame_number != paced_frame_number) {
 
-        ////////////////////////////////////////////////////////////////////////
-        // Main Window
-        ////////////////////////////////////////////////////////////////////////
+            annotation_pacer->observe_frame(frame_signature);
+
+            paced_frame_number = frame_number;
 
-        // Show output frame in the main window
-        user_interface->show_main(output);
+        }
 
         ////////////////////////////////////////////////////////////////////////
         // Log output
         ////////////////////////////////////////////////////////////////////////
 
         // Wait some time before recording cursor position to allow the user
-        // to move the cursor to the desired position.
-        if (waitKey(settings->time_for_annotation) != 27) {
+        // to move the cursor to the desired position. Cursor moves are drawn
+        // while waiting.
+        int annotation_interval = annotation_pacer != NULL ? annotation_pacer->get_interval() : settings->time_for_annotation;
+
+        // Static frames are only shown long enough to move the cursor
+        if (frame_static) {
+            annotation_interval = settings->AUTO_SKIP_INTERVAL;
+        }
+
+        int key = wait_for_events(annotation_interval);
+
+        // Take the cursor moves recorded while waiting
+        cursor_sampler->collect(frame_number);
+
+        if (key != 27) {
             
-            // Only log if status is recording and the first frame was annotated
-            if (status == 2 && first_frame_annotated) {
+            // Only log if status is recording and the frame was not shown while paused
+            if (status == 2 && !frame_pending) {
+
+                if (frame_static && !cursor_moved) {
+
+                    // Log the last label again, the annotator did not react
+                    create_log_entry(label_writer, skip_position, LABEL_FLAG_CARRIED, 0);
+
+                    carried_labels++;
+                    static_run++;
+
+                    // Static frames are shown shortly, the next label is not late
+                    last_label_time = 0;
+
+                    if (annotation_pacer != NULL) {
+                        annotation_pacer->count_label();
+                    }
+
+                } else {
+
+                    Point2f labeled_position;
 
-                // Log the data
-                create_log_entry(logger);
+                    if (label_tracked && !cursor_moved) {
+
+                        // Log the tracker proposal the annotator did not correct
+                        create_log_entry(label_writer, tracked_position, LABEL_FLAG_TRACKED, tracked_confidence);
+
+                        labeled_position = tracked_position;
+
+                        tracked_labels++;
+
+                        if (tracked_confidence < settings->TRACKER_REVIEW_CONFIDENCE) {
+                            low_confidence_labels++;
+                        }
+
+                        // Follow appearance changes while the match is reliable
+                        if (tracked_confidence >= settings->TRACKER_UPDATE_CONFIDENCE) {
+                            template_tracker->initialize(original_frame, tracked_position);
+                        }
+
+                    } else {
+
+                        // Summarize the cursor moves of the frame
+                        labeled_position = cursor_sampler->summarize(cursor_position);
+
+                        // Log the data
+                        create_log_entry(label_writer, labeled_position, 0, 0);
+
+                        // Track from the manual label
+                        if (template_tracker != NULL) {
+                            template_tracker->initialize(original_frame, labeled_position);
+                        }
+
+                    }
+
+                    // Adapt the time for annotation of the next frame, the cursor
+                    // path is measured in display pixels
+                    if (annotation_pacer != NULL) {
+                        annotation_pacer->update(frame_number, cursor_sampler->take_path_length() * display_pipeline->get_scale());
+                    }
+
+                    // The time between two labels is the time for annotation plus
+                    // loading and showing the frame, anything longer is lag
+                    int64_t label_time = TimingTrace::now();
+
+                    if (last_label_time > 0 && (label_time - last_label_time) / 1000000 > annotation_interval + settings->LATE_FRAME_TOLERANCE) {
+                        late_frames++;
+                    }
+
+                    last_label_time = label_time;
+                    labeled_frames++;
+
+                    // Following frames are compared with this one
+                    if (!frame_signature.empty()) {
+                        frame_signature.copyTo(skip_reference);
+                        skip_position = labeled_position;
+                        skip_object = active_object;
+                    }
+
+                    static_run = 0;
+
+                }
+
+            } else {
+
+                // Cursor moves while paused do not count
+                cursor_sampler->take_path_length();
+
+                last_label_time = 0;
+
+                if (annotation_pacer != NULL) {
+                    annotation_pacer->pause();
+                }
 
             }
+
+            // Step backward or forward while paused
+            if (status == 1) {
+
+                if (key == settings->KEY_STEP_BACKWARD && frame_number >= settings->KEYFRAME_INTERVAL) {
+                    requested_frame_number = frame_number - settings->KEYFRAME_INTERVAL;
+                } else if (key == settings->KEY_STEP_FORWARD) {
+                    requested_frame_number = frame_number + settings->KEYFRAME_INTERVAL;
+                } else if (key == settings->KEY_LABEL_KEYFRAME) {
+
+                    // Label the shown frame as a keyframe
+                    create_log_entry(label_writer, cursor_sampler->summarize(cursor_position), 0, 0);
+                    keyframes_labeled = true;
+
+                }
+
+            }
+
+            // Recorded with the frame whose label reached the disk at the next
+            // label file synchronization
+            label_writer->set_status(status);
         
         } else {
             
@@ -272,8 +1380,93 @@ int main(int argc, char** argv) {
 
     }
 
-    // Close logs
-    delete logger;
+    // Write the remaining labels and close the label file
+    label_writer->close();
+
+    // Fill the frames between the keyframes and order the labels by frame
+    finish_session_labels(label_file_name, label_format, settings->KEYFRAME_INTERVAL > 1 || keyframes_labeled);
+
+    // Commit the last labels. A session is only finished at the end of the
+    // video so that it can be resumed after ESC.
+    if (label_writer->get_synced_frame() >= 0) {
+        session_journal->checkpoint(label_writer->get_synced_frame(), status);
+    }
+
+    if (video_finished) {
+        session_journal->finish();
+    }
+
+    delete session_journal;
+    delete label_writer;
+
+    if (label_store != NULL) {
+        label_store->sync();
+        delete label_store;
+    }
+
+    // Report the tracker proposals to review
+    if (template_tracker != NULL) {
+        cout << "Tracked labels: " << tracked_labels << " (" << low_confidence_labels << " with confidence below " << settings->TRACKER_REVIEW_CONFIDENCE << ")" << endl;
+        delete template_tracker;
+    }
+
+    // Print decoding statistics so that the queue depth and the cache budget
+    // can be sized per source
+    frame_prefetcher->print_statistics();
+    frame_cache->print_statistics();
+
+    cout << "Overlay: " << overlay_layer->get_full_copies() << " full frame copies, " << overlay_layer->get_restored_bytes() / 1024 << " kB restored" << endl;
+    if (annotation_pacer != NULL) {
+        annotation_pacer->print_statistics();
+        delete annotation_pacer;
+    }
+
+    cout << "Cursor samples: " << cursor_sampler->get_samples() << " (" << cursor_sampler->get_dropped_samples() << " dropped)" << endl;
+
+    cout << "Frames: " << labeled_frames << " labeled while recording, " << late_frames << " late, " << dropped_frames << " dropped" << endl;
+
+    // Share of the frames the annotator did not have to label
+    if (settings->AUTO_SKIP) {
+
+        long recorded_frames = labeled_frames + carried_labels;
+
+        cout << "Static frames: " << carried_labels << " of " << recorded_frames << " carried forward (" << (recorded_frames > 0 ? 100.0 * carried_labels / recorded_frames : 0) << " %)" << endl;
+    }
+
+    // Stop decoding
+    delete frame_prefetcher;
+
+    // Stop capturing
+    if (capture_ring != NULL) {
+        capture_ring->stop();
+        capture_ring->print_statistics();
+    }
+
+    // Save the timing after the decoder thread stopped
+    if (timing_trace != NULL) {
+
+        TimingTrace::set_active(NULL);
+
+        if (!timing_trace->write_trace(output_file_name_string + "_trace.json")) {
+            cout << "Cannot write timing trace " << output_file_name_string << "_trace.json" << endl;
+        }
+
+        if (!timing_trace->write_summary(output_file_name_string + "_timing.txt", labeled_frames, late_frames, dropped_frames)) {
+            cout << "Cannot write timing summary " << output_file_name_string << "_timing.txt" << endl;
+        }
+
+        delete timing_trace;
+    }
+    delete frame_cache;
+    delete undistorter;
+    delete video_index;
+
+    delete cursor_sampler;
+    delete overlay_layer;
+    delete user_interface;
+    delete display_pipeline;
+
+    delete video_capture;
 
     // Announce that the processing was finished
     cout << "Processing finished!" << endl;
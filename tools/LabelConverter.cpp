@@ -0,0 +1,133 @@
+/** 
+ * @file    LabelConverter.cpp
+ * @author  Jan Dufek
+ *  
+ * Converts label files between the text and the binary label format and the
+ * memory mapped label store.
+ *
+ * Usage: LabelConverter input output [text|binary|store]
+ *
+ * If the output format is not given, a text or binary input is converted to
+ * the other format and a label store is exported to text.
+ *
+ */
+
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+#include "../LabelReader.hpp"
+#include "../LabelWriter.hpp"
+#include "../LabelStore.hpp"
+
+using namespace std;
+
+// Output format of label stores, the text and binary formats are LabelFormat
+static const int OUTPUT_FORMAT_STORE = -1;
+
+int main(int argc, char** argv) {
+
+    if (argc < 3 || argc > 4) {
+        cout << "Usage: " << argv[0] << " input output [text|binary|store]" << endl;
+        return 1;
+    }
+
+    bool input_store = LabelStore::is_store(argv[1]);
+
+    int input_format = LABEL_FORMAT_TEXT;
+
+    if (!input_store) {
+
+        LabelReader reader(argv[1]);
+
+        if (!reader.is_open()) {
+            cout << "Cannot read " << argv[1] << endl;
+            return 1;
+        }
+
+        input_format = reader.get_format();
+    }
+
+    // Convert to the other format by default
+    int output_format = !input_store && input_format == LABEL_FORMAT_TEXT ? LABEL_FORMAT_BINARY : LABEL_FORMAT_TEXT;
+
+    if (argc == 4) {
+        if (strcmp(argv[3], "text") == 0) {
+            output_format = LABEL_FORMAT_TEXT;
+        } else if (strcmp(argv[3], "binary") == 0) {
+            output_format = LABEL_FORMAT_BINARY;
+        } else if (strcmp(argv[3], "store") == 0) {
+            output_format = OUTPUT_FORMAT_STORE;
+        } else {
+            cout << "Unknown format " << argv[3] << endl;
+            return 1;
+        }
+    }
+
+    long count;
+
+    if (input_store && output_format == OUTPUT_FORMAT_STORE) {
+        cout << "The input is already a label store" << endl;
+        return 1;
+    } else if (input_store) {
+
+        LabelStore store(argv[1], 1);
+
+        if (!store.open(false)) {
+            cout << "Cannot read " << argv[1] << endl;
+            return 1;
+        }
+
+        count = store.export_labels(argv[2], output_format);
+
+    } else if (output_format == OUTPUT_FORMAT_STORE) {
+
+        // One slot per object up to the highest object in the labels
+        vector<LabelRecord> records;
+        LabelReader::read_all(argv[1], records);
+
+        uint32_t objects = 1;
+
+        for (size_t i = 0; i < records.size(); i++) {
+            objects = max(objects, records[i].object_id + 1);
+        }
+
+        LabelStore store(argv[2], objects);
+
+        if (!store.open(true)) {
+            cout << "Cannot write " << argv[2] << endl;
+            return 1;
+        }
+
+        count = store.import_labels(argv[1]);
+        store.sync();
+
+    } else {
+
+        LabelReader reader(argv[1]);
+        LabelWriter writer(argv[2], output_format, 65536, 1000);
+
+        if (!writer.is_open()) {
+            cout << "Cannot write " << argv[2] << endl;
+            return 1;
+        }
+
+        LabelRecord record;
+        count = 0;
+
+        while (reader.next(record)) {
+            writer.write(record);
+            count++;
+        }
+
+        writer.close();
+    }
+
+    if (count < 0) {
+        cout << "Cannot write " << argv[2] << endl;
+        return 1;
+    }
+
+    cout << "Converted " << count << " labels" << endl;
+
+    return 0;
+}
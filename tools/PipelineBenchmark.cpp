@@ -0,0 +1,349 @@
+/**
+ * @file    PipelineBenchmark.cpp
+ * @author  Jan Dufek
+ *
+ * Measures the stages of the labeling loop without a display: decoding,
+ * building the display frame, restoring the overlay, drawing the overlay and
+ * queuing the label. Each stage is timed per frame and
+ * reported as one JSON object per video and stage with its throughput and
+ * latency percentiles, so that the results of two builds can be compared.
+ *
+ * Usage: PipelineBenchmark [--frames N] [--zoom Z] [--output file] [video ...]
+ *
+ * Without videos, synthetic 1080p and 2160p videos are encoded into the
+ * temporary directory first and decoded like real ones.
+ *
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "opencv2/opencv.hpp"
+#include "../Settings.hpp"
+#include "../DisplayPipeline.hpp"
+#include "../OverlayLayer.hpp"
+#include "../UserInterface.hpp"
+#include "../LabelWriter.hpp"
+#include "../DecoderSelector.hpp"
+
+using namespace std;
+using namespace cv;
+
+// State shared with the user interface, owned by the labeling loop in the
+// application
+Point2f cursor_position(-1, -1);
+int status = 2;
+long frame_number = 0;
+long requested_frame_number = -1;
+bool cursor_moved = false;
+int active_object = 0;
+vector<Size2f> object_box_sizes;
+
+// Defaults from Settings.hpp and the configuration file
+Settings * settings = NULL;
+
+// Timed stages in the order they run in the labeling loop
+enum Stage {
+    STAGE_DECODE = 0,
+    STAGE_DISPLAY,
+    STAGE_OVERLAY,
+    STAGE_DRAW,
+    STAGE_LOG,
+    STAGE_COUNT
+};
+
+static const char * STAGE_NAMES[STAGE_COUNT] = {"decode", "display", "overlay", "draw", "log"};
+
+// Sizes of the synthetic videos
+static const Size SYNTHETIC_SIZES[] = {Size(1920, 1080), Size(3840, 2160)};
+
+/**
+ * Get the time in microseconds since some fixed point.
+ *
+ * @return time in microseconds
+ */
+static double now() {
+    return getTickCount() * 1e6 / getTickFrequency();
+}
+
+/**
+ * Get a percentile of the sorted latencies using the nearest rank.
+ *
+ * @param sorted sorted latencies
+ * @param percentile percentile from 0 to 100
+ * @return latency
+ */
+static double percentile(const vector<double>& sorted, double percentile) {
+
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t rank = (size_t) (percentile / 100 * sorted.size() + 0.5);
+
+    return sorted[min(max(rank, (size_t) 1), sorted.size()) - 1];
+}
+
+/**
+ * Encode a synthetic video with a moving object over a textured background.
+ *
+ * @param file_name output video
+ * @param size frame size
+ * @param frames number of frames
+ * @return false if the video cannot be written
+ */
+static bool write_synthetic_video(const string& file_name, Size size, int frames) {
+
+    VideoWriter writer(file_name, VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, size);
+
+    if (!writer.isOpened()) {
+        return false;
+    }
+
+    // Texture keeps the encoder from compressing the frames to nothing
+    Mat background(size, CV_8UC3);
+    randu(background, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(background, background, Size(0, 0), 3);
+
+    Mat frame;
+
+    for (int i = 0; i < frames; i++) {
+
+        background.copyTo(frame);
+
+        Point center(size.width / 4 + (i * 7) % (size.width / 2), size.height / 2 + (i * 3) % (size.height / 4));
+
+        circle(frame, center, size.height / 20, Scalar(0, 128, 255), -1);
+
+        writer.write(frame);
+    }
+
+    return true;
+}
+
+/**
+ * Run all stages on the frames of one video.
+ *
+ * @param video_file_name video
+ * @param frames maximum number of frames
+ * @param zoom zoom of the shown region around the center of the frame
+ * @param output stream the results are written to
+ * @return false if the video cannot be opened
+ */
+static bool benchmark_video(const string& video_file_name, int frames, double zoom, ostream& output) {
+
+    // Decode with the configured backend. The automatic choice is not probed,
+    // probing would read the video into the page cache before it is timed and
+    // leave its choice next to the video.
+    int backend = settings->DECODER_BACKEND == DECODER_BACKEND_AUTO ? DECODER_BACKEND_ANY : settings->DECODER_BACKEND;
+
+    DecoderSelector decoder_selector(video_file_name, settings->DECODER_PROBE_FRAMES, 0);
+
+    decoder_selector.select(backend);
+
+    VideoCapture video_capture;
+
+    if (!decoder_selector.open(video_capture)) {
+        cerr << "Cannot open video " << video_file_name << endl;
+        return false;
+    }
+
+    Size input_size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+    // Display size as in the application
+    int video_height_limit = min(settings->PROCESSING_VIDEO_HEIGHT_LIMIT, settings->DISPLAY_VIDEO_HEIGHT_LIMIT);
+
+    Size display_size = input_size;
+
+    if (input_size.height > video_height_limit) {
+        display_size = Size(input_size.width * video_height_limit / (double) input_size.height + 0.5, video_height_limit);
+    }
+
+    DisplayPipeline display_pipeline(input_size, display_size);
+
+    // Labeling zoomed in renders only the shown region
+    display_pipeline.set_maximum_zoom(zoom);
+    display_pipeline.zoom_at(Point2f(display_size.width / 2, display_size.height / 2), zoom);
+
+    // No window is created
+    UserInterface user_interface(* settings, display_pipeline, false);
+
+    OverlayLayer overlay_layer;
+
+    char label_file_name[64];
+    snprintf(label_file_name, sizeof (label_file_name), "/tmp/pipeline_benchmark_%d.bin", (int) getpid());
+
+    LabelWriter label_writer(label_file_name, LABEL_FORMAT_BINARY, settings->LABEL_BUFFER_RECORDS, settings->LABEL_SYNC_INTERVAL);
+
+    vector<double> latencies[STAGE_COUNT];
+
+    // Decoded frames are handed to the labeling loop without copying
+    Mat decoded_frame;
+
+    double total_start = now();
+
+    for (frame_number = 0; frame_number < frames; frame_number++) {
+
+        double start = now();
+
+        if (!video_capture.read(decoded_frame)) {
+            break;
+        }
+
+        double decoded = now();
+
+        display_pipeline.build(decoded_frame);
+
+        double built = now();
+
+        overlay_layer.set_base(display_pipeline.get_display());
+        Mat& canvas = overlay_layer.restore();
+
+        double restored = now();
+
+        // Cursor moving over the frame with a recorded label next to it
+        cursor_position = Point2f((frame_number * 11) % input_size.width, (frame_number * 5) % input_size.height);
+
+        overlay_layer.mark(user_interface.draw_label(cursor_position.x + 40, cursor_position.y, 0, 0, 1, canvas));
+        overlay_layer.mark(user_interface.draw_position(cursor_position.x, cursor_position.y, Size2f(), 0, 10, canvas));
+        overlay_layer.mark(user_interface.print_status(canvas, status));
+
+        double drawn = now();
+
+        label_writer.write(frame_number, LabelWriter::current_time(), cursor_position.x, cursor_position.y, 0);
+
+        double logged = now();
+
+        latencies[STAGE_DECODE].push_back(decoded - start);
+        latencies[STAGE_DISPLAY].push_back(built - decoded);
+        latencies[STAGE_OVERLAY].push_back(restored - built);
+        latencies[STAGE_DRAW].push_back(drawn - restored);
+        latencies[STAGE_LOG].push_back(logged - drawn);
+    }
+
+    double total_time = now() - total_start;
+
+    label_writer.close();
+    remove(label_file_name);
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+
+        vector<double>& sorted = latencies[stage];
+        sort(sorted.begin(), sorted.end());
+
+        double sum = 0;
+
+        for (size_t i = 0; i < sorted.size(); i++) {
+            sum += sorted[i];
+        }
+
+        output << "{\"video\": \"" << video_file_name << "\""
+                << ", \"width\": " << input_size.width
+                << ", \"height\": " << input_size.height
+                << ", \"zoom\": " << zoom
+                << ", \"stage\": \"" << STAGE_NAMES[stage] << "\""
+                << ", \"frames\": " << sorted.size()
+                << ", \"fps\": " << (sum > 0 ? sorted.size() * 1e6 / sum : 0)
+                << ", \"mean_us\": " << (sorted.empty() ? 0 : sum / sorted.size())
+                << ", \"p50_us\": " << percentile(sorted, 50)
+                << ", \"p99_us\": " << percentile(sorted, 99)
+                << ", \"max_us\": " << (sorted.empty() ? 0 : sorted.back())
+                << "}" << endl;
+    }
+
+    cerr << video_file_name << ": " << latencies[STAGE_DECODE].size() << " frames in " << total_time / 1000 << " ms" << endl;
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    settings = new Settings();
+
+    // Benchmark options are not settings
+    char * no_arguments[] = {argv[0]};
+    vector<string> arguments;
+
+    if (!settings->configure(1, no_arguments, arguments)) {
+        return 1;
+    }
+
+    int frames = 300;
+
+    double zoom = 1;
+
+    string output_file_name;
+
+    vector<string> video_file_names;
+
+    for (int i = 1; i < argc; i++) {
+
+        string argument = argv[i];
+
+        if (argument == "--frames" && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (argument == "--zoom" && i + 1 < argc) {
+            zoom = atof(argv[++i]);
+        } else if (argument == "--output" && i + 1 < argc) {
+            output_file_name = argv[++i];
+        } else if (argument.compare(0, 2, "--") == 0) {
+            cerr << "Usage: " << argv[0] << " [--frames N] [--zoom Z] [--output file] [video ...]" << endl;
+            return 1;
+        } else {
+            video_file_names.push_back(argument);
+        }
+    }
+
+    object_box_sizes.resize(settings->OBJECT_KEYS.size());
+
+    // Synthetic videos are removed when done
+    vector<string> synthetic_file_names;
+
+    if (video_file_names.empty()) {
+
+        for (size_t i = 0; i < sizeof (SYNTHETIC_SIZES) / sizeof (SYNTHETIC_SIZES[0]); i++) {
+
+            stringstream file_name;
+            file_name << "/tmp/pipeline_benchmark_" << getpid() << "_" << SYNTHETIC_SIZES[i].width << "x" << SYNTHETIC_SIZES[i].height << ".avi";
+
+            cerr << "Encoding synthetic video " << file_name.str() << endl;
+
+            if (!write_synthetic_video(file_name.str(), SYNTHETIC_SIZES[i], frames)) {
+                cerr << "Cannot write synthetic video " << file_name.str() << endl;
+                continue;
+            }
+
+            video_file_names.push_back(file_name.str());
+            synthetic_file_names.push_back(file_name.str());
+        }
+    }
+
+    ofstream output_file;
+
+    if (!output_file_name.empty()) {
+
+        output_file.open(output_file_name.c_str());
+
+        if (!output_file.is_open()) {
+            cerr << "Cannot open output file " << output_file_name << endl;
+            return 1;
+        }
+    }
+
+    ostream& output = output_file.is_open() ? output_file : cout;
+
+    bool success = !video_file_names.empty();
+
+    for (size_t i = 0; i < video_file_names.size(); i++) {
+        success = benchmark_video(video_file_names[i], frames, zoom, output) && success;
+    }
+
+    for (size_t i = 0; i < synthetic_file_names.size(); i++) {
+        remove(synthetic_file_names[i].c_str());
+    }
+
+    return success ? 0 : 1;
+}